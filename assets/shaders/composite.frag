@@ -7,10 +7,11 @@ in vec3 fragPos;
 uniform sampler2D uScene;
 uniform sampler2D uTrans;
 uniform sampler2D uPost;
+uniform bool uHasTrans = true;
 
 void main() {
     vec4 scene = texture(uScene, uv);
-    vec4 trans = texture(uTrans, uv);
+    vec4 trans = uHasTrans ? texture(uTrans, uv) : vec4(0.0);
     vec4 post = texture(uPost, uv);
 
     vec4 over1 = mix(trans, post, post.a);
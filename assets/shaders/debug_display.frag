@@ -1,36 +1,37 @@
-// FOR DEPTH
-
 #version 330 core
 in vec2 uv;
 out vec4 fragColor;
 
 uniform sampler2D uTexture;
+// > 0: the red channel is a count, shown as a heatmap saturating here
+uniform float uHeatmapMax = 0.0;
+
+// black, blue, green, yellow, red, white
+vec3 heatmap(float t) {
+    const vec3 ramp[6] = vec3[6](vec3(0.0), vec3(0.0, 0.0, 1.0),
+            vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0),
+            vec3(1.0));
+    float x = clamp(t, 0.0, 1.0) * 5.0;
+    int i = min(int(x), 4);
+    return mix(ramp[i], ramp[i + 1], x - float(i));
+}
 
 void main() {
-    float d = texture(uTexture, uv).r;
-    float visual = clamp(d / 100.0, 0.0, 1.0);
-    fragColor = vec4(visual, visual, visual, 1.0);
-    // fragColor = vec4(1, 0, 0, .1);
-    // if (visual > 0)
-    //     fragColor = vec4(1, 0, 0, 1);
-    // else if (visual == 0)
-    //     fragColor = vec4(0, 0, 0, 1);
-    // else if (visual < 0)
-    //     fragColor = vec4(0, 0, 1, 1);
-    //
+    if (uHeatmapMax > 0.0) {
+        float count = texture(uTexture, uv).r;
+        // pixels no splat touched let the scene through
+        fragColor = vec4(heatmap(count / uHeatmapMax), count > 0.0 ? 1.0 : 0.0);
+        return;
+    }
     fragColor = texture(uTexture, uv);
 }
 
-// FOR NORMALS
-
-// #version 330 core
-// in vec2 uv;
-// out vec4 fragColor;
-
-// uniform sampler2D uTexture;
+// FOR DEPTH
+//     float d = texture(uTexture, uv).r;
+//     float visual = clamp(d / 100.0, 0.0, 1.0);
+//     fragColor = vec4(visual, visual, visual, 1.0);
 
-// void main() {
+// FOR NORMALS
 //     vec3 normal = texture(uTexture, uv).rgb;
 //     normal = normal * 2.0 - 1.0;
 //     fragColor = vec4(normal * 0.5 + 0.5, 0.5);
-// }
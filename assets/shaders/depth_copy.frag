@@ -0,0 +1,36 @@
+#version 330 core
+
+in vec2 uv;
+
+uniform sampler2D uDepthTex;
+
+// the target is at most 4x smaller than the source per axis (render scale
+// 0.5 with thickness scale 0.5), so a pixel covers at most 5 texels
+const int maxFootprint = 6;
+
+// copies scene depth into a target of any smaller size. the furthest of
+// every texel the pixel covers is kept so nothing visible through a gap
+// gets rejected
+void main() {
+    ivec2 sourceSize = textureSize(uDepthTex, 0);
+    // uv is linear over the quad, so this is exactly one target pixel
+    vec2 halfPixel = fwidth(uv) * 0.5;
+    ivec2 first = ivec2(floor((uv - halfPixel) * vec2(sourceSize)));
+    ivec2 last = ivec2(ceil((uv + halfPixel) * vec2(sourceSize))) - 1;
+    first = clamp(first, ivec2(0), sourceSize - 1);
+    last = clamp(last, first, min(sourceSize - 1, first + maxFootprint - 1));
+
+    float depth = 0.0;
+    for (int y = 0; y < maxFootprint; ++y) {
+        if (first.y + y > last.y)
+            break;
+        for (int x = 0; x < maxFootprint; ++x) {
+            if (first.x + x > last.x)
+                break;
+            depth = max(depth,
+                        texelFetch(uDepthTex, first + ivec2(x, y), 0).r);
+        }
+    }
+
+    gl_FragDepth = depth;
+}
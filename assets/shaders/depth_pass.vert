@@ -5,6 +5,8 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform int pointSize = 10;
+// grows splats to cover for points skipped by LOD
+uniform float uPointScale = 1.0;
 
 out vec3 eyeSpacePos;
 
@@ -18,5 +20,5 @@ void main()
     gl_Position = projection * viewPos;
     gl_Position.y = -gl_Position.y;
 
-    gl_PointSize = pointSize;
+    gl_PointSize = pointSize * uPointScale;
 }
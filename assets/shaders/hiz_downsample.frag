@@ -0,0 +1,21 @@
+#version 330 core
+
+out float fragDepth;
+
+uniform sampler2D uDepthTex;
+
+// one max-depth level down. level sizes round up, so the last texel of
+// an odd source only has its own row or column to cover
+void main() {
+    ivec2 size = textureSize(uDepthTex, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+
+    float depth = 0.0;
+    for (int y = 0; y < 2; ++y) {
+        for (int x = 0; x < 2; ++x) {
+            ivec2 texel = min(base + ivec2(x, y), size - 1);
+            depth = max(depth, texelFetch(uDepthTex, texel, 0).r);
+        }
+    }
+    fragDepth = depth;
+}
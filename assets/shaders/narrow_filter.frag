@@ -1,7 +1,8 @@
 #version 330 core
 
 in vec2 uv;
-out float fragColor;
+layout(location = 0) out float fragColor;
+layout(location = 1) out vec3 fragNormal;
 
 uniform sampler2D uDepthTex;
 uniform float uDelta;
@@ -10,16 +11,34 @@ uniform float uWorldSigma;
 uniform float uFOV;
 uniform float uScreenHeight;
 
-const int KERNEL_RADIUS = 8;
+// final iteration: also reconstruct the view-space normal into location 1
+uniform bool uWriteNormals = false;
+
+/*
+Normal Encoding:
+	0 - packed RGB
+	1 - octahedral in RG
+*/
+uniform int uNormalEncoding = 0;
+
+// half-width of the kernel in texels, set by the quality level
+uniform int uKernelRadius = 8;
 
 float gaussianWeight(vec2 a, vec2 b, float sigma) {
     return exp(-dot(b - a, b - a) / (2.0 * sigma * sigma));
 }
 
-void main() {
-    float zi = texture(uDepthTex, uv).r;
-    if (zi == 0.0) discard;
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
 
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return e * 0.5 + 0.5;
+}
+
+float filterDepth(float zi) {
     float sigma_i = (uScreenHeight * uWorldSigma) / (2.0 * abs(zi) * tan(uFOV * 0.5));
     float kernelRadius = 3.0 * sigma_i;
     vec2 texelSize = 1.0 / textureSize(uDepthTex, 0);
@@ -32,8 +51,8 @@ void main() {
 
     float kernelRadiusPx = kernelRadius * texelSize.y;
 
-    for (int dy = -KERNEL_RADIUS; dy <= KERNEL_RADIUS; ++dy) {
-        for (int dx = -KERNEL_RADIUS; dx <= KERNEL_RADIUS; ++dx) {
+    for (int dy = -uKernelRadius; dy <= uKernelRadius; ++dy) {
+        for (int dx = -uKernelRadius; dx <= uKernelRadius; ++dx) {
             vec2 offset = vec2(float(dx), float(dy)) * texelSize;
             vec2 neighborUV = uv + offset;
 
@@ -76,5 +95,65 @@ void main() {
         }
     }
 
-    fragColor = sumDepths / max(sumWeights, 0.0001);
+    return sumDepths / max(sumWeights, 0.0001);
+}
+
+vec3 viewPosition(vec2 ndc, float z, float aspect, float tanHalfFOV) {
+    return vec3(ndc.x * aspect * tanHalfFOV * -z, ndc.y * tanHalfFOV * -z, -z);
+}
+
+// filtered depth of the other pixel in this pixel's 2x2 quad, taken from
+// registers through the derivative, or the unfiltered input one texel the
+// other way when the quad neighbour is off the surface
+float neighborDepth(float z, float dz, float onLeft, vec2 step, out float side) {
+    side = onLeft;
+    float zn = z + onLeft * dz;
+    if (zn != 0.0 && abs(zn - z) <= uDelta)
+        return zn;
+
+    side = -onLeft;
+    return textureLod(uDepthTex, uv + side * step, 0.0).r;
+}
+
+vec3 reconstructNormal(float z) {
+    vec2 texelSize = 1.0 / textureSize(uDepthTex, 0);
+    float aspect = float(textureSize(uDepthTex, 0).x) / uScreenHeight;
+    float tanHalfFOV = tan(uFOV * 0.5);
+
+    // derivatives are taken before any branch on per-pixel values
+    float dzdx = dFdx(z);
+    float dzdy = dFdy(z);
+    vec2 quadPos = vec2(1.0) - 2.0 * mod(floor(gl_FragCoord.xy), 2.0);
+
+    vec2 side;
+    float zx = neighborDepth(z, dzdx, quadPos.x, vec2(texelSize.x, 0), side.x);
+    float zy = neighborDepth(z, dzdy, quadPos.y, vec2(0, texelSize.y), side.y);
+    if (z == 0.0 || zx == 0.0 || zy == 0.0)
+        return vec3(0, 0, 1);
+
+    vec2 ndc = uv * 2.0 - 1.0;
+    vec3 p = viewPosition(ndc, z, aspect, tanHalfFOV);
+    vec3 px = viewPosition(ndc + vec2(side.x * texelSize.x * 2.0, 0), zx,
+            aspect, tanHalfFOV);
+    vec3 py = viewPosition(ndc + vec2(0, side.y * texelSize.y * 2.0), zy,
+            aspect, tanHalfFOV);
+
+    vec3 dx = normalize(px - p) * side.x;
+    vec3 dy = normalize(py - p) * side.y;
+    return normalize(cross(dy, dx));
+}
+
+void main() {
+    // no discard, the final iteration needs every quad lane for derivatives
+    float zi = texture(uDepthTex, uv).r;
+    float z = zi == 0.0 ? 0.0 : filterDepth(zi);
+    fragColor = z;
+
+    if (uWriteNormals) {
+        vec3 normal = reconstructNormal(z);
+        if (uNormalEncoding == 1)
+            fragNormal = vec3(octEncode(normal), 0.0);
+        else
+            fragNormal = normal * 0.5 + 0.5;
+    }
 }
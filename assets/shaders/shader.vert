@@ -3,6 +3,7 @@
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 norm;
 layout(location = 2) in vec3 tex;
+layout(location = 3) in mat4 instanceModel;
 
 out vec3 fragPos;
 out vec3 fragNorm;
@@ -12,14 +13,17 @@ out vec2 uv;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform bool uInstanced = false;
 
 void main()
 {
+    mat4 m = uInstanced ? instanceModel : model;
+
     // to world space
-    fragPos = vec3(model * vec4(pos, 1.0));
+    fragPos = vec3(m * vec4(pos, 1.0));
 
     // normal in world space
-    mat3 normalMatrix = mat3(transpose(inverse(model)));
+    mat3 normalMatrix = mat3(transpose(inverse(m)));
     fragNorm = normalMatrix * norm;
 
     // to screen space
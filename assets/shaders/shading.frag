@@ -52,6 +52,25 @@ uniform int shading = 1;
 */
 uniform int materialType = 0;
 
+/*
+Water normal encoding:
+	0 - packed RGB
+	1 - octahedral in RG
+*/
+uniform int uNormalEncoding = 0;
+
+vec3 decodeNormal(vec3 texel) {
+    if (uNormalEncoding == 0)
+        return texel * 2.0 - 1.0;
+
+    vec2 f = texel.xy * 2.0 - 1.0;
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 // texs
 
 // water
@@ -105,8 +124,7 @@ void main()
         if (-z < opaqueEyeDepth) discard;
 
         // NORM
-        vec3 packedNorm = texture(uNormalTex, uv).rgb;
-        norm = packedNorm * 2.0 - 1.0;
+        norm = decodeNormal(texture(uNormalTex, uv).rgb);
 
         // POS
         float tanHalfFov = tan(uFovY * 0.5);
@@ -149,8 +167,8 @@ void main()
         // foam
         vec2 texelSize = 1.0 / vec2(textureSize(uNormalTex, 0));
         vec3 center = norm;
-        vec3 right = texture(uNormalTex, uv + vec2(texelSize.x, 0)).rgb * 2.0 - 1.0;
-        vec3 up = texture(uNormalTex, uv + vec2(0, texelSize.y)).rgb * 2.0 - 1.0;
+        vec3 right = decodeNormal(texture(uNormalTex, uv + vec2(texelSize.x, 0)).rgb);
+        vec3 up = decodeNormal(texture(uNormalTex, uv + vec2(0, texelSize.y)).rgb);
         float curvature = length(center - right) + length(center - up);
 
         float foam = smoothstep(0.08, 0.3, curvature);
@@ -0,0 +1,171 @@
+// Build and query throughput of NeighborSearch against thread and particle
+// counts. usage: bench_neighbors [max particles] [max threads]
+
+#include "common/neighbor_search.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace engine;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// rest spacing of the generated fluid, queries use twice this
+constexpr float spacing = 0.01f;
+constexpr float radius = 2.0f * spacing;
+
+/** Jittered lattice filling a cube, like a settled block of fluid */
+std::vector<Vec3f> makeBlock(size_t count, std::mt19937 &rng) {
+	const int side = (int)std::ceil(std::cbrt((double)count));
+	std::uniform_real_distribution<float> jitter(-0.1f * spacing,
+												 0.1f * spacing);
+	std::vector<Vec3f> points;
+	points.reserve(count);
+	for (int z = 0; z < side && points.size() < count; ++z)
+		for (int y = 0; y < side && points.size() < count; ++y)
+			for (int x = 0; x < side && points.size() < count; ++x)
+				points.push_back(Vec3f(x + 0.5f, y + 0.5f, z + 0.5f) *
+									 spacing +
+								 Vec3f(jitter(rng), jitter(rng), jitter(rng)));
+	std::shuffle(points.begin(), points.end(), rng);
+	return points;
+}
+
+/** Moves every point a small step, as one sim step would */
+void advance(std::vector<Vec3f> &points, std::mt19937 &rng) {
+	std::uniform_real_distribution<float> step(-0.02f * spacing,
+											   0.02f * spacing);
+	for (Vec3f &p : points)
+		p += Vec3f(step(rng), step(rng), step(rng));
+}
+
+template <typename Fn> double seconds(Fn &&fn) {
+	const Clock::time_point start = Clock::now();
+	fn();
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Neighbours found over every point, each query from a sorted slot */
+size_t queryAll(const NeighborSearch &search) {
+	std::atomic<size_t> total{0};
+	parallelFor(
+		search.Size(),
+		[&](size_t begin, size_t end) {
+			size_t found = 0;
+			for (size_t s = begin; s < end; ++s) {
+				const Vec3f p = search.Position(s);
+				search.ForEachNeighbor(
+					p.x, p.y, p.z, radius,
+					[&](uint32_t, float, float, float, float) { found++; });
+			}
+			total += found;
+		},
+		1024);
+	return total;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	const size_t maxParticles =
+		argc > 1 ? std::stoul(argv[1]) : (size_t)1 << 20;
+	const size_t maxThreads =
+		argc > 2 ? std::stoul(argv[2])
+				 : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	constexpr int repeats = 5;
+	// frames in the one-shot allFrameData pass
+	constexpr size_t frames = 4;
+
+	// keys: how the sim, frames and padded searches bin cells, dense or
+	// hashed
+	std::printf("%10s %7s %14s %14s %14s %14s %14s %10s %12s\n", "particles",
+				"threads", "build Mpt/s", "rebuild Mpt/s", "frames Mpt/s",
+				"padded Mpt/s", "query Mpt/s", "neighbours", "keys");
+
+	std::mt19937 rng(1);
+	for (size_t count = 16384; count <= maxParticles; count *= 4) {
+		const std::vector<Vec3f> block = makeBlock(count, rng);
+		// allFrameData layout, every frame the same number of points
+		std::vector<Vec3f> allFrameData;
+		for (size_t f = 0; f < frames; ++f) {
+			std::vector<Vec3f> frame = block;
+			for (size_t k = 0; k < f; ++k)
+				advance(frame, rng);
+			allFrameData.insert(allFrameData.end(), frame.begin(), frame.end());
+		}
+		// the same frames padded the way createFrameData pads frames
+		// shorter than the longest one, a quarter of the slots far above
+		std::vector<Vec3f> paddedFrameData = allFrameData;
+		for (size_t f = 0; f < frames; ++f)
+			std::fill(paddedFrameData.begin() + f * count + count * 3 / 4,
+					  paddedFrameData.begin() + (f + 1) * count,
+					  Vec3f(0.0f, 1000.0f, 0.0f));
+
+		for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+			setWorkerCount(threads);
+
+			// sim: fixed domain, rebuilt every step from the last order
+			NeighborSearch sim;
+			sim.SetRadius(radius);
+			const float extent = std::cbrt((float)count) * spacing + spacing;
+			sim.SetDomain(Vec3f(-spacing), Vec3f(extent));
+			std::vector<Vec3f> state = block;
+			const double build =
+				seconds([&]() { sim.Build(NeighborSearch::Points::of(state)); });
+			double rebuild = 0;
+			for (int r = 0; r < repeats; ++r) {
+				// keep the state in the search's order, as a sim would
+				std::vector<Vec3f> sorted(state.size());
+				for (size_t s = 0; s < sorted.size(); ++s)
+					sorted[s] = state[sim.GetOrder()[s]];
+				state.swap(sorted);
+				advance(state, rng);
+				rebuild += seconds(
+					[&]() { sim.Build(NeighborSearch::Points::of(state)); });
+			}
+
+			size_t neighbours = 0;
+			const double query =
+				seconds([&]() { neighbours = queryAll(sim); });
+
+			// one-shot builds over each frame's slice, bounds from the points
+			NeighborSearch baked;
+			baked.SetRadius(radius);
+			const double framesTime = seconds([&]() {
+				for (size_t f = 0; f < frames; ++f)
+					baked.Build(NeighborSearch::Points::of(
+						allFrameData.data() + f * count, count));
+			});
+
+			NeighborSearch padded;
+			padded.SetRadius(radius);
+			const double paddedTime = seconds([&]() {
+				for (size_t f = 0; f < frames; ++f)
+					padded.Build(NeighborSearch::Points::of(
+						paddedFrameData.data() + f * count, count));
+			});
+
+			auto keys = [](const NeighborSearch &search) {
+				return search.IsHashed() ? "hash" : "dense";
+			};
+			const std::string layout = std::string(keys(sim)) + "/" +
+									   keys(baked) + "/" + keys(padded);
+			const double mega = (double)count / 1e6;
+			std::printf(
+				"%10zu %7zu %14.1f %14.1f %14.1f %14.1f %14.1f %10.1f %12s\n",
+				count, threads, mega / build, mega * repeats / rebuild,
+				mega * frames / framesTime, mega * frames / paddedTime,
+				mega / query, (double)neighbours / count, layout.c_str());
+		}
+	}
+	setWorkerCount(0);
+	return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef _ALIGNED_ALLOCATOR_H_
+#define _ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace engine {
+
+/**
+	Allocator for std::vector storage starting on an `Align` byte boundary,
+	e.g. a cache line so vector loads of a whole line don't split
+*/
+template <typename T, size_t Align> struct AlignedAllocator {
+	using value_type = T;
+
+	template <typename U> struct rebind {
+		using other = AlignedAllocator<U, Align>;
+	};
+
+	AlignedAllocator() = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Align> &) noexcept {}
+
+	T *allocate(size_t n) {
+		return static_cast<T *>(
+			::operator new(n * sizeof(T), std::align_val_t(Align)));
+	}
+	void deallocate(T *p, size_t) noexcept {
+		::operator delete(p, std::align_val_t(Align));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Align> &) const noexcept {
+		return true;
+	}
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Align> &) const noexcept {
+		return false;
+	}
+};
+
+// cache line aligned, vector loops load whole lines of neighbours
+using FloatArray = std::vector<float, AlignedAllocator<float, 64>>;
+
+} // namespace engine
+
+#endif
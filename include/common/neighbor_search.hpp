@@ -0,0 +1,184 @@
+#ifndef _NEIGHBOR_SEARCH_H_
+#define _NEIGHBOR_SEARCH_H_
+
+#include "common/aligned_allocator.hpp"
+#include "cyVector.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace engine {
+
+using cy::Vec3f;
+
+/**
+	Fixed-radius neighbour search over a set of points
+
+	Build counting-sorts the points by cell (parallel counts, a parallel
+	prefix sum and a scatter) and keeps a sorted copy, so a cell's points
+	sit in one contiguous range. Cells are dense over a box when that box
+	holds at most a few cells per point, otherwise the points are binned
+	through a compact hash table sized by the point count, so stray points
+	far from the rest (padding, splashes) cost nothing.
+
+	Sims set a fixed domain and rebuild every step from the previous
+	order; Build then only re-sorts when a point changed cell. One-shot
+	builds, e.g. over one frame of allFrameData, leave the domain unset
+	and grid the points' own bounds.
+*/
+class NeighborSearch {
+  public:
+	/** Positions as strided arrays, stride 1 for SoA or 3 for Vec3f */
+	struct Points {
+		const float *x = nullptr, *y = nullptr, *z = nullptr;
+		size_t stride = 1;
+		size_t count = 0;
+
+		static Points soa(const float *x, const float *y, const float *z,
+						  size_t count);
+		static Points of(const Vec3f *points, size_t count);
+		static inline Points of(const std::vector<Vec3f> &points) {
+			return of(points.data(), points.size());
+		}
+	};
+
+  private:
+	float cellSize = 1, invCellSize = 1;
+	bool fixedDomain = false;
+	Vec3f domainMin, domainMax;
+
+	// grid of this build, dense cells or a hash table of tableSize buckets
+	Vec3f origin;
+	int dims[3] = {1, 1, 1};
+	bool hashed = false;
+	size_t numKeys = 1;
+
+	// first slot of every key, numKeys + 1 entries
+	std::vector<uint32_t> keyStart;
+	std::unique_ptr<std::atomic<uint32_t>[]> keyCounts;
+	size_t keyCountsSize = 0;
+	// key of every input point, then of every sorted slot
+	std::vector<uint32_t> inputKeys, sortedKeys;
+	// rank within its key, from the parallel count
+	std::vector<uint32_t> ranks;
+	// input index of every sorted slot
+	std::vector<uint32_t> order;
+	FloatArray px, py, pz;
+
+	void Layout(const Points &points);
+	void Sort();
+
+	inline int CellCoord(float p, int axis) const {
+		// clamped before the cast, far outliers would overflow it
+		const float c = std::clamp((p - origin[axis]) * invCellSize,
+								   -1073741824.0f, 1073741824.0f);
+		const int cell = (int)std::floor(c);
+		return hashed ? cell : std::clamp(cell, 0, dims[axis] - 1);
+	}
+	inline uint32_t Key(int x, int y, int z) const {
+		if (hashed)
+			return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^
+					((uint32_t)z * 83492791u)) &
+				   (uint32_t)(numKeys - 1);
+		return (uint32_t)(((size_t)z * dims[1] + y) * dims[0] + x);
+	}
+
+  public:
+	/** Cell width, the largest radius queries may use */
+	void SetRadius(float radius);
+	/** Grids this box on every Build, points outside fall in its border */
+	void SetDomain(const Vec3f &boundMin, const Vec3f &boundMax);
+	/** Grids the bounds of whatever each Build gets */
+	void ClearDomain();
+
+	/**
+		Sorts the points by cell. Returns false, with an identity order,
+		when every point is still in the cell of its slot from the previous
+		Build, so a caller keeping its data in that order has nothing to do
+	*/
+	bool Build(const Points &points);
+
+	inline size_t Size() const { return order.size(); }
+	inline float GetRadius() const { return cellSize; }
+	inline bool IsHashed() const { return hashed; }
+	/** Dense cells or hash buckets */
+	inline size_t NumKeys() const { return numKeys; }
+	/** Input index of every sorted slot */
+	inline const std::vector<uint32_t> &GetOrder() const { return order; }
+	inline Vec3f Position(size_t slot) const {
+		return {px[slot], py[slot], pz[slot]};
+	}
+	inline const FloatArray &SortedX() const { return px; }
+	inline const FloatArray &SortedY() const { return py; }
+	inline const FloatArray &SortedZ() const { return pz; }
+
+	/**
+		Calls fn(begin, end) for the sorted slot ranges that can hold points
+		within the radius of (x, y, z). Dense grids merge each row of x
+		neighbours into one range; hashed ones visit every distinct bucket
+		once, which may hold points from unrelated cells
+	*/
+	template <typename Fn>
+	void ForEachRange(float x, float y, float z, Fn &&fn) const {
+		if (order.empty())
+			return;
+		const int cx = CellCoord(x, 0), cy = CellCoord(y, 1),
+				  cz = CellCoord(z, 2);
+		if (!hashed) {
+			for (int k = std::max(cz - 1, 0); k <= std::min(cz + 1, dims[2] - 1);
+				 ++k) {
+				for (int j = std::max(cy - 1, 0);
+					 j <= std::min(cy + 1, dims[1] - 1); ++j) {
+					const uint32_t begin =
+						keyStart[Key(std::max(cx - 1, 0), j, k)];
+					const uint32_t end =
+						keyStart[Key(std::min(cx + 1, dims[0] - 1), j, k) + 1];
+					if (end > begin)
+						fn(begin, end);
+				}
+			}
+			return;
+		}
+
+		uint32_t keys[27];
+		int count = 0;
+		for (int k = cz - 1; k <= cz + 1; ++k)
+			for (int j = cy - 1; j <= cy + 1; ++j)
+				for (int i = cx - 1; i <= cx + 1; ++i)
+					keys[count++] = Key(i, j, k);
+		std::sort(keys, keys + count);
+		count = (int)(std::unique(keys, keys + count) - keys);
+		for (int i = 0; i < count; ++i) {
+			const uint32_t begin = keyStart[keys[i]],
+						   end = keyStart[keys[i] + 1];
+			if (end > begin)
+				fn(begin, end);
+		}
+	}
+
+	/**
+		Calls fn(slot, dx, dy, dz, r2) for every sorted slot within `radius`
+		(at most the cell size) of (x, y, z), with d = (x, y, z) - point.
+		GetOrder()[slot] is the point's input index
+	*/
+	template <typename Fn>
+	void ForEachNeighbor(float x, float y, float z, float radius,
+						 Fn &&fn) const {
+		const float radius2 = radius * radius;
+		ForEachRange(x, y, z, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t s = begin; s < end; ++s) {
+				const float dx = x - px[s], dy = y - py[s], dz = z - pz[s];
+				const float r2 = dx * dx + dy * dy + dz * dz;
+				if (r2 < radius2)
+					fn(s, dx, dy, dz, r2);
+			}
+		});
+	}
+};
+
+} // namespace engine
+
+#endif
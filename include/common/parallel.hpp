@@ -0,0 +1,26 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace engine {
+
+/** Threads parallelFor splits work across */
+size_t workerCount();
+/** Caps workerCount, 0 restores one worker per hardware thread */
+void setWorkerCount(size_t count);
+
+/**
+	Calls fn(begin, end) on contiguous ranges covering [0, count), one range
+	per worker, and waits for all of them. Runs on the calling thread when
+	there is less than minPerWorker work for a second worker, when nested
+	in another parallelFor, or while another thread's call holds the
+	workers, which are started once and reused.
+*/
+void parallelFor(size_t count, const std::function<void(size_t, size_t)> &fn,
+				 size_t minPerWorker = 1);
+
+} // namespace engine
+
+#endif
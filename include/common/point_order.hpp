@@ -0,0 +1,73 @@
+#ifndef _POINT_ORDER_H_
+#define _POINT_ORDER_H_
+
+#include "common/typedefs.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+// number of prefix LOD levels, level k draws every 2^k-th point
+constexpr int pointLodLevels = 8;
+// curve ranks per culling chunk, a multiple of the coarsest LOD stride
+constexpr size_t pointChunkSize = 4096;
+
+/*
+Point Order:
+	Original - as written by the simulation
+	Morton - along a 3D Morton curve, for splat and cache locality
+	MortonLod - Morton order regrouped so prefixes are uniform subsamples
+*/
+enum class PointOrder {
+	Original,
+	Morton,
+	MortonLod,
+};
+
+bool parsePointOrder(const std::string &name, PointOrder &order);
+const char *pointOrderName(PointOrder order);
+
+/** 30-bit Morton code of p within the bounds, clamped to them */
+uint32_t mortonCode(const Vec3f &p, const Vec3f &boundMin,
+					const Vec3f &boundMax);
+
+/**
+	Stable parallel LSD radix sort of keys, applying the same permutation to
+	ids
+*/
+void radixSort(std::vector<uint32_t> &keys, std::vector<uint32_t> &ids);
+
+/**
+	Reorders a frame and returns, for each new slot, the index the point
+	had before. Points outside the bounds (padding) sort to the end of the
+	curve.
+
+	With MortonLod the first lodPointCount(n, k) points are every 2^k-th
+	point along the curve, for every level k. Each level is stored in
+	Morton order after the coarser ones, so any such prefix is a spatially
+	uniform subsample.
+*/
+std::vector<uint32_t> orderPoints(std::vector<Vec3f> &points,
+								  const Vec3f &boundMin, const Vec3f &boundMax,
+								  PointOrder order);
+
+/** Points making up LOD level `level` of an n-point frame */
+inline size_t lodPointCount(size_t n, int level) {
+	return (n + ((size_t)1 << level) - 1) >> level;
+}
+
+/** Slot an ordered n-point frame keeps its curve rank `rank` in */
+size_t rankSlot(size_t n, PointOrder order, size_t rank);
+
+/**
+	Slots [first, last) of a MortonLod frame holding the curve ranks
+	[rankBegin, rankEnd) stored in `level`. Level 0 holds the coarsest
+	ranks, LOD k draws levels 0 to pointLodLevels - 1 - k.
+*/
+void lodLevelSlots(size_t n, int level, size_t rankBegin, size_t rankEnd,
+				   size_t &first, size_t &last);
+
+} // namespace engine
+
+#endif
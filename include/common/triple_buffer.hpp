@@ -0,0 +1,51 @@
+#ifndef _TRIPLE_BUFFER_H_
+#define _TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace engine {
+
+/**
+	Lock-free handoff of whole values from one writer thread to one reader
+
+	The writer fills Back and publishes it; the reader picks up the newest
+	published value with Acquire and reads Front for as long as it likes.
+	Neither side ever waits: each owns one slot and the third is swapped
+	through an atomic index, so a writer faster than the reader just
+	overwrites values the reader never saw.
+*/
+template <typename T> class TripleBuffer {
+  private:
+	// set on the shared index when the writer published since the reader
+	// last took it
+	static constexpr uint8_t freshBit = 4;
+
+	T slots[3];
+	uint8_t back = 0, front = 2;
+	std::atomic<uint8_t> middle{1};
+
+  public:
+	/** Writer's slot, owned by the writer until Publish */
+	inline T &Back() { return slots[back]; }
+	/** Hands Back to the reader, Back is then an older slot to overwrite */
+	inline void Publish() {
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) &
+			   (freshBit - 1);
+	}
+
+	/** Moves the newest published value to Front, false if there's none */
+	inline bool Acquire() {
+		if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) &
+				(freshBit - 1);
+		return true;
+	}
+	/** Reader's slot, valid until the next Acquire */
+	inline const T &Front() const { return slots[front]; }
+};
+
+} // namespace engine
+
+#endif
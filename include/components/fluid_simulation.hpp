@@ -1,8 +1,14 @@
 #ifndef _FLUID_SIMULATION_H_
 #define _FLUID_SIMULATION_H_
 
+#include "core/fluid_pipeline.hpp"
+#include "core/gl_handle.hpp"
+#include "core/upload_worker.hpp"
 #include "core/renderer.hpp"
 #include "core/scene.hpp"
+#include "core/stream_buffer.hpp"
+#include <functional>
+#include <memory>
 #include <optional>
 
 #undef max
@@ -14,7 +20,10 @@
 #include <Alembic/AbcGeom/IPoints.h>
 
 #include "common/common.hpp"
+#include "common/point_order.hpp"
 #include "components/component.hpp"
+#include "sim/fluid_solver.hpp"
+#include "sim/simulation_thread.hpp"
 
 using namespace Alembic::AbcCoreFactory;
 
@@ -22,57 +31,202 @@ namespace engine {
 
 class FluidData : public Component, public IUpdatable {
   public:
+	/** Whether a chunk with these local-space bounds may be visible */
+	using ChunkFilter = std::function<bool(const Vec3f &, const Vec3f &)>;
+
 	virtual ~FluidData() = default;
 	virtual void Bind() = 0;
-	virtual void Draw(Renderer &renderer, Scene *scene, Matrix4f model) = 0;
+	/**
+		Draws the current frame's points with whatever program is bound,
+		every 2^lod-th point when the data supports prefix LOD. Data split
+		into spatial chunks skips those `visible` rejects.
+	*/
+	virtual void DrawPoints(int lod = 0,
+							const ChunkFilter &visible = nullptr) = 0;
+	/** Local-space bounds of every point the component can draw */
+	virtual void GetBounds(Vec3f &boundMin, Vec3f &boundMax) = 0;
+	/** Changes whenever the points DrawPoints draws change */
+	virtual size_t GetVersion() const = 0;
+	/** Typical local-space distance between points, 0 if unknown */
+	virtual float GetSpacing() const = 0;
+
+	/**
+		Uploads up to `budget` more bytes of GPU data, taking what it used
+		off the budget. Returns true once everything is on the GPU.
+	*/
+	virtual bool Prefetch(size_t &budget) = 0;
+	/** Finishes any upload, blocking. Drawing does this implicitly. */
+	virtual void MakeResident() = 0;
+	/** Frees the GPU copy, keeping what's needed to upload it again */
+	virtual void Evict() = 0;
+	virtual bool IsResident() const = 0;
+	/**
+		Declares the screen-space passes that splat, filter and shade the
+		fluid into the "post" layer
+	*/
+	virtual void AddPasses(RenderGraph &graph, Renderer &renderer,
+						   Scene *scene, Matrix4f model) = 0;
 	virtual bool IsFinished() = 0;
 	virtual void Reset() = 0;
 };
 
 class BakedPointDataComponent : public FluidData {
+  public:
+	// seconds each frame is shown for
+	static constexpr double frameInterval = 1.0 / 60.0;
+
   private:
-	GLuint vao, buffer;
-	GLuint depthFBOA, depthTextureA;
-	GLuint depthFBOB, depthTextureB;
-	GLuint filteredDepthTexture, filterFBO;
-	GLuint normalFBO, normalTexture;
-	GLuint thicknessFBO, thicknessTexture;
+	GLVertexArray vao;
+	GLBuffer buffer;
+	// CPU copy of every frame, the GPU one only exists while resident
+	std::vector<Vec3f> frameData;
+	size_t uploadedBytes = 0;
+	// batches queued on the upload worker
+	std::vector<UploadTicket> uploads;
+	static constexpr size_t uploadBatchBytes = 8 * 1024 * 1024;
 
 	size_t currentFrame, numPoints, numFrames;
+	Vec3f boundMin, boundMax;
+	float spacing;
+	// frames are stored in prefix LOD order
+	bool lodOrdered;
+	PointOrder order;
+	// bounds of every pointChunkSize curve ranks, numChunks per frame,
+	// empty when the points aren't in curve order
+	size_t numChunks = 0;
+	std::vector<Vec3f> chunkMin, chunkMax;
+	std::vector<GLint> drawFirsts;
+	std::vector<GLsizei> drawCounts;
 	float timer = 0;
 	unsigned int loopCount = 0;
 
-	// unsigned int frameWidth = 640, frameHeight = 480;
-	unsigned int frameWidth = 1280, frameHeight = 960;
+	FluidPipeline pipeline;
+
+	/** Allocates the buffer and queues or starts the upload */
+	void BeginUpload();
 
   public:
-	BakedPointDataComponent(const std::vector<Vec3f> &allFrameData,
-							const size_t &nPoints, const size_t &nFrames);
+	BakedPointDataComponent(std::vector<Vec3f> allFrameData,
+							const size_t &nPoints, const size_t &nFrames,
+							PointOrder order = PointOrder::MortonLod);
+	BakedPointDataComponent(BakedPointDataComponent &&) = default;
+	~BakedPointDataComponent();
 	// BakedPointDataComponent(const Alembic::Abc::IArchive &archive);
 	static std::optional<BakedPointDataComponent>
-	create(const std::string &path);
+	create(const std::string &path, PointOrder order = PointOrder::MortonLod);
+	/**
+		Reads every frame, pads them to the same point count and reorders
+		each one's points by `order`
+	*/
 	static std::vector<Vec3f>
 	createFrameData(const Alembic::Abc::IArchive &archive, size_t &numPoints,
-					size_t &numFrames);
+					size_t &numFrames,
+					PointOrder order = PointOrder::MortonLod);
 	static std::optional<std::vector<Vec3f>>
 	createFrameDataFromPath(const std::string &path, size_t &numPoints,
-							size_t &numFrames);
+							size_t &numFrames,
+							PointOrder order = PointOrder::MortonLod);
 
 	void Bind() override;
+	void DrawPoints(int lod = 0,
+					const ChunkFilter &visible = nullptr) override;
+	void GetBounds(Vec3f &boundMin, Vec3f &boundMax) override;
+	size_t GetVersion() const override;
+	float GetSpacing() const override;
+	bool Prefetch(size_t &budget) override;
+	void MakeResident() override;
+	void Evict() override;
+	bool IsResident() const override;
 	void Update(double dt) override;
-	void Draw(Renderer &renderer, Scene *scene, Matrix4f model) override;
+	void AddPasses(RenderGraph &graph, Renderer &renderer, Scene *scene,
+				   Matrix4f model) override;
 	bool IsFinished() override;
 	void Reset() override;
 };
 
+/**
+	Live simulation drawn through the same splatting passes as baked data.
+	The solver steps on a SimulationThread, by steps sized to the fluid's
+	speed, and a slow solver runs in slow motion rather than falling
+	further behind.
+*/
 class FluidSimulationComponent : public FluidData {
   private:
-	GLuint buffer;
+	std::unique_ptr<SimulationThread> sim;
+	// the initial block, refilled by Reset
+	Vec3f blockMin, blockMax;
+	Vec3f domainMin, domainMax;
+	float spacing;
+	std::vector<std::shared_ptr<const SdfCollider>> colliders;
+
+	GLVertexArray vao;
+	// drawn positions, interpolated between the sim's last two states
+	// right into mapped memory
+	StreamBuffer points{sizeof(Vec3f), "simulated points"};
+	// buffer the VAO's attribute points at
+	GLuint vaoBuffer = 0;
+	size_t numPoints = 0;
+	// bumped whenever the blend or frame changes, uploads happen when it
+	// moves
+	size_t version = 0, uploadedVersion = 0;
+
+	// sim time handed to the thread so far, and as of the last Update,
+	// which the thread had a whole frame to reach
+	double time = 0, shownTime = 0;
+	// frame and blend the next upload interpolates, the frame stays
+	// valid until the next SimulationThread::Latest
+	const SimFrame *shown = nullptr;
+	size_t shownSequence = 0;
+	float shownBlend = -1;
+
+	// steps per second, reported every reportInterval seconds
+	static constexpr double reportInterval = 2.0;
+	double reportTimer = 0, uploadSeconds = 0;
+	size_t reportUploads = 0, reportFrames = 0;
+
+	FluidPipeline pipeline;
+
+	/** Picks the newest frame and the blend of its two states to draw */
+	void Interpolate();
+	void Upload();
 
   public:
+	FluidSimulationComponent(std::unique_ptr<FluidSolver> solver,
+							 const Vec3f &blockMin, const Vec3f &blockMax);
+
+	/**
+		Bakes a static obstacle from triangles in the simulation's space,
+		at the solver's particle spacing and clipped to its domain. False
+		when none of it is inside the domain.
+	*/
+	bool AddCollider(const std::vector<Vec3f> &positions,
+					 const std::vector<unsigned int> &indices);
+	/**
+		Records the simulation into an Alembic cache at path, a frame per
+		frame BakedPointDataComponent plays back, until StopRecording or
+		the next Reset
+	*/
+	bool StartRecording(const std::string &path);
+	void StopRecording();
+	/**
+		Steps as long as the solver's CFL condition allows, at most
+		maxSubsteps per frame (on by default), or the solver's fixed step
+	*/
+	void SetAdaptiveStepping(bool enabled, int maxSubsteps);
+
 	void Bind() override;
+	void DrawPoints(int lod = 0,
+					const ChunkFilter &visible = nullptr) override;
+	void GetBounds(Vec3f &boundMin, Vec3f &boundMax) override;
+	size_t GetVersion() const override;
+	float GetSpacing() const override;
+	bool Prefetch(size_t &budget) override;
+	void MakeResident() override;
+	void Evict() override;
+	bool IsResident() const override;
 	void Update(double dt) override;
-	void Draw(Renderer &renderer, Scene *scene, Matrix4f model) override;
+	void AddPasses(RenderGraph &graph, Renderer &renderer, Scene *scene,
+				   Matrix4f model) override;
 	bool IsFinished() override;
 	void Reset() override;
 };
@@ -4,24 +4,69 @@
 #include "common/common.hpp"
 #include "common/typedefs.hpp"
 #include "components/renderer.hpp"
+#include "core/draw_list.hpp"
+#include "core/gl_handle.hpp"
+#include "core/upload_worker.hpp"
 #include "core/renderer.hpp"
+#include <memory>
 
 using namespace engine;
 
 namespace engine {
 
-class MeshRendererComponent : public RendererComponent {
-  private:
-	GLuint VAO, VBO, EBO;
+/**
+	GPU geometry shared by every mesh with identical vertex and index data
+
+	With an upload worker running the data is queued on it at creation,
+	and the geometry isn't drawn until that upload has landed.
+*/
+struct MeshGeometry {
+	GLVertexArray VAO;
+	GLBuffer VBO, EBO;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	bool hasSentData = false;
+	UploadTicket upload;
+	bool uploadQueued = false;
+
+	MeshGeometry(const std::vector<Vertex> &, const std::vector<unsigned int> &);
+	~MeshGeometry();
 
+	/**
+		Sets the VAO up once the data is on the GPU, uploading it right
+		away when nothing was queued. False while a queued upload is still
+		in flight.
+	*/
+	bool SendData();
+	inline unsigned int NV() const { return indices.size(); }
+
+	static std::shared_ptr<MeshGeometry>
+	Get(const std::vector<Vertex> &vertices,
+		const std::vector<unsigned int> &indices);
+};
+
+/**
+	Texture set loaded once per directory
+*/
+struct MaterialTextures {
 	bool hasDiffuse = false, hasNormal = false, hasRough = false,
 		 hasDisp = false;
-	// GLuint diffuseTex, normalTex, roughTex, dispTex;
 	cyGLTexture2D diffuseTex, normalTex, roughTex, dispTex;
 
+	MaterialTextures() = default;
+	~MaterialTextures();
+
+	/** Binds the set, or resets the texture uniforms when null */
+	static void Bind(Renderer &renderer, const MaterialTextures *textures);
+
+	static std::shared_ptr<MaterialTextures> Get(const std::string &path);
+};
+
+class MeshRendererComponent : public RendererComponent {
+  private:
+	std::shared_ptr<MeshGeometry> geometry;
+	std::shared_ptr<MaterialTextures> textures;
+
   protected:
 	Vec3f meshSize = Vec3f{};
 	Vec3f center = Vec3f{};
@@ -38,14 +83,23 @@ class MeshRendererComponent : public RendererComponent {
 	MeshRendererComponent(const std::vector<Vertex> &,
 						  const std::vector<unsigned int> &);
 
-	inline unsigned int NV() { return indices.size(); }
+	inline unsigned int NV() { return geometry->NV(); }
+	/** False until the geometry can be drawn */
+	inline bool IsReady() { return geometry->SendData(); }
 	inline Vec3f GetCenter() const { return center; }
 	inline Vec3f GetMeshSize() const { return meshSize; }
 	inline Matrix4f GetModelMatrix() const { return modelMatrix; }
+	inline const MeshGeometry &GetGeometry() const { return *geometry; }
 
 	void SetMeshSize(const Vec3f &size);
 	void SetTextures(const std::string path);
 
+	/**
+		Fills in the geometry, textures and transform for the draw list,
+		material uniforms are left to the owner
+	*/
+	DrawItem MakeDrawItem();
+
 	void Render(Renderer &renderer, Scene *scene) override;
 	void Update() override;
 };
@@ -0,0 +1,99 @@
+#ifndef _DRAW_LIST_H_
+#define _DRAW_LIST_H_
+
+#include "common/typedefs.hpp"
+#include "core/gl_handle.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+class Renderer;
+struct MeshGeometry;
+struct MaterialTextures;
+enum ShadingType : int;
+
+struct DrawItem {
+	uint64_t key = 0;
+	std::string program = "default";
+	const MaterialTextures *textures = nullptr;
+	const MeshGeometry *geometry = nullptr;
+
+	// material
+	Vec3f ambientColor, diffuseColor;
+	float shininess = 10;
+	ShadingType shading;
+
+	Matrix4f model;
+
+	bool SameMaterial(const DrawItem &other) const;
+	/** Can share an instanced draw call */
+	bool Batches(const DrawItem &other) const;
+};
+
+/**
+	Sorted, instanced submission of opaque meshes
+
+	Items are sorted by a 64-bit key (program | texture set | material |
+	geometry) so state only changes between groups, and runs of items with
+	the same geometry and material become one instanced draw with the model
+	matrices streamed through a per-instance buffer.
+*/
+class DrawList {
+  public:
+	struct Stats {
+		size_t items = 0, draws = 0;
+		size_t programBinds = 0, textureBinds = 0, materialChanges = 0,
+			   vaoBinds = 0;
+
+		bool operator==(const Stats &other) const {
+			return items == other.items && draws == other.draws &&
+				   programBinds == other.programBinds &&
+				   textureBinds == other.textureBinds &&
+				   materialChanges == other.materialChanges &&
+				   vaoBinds == other.vaoBinds;
+		}
+	};
+
+  private:
+	std::vector<DrawItem> items;
+	std::vector<Matrix4f> instanceData;
+	GLBuffer instanceVBO;
+	size_t instanceCapacity = 0;
+
+	// dense ids so each key field fits its bits
+	std::unordered_map<const void *, uint64_t> textureIds;
+	std::vector<size_t> materials;
+
+	Stats stats, lastPrinted;
+
+	uint64_t MakeKey(size_t index, GLuint programId);
+	void BindInstances(size_t first);
+
+  public:
+	DrawList() = default;
+
+	DrawList(const DrawList &) = delete;
+	DrawList &operator=(const DrawList &) = delete;
+
+	void Clear();
+	void Add(const DrawItem &item);
+	/**
+		Sorts the list and issues the draws, leaving "uInstanced" off
+	*/
+	void Submit(Renderer &renderer);
+	/**
+		Hash of what the items draw and where, equal between two lists
+		that would draw the same image
+	*/
+	uint64_t Hash() const;
+
+	inline const Stats &GetStats() const { return stats; }
+	void PrintStats() const;
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _FLUID_PIPELINE_H_
+#define _FLUID_PIPELINE_H_
+
+#include "core/fluid_settings.hpp"
+#include "core/render_graph.hpp"
+#include "core/renderer.hpp"
+#include <string>
+#include <vector>
+
+namespace engine {
+
+class Scene;
+class FluidData;
+
+struct FluidSplat {
+	FluidData *fluid;
+	Matrix4f model;
+	// prefix LOD level, picked by the pipeline from projected spacing
+	int lod = 0;
+};
+
+/**
+	Screen-space fluid passes: thickness and depth splatting, narrow-range
+	filtering, normal reconstruction and shading into the "post" layer
+
+	Every splat source is drawn into the same set of targets, so the filter,
+	normal and shading passes run once however many fluid bodies there are.
+
+	The filtered surface is kept in persistent targets. While the splatted
+	points, transforms, camera, target size and, when splats are occluded,
+	the opaque layer stay the same (paused, or cached data slower than the
+	display) only the shading pass runs.
+*/
+class FluidPipeline {
+  public:
+	/** Overdraw gathered while an overdraw view is on, between reports */
+	struct OverdrawStats {
+		size_t frames = 0;
+		double fragments = 0, coveredPixels = 0, pixels = 0;
+		float peak = 0;
+	};
+
+  private:
+	struct Inputs {
+		std::vector<FluidData *> fluids;
+		std::vector<size_t> versions;
+		std::vector<Matrix4f> models;
+		std::vector<int> lods;
+		Matrix4f view, projection;
+		int width = 0, height = 0;
+		FluidFormats formats;
+		FluidQuality quality;
+		// splats are clipped against the opaque layer, which has to match
+		bool occluded = false;
+		uint64_t opaqueVersion = 0;
+
+		bool operator==(const Inputs &other) const;
+	};
+
+	std::string historyKey;
+	Inputs lastInputs;
+	bool hasHistory = false;
+	bool reused = false;
+
+	OverdrawStats overdraw;
+
+  public:
+	FluidPipeline();
+
+	/**
+		Picks the target formats for this frame. R16F depth is only used when
+		its step at the furthest fluid depth stays within the tolerance.
+	*/
+	static FluidFormats ResolveFormats(const FluidSettings &settings,
+									   float maxEyeDepth);
+
+	void AddPasses(RenderGraph &graph, Renderer &renderer, Scene *scene,
+				   const std::vector<FluidSplat> &sources);
+
+	/** Whether the last AddPasses only re-shaded the previous surface */
+	inline bool ReusedSurface() const { return reused; }
+};
+
+} // namespace engine
+
+#endif
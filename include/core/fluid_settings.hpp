@@ -0,0 +1,107 @@
+#ifndef _FLUID_SETTINGS_H_
+#define _FLUID_SETTINGS_H_
+
+#include "common/typedefs.hpp"
+
+namespace engine {
+
+/*
+Normal Encoding:
+	0 - packed RGB, n * 0.5 + 0.5
+	1 - octahedral in RG
+*/
+enum NormalEncoding {
+	PackedNormals = 0,
+	OctahedralNormals = 1,
+};
+
+/*
+Overdraw View:
+	Off - normal shading
+	Thickness - fragments per pixel of the thickness splats
+	Depth - fragments per pixel of the depth splats
+*/
+enum class OverdrawView {
+	Off,
+	Thickness,
+	Depth,
+};
+
+/**
+	Texture formats of the intermediate fluid targets
+*/
+struct FluidFormats {
+	GLenum depth = GL_R32F;
+	GLenum normal = GL_RGB16F;
+	GLenum thickness = GL_R32F;
+
+	inline NormalEncoding GetNormalEncoding() const {
+		return normal == GL_RGB16F ? PackedNormals : OctahedralNormals;
+	}
+
+	bool operator==(const FluidFormats &other) const {
+		return depth == other.depth && normal == other.normal &&
+			   thickness == other.thickness;
+	}
+};
+
+/**
+	One step of the fluid quality ladder
+*/
+struct FluidQuality {
+	// fluid target size relative to the window
+	float renderScale = 1.0f;
+	int filterIterations = 3;
+	// narrow filter half-width in texels
+	int kernelRadius = 8;
+	// thickness target size relative to the fluid targets
+	float thicknessScale = 1.0f;
+
+	bool operator==(const FluidQuality &other) const {
+		return renderScale == other.renderScale &&
+			   filterIterations == other.filterIterations &&
+			   kernelRadius == other.kernelRadius &&
+			   thicknessScale == other.thicknessScale;
+	}
+};
+
+/**
+	Renderer-wide quality settings for the screen-space fluid passes
+*/
+struct FluidSettings {
+	// R16F depth & thickness, octahedral normals
+	bool compactFormats = true;
+	// GL_RG8 or GL_RG16
+	GLenum compactNormal = GL_RG16;
+	// largest R16F depth step (world units) before depth falls back to R32F
+	float depthTolerance = 0.1f;
+
+	// keep last frame's depth, normal & thickness while nothing they
+	// depend on changed, only re-shading
+	bool reuseUnchanged = true;
+
+	FluidQuality quality;
+	// draw fewer, larger splats when points get closer than lodSpacingPx
+	// on screen
+	bool particleLod = true;
+	float lodSpacingPx = 3.0f;
+	// depth test splats against the opaque layer
+	bool occludeSplats = true;
+	// with occludeSplats, skip point chunks the hierarchical-Z test hides
+	bool occlusionCulling = true;
+
+	// let the quality governor move `quality` to hold the frame budget
+	bool adaptiveQuality = true;
+	// GPU milliseconds per frame the governor aims for
+	float targetFrameMs = 1000.0f / 60.0f;
+
+	// one-shot: compare the compact targets against the 32-bit path
+	bool reportFormatError = false;
+	// fill-rate analysis: counts samples per pass and replaces the fluid
+	// shading with an overdraw heatmap of one splat pass
+	OverdrawView overdrawView = OverdrawView::Off;
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef _GL_HANDLE_H_
+#define _GL_HANDLE_H_
+
+#include "core/gpu_memory.hpp"
+#include <string>
+
+namespace engine {
+
+/**
+	Move-only owner of one GL object, deleted with the handle
+
+	Traits supply Create and Delete. Buffers, textures and renderbuffers go
+	through GpuMemory so they show up in its accounting.
+*/
+template <typename Traits> class GLHandle {
+  private:
+	GLuint id = 0;
+
+  public:
+	GLHandle() = default;
+	explicit GLHandle(GLuint id) : id(id) {}
+	~GLHandle() { Reset(); }
+
+	GLHandle(const GLHandle &) = delete;
+	GLHandle &operator=(const GLHandle &) = delete;
+
+	GLHandle(GLHandle &&other) noexcept : id(other.Release()) {}
+	GLHandle &operator=(GLHandle &&other) noexcept {
+		if (this != &other) {
+			Reset();
+			id = other.Release();
+		}
+		return *this;
+	}
+
+	template <typename... Args> static GLHandle Create(const Args &...args) {
+		return GLHandle(Traits::Create(args...));
+	}
+
+	inline GLuint Get() const { return id; }
+	inline explicit operator bool() const { return id != 0; }
+
+	/** Gives up ownership without deleting */
+	GLuint Release() {
+		GLuint released = id;
+		id = 0;
+		return released;
+	}
+	void Reset() {
+		if (id != 0)
+			Traits::Delete(id);
+		id = 0;
+	}
+};
+
+struct BufferTraits {
+	static GLuint Create(GpuCategory category, const std::string &owner) {
+		return GpuMemory::CreateBuffer(category, owner);
+	}
+	static void Delete(GLuint &id) { GpuMemory::DeleteBuffer(id); }
+};
+
+struct TextureTraits {
+	static GLuint Create(GpuCategory category, const std::string &owner) {
+		return GpuMemory::CreateTexture(category, owner);
+	}
+	static void Delete(GLuint &id) { GpuMemory::DeleteTexture(id); }
+};
+
+struct RenderbufferTraits {
+	static GLuint Create(GpuCategory category, const std::string &owner) {
+		return GpuMemory::CreateRenderbuffer(category, owner);
+	}
+	static void Delete(GLuint &id) { GpuMemory::DeleteRenderbuffer(id); }
+};
+
+// VAOs and framebuffers hold no storage of their own
+struct VertexArrayTraits {
+	static GLuint Create() {
+		GLuint id = 0;
+		glGenVertexArrays(1, &id);
+		return id;
+	}
+	static void Delete(GLuint &id) { glDeleteVertexArrays(1, &id); }
+};
+
+struct FramebufferTraits {
+	static GLuint Create() {
+		GLuint id = 0;
+		glGenFramebuffers(1, &id);
+		return id;
+	}
+	static void Delete(GLuint &id) { glDeleteFramebuffers(1, &id); }
+};
+
+using GLBuffer = GLHandle<BufferTraits>;
+using GLTexture = GLHandle<TextureTraits>;
+using GLRenderbuffer = GLHandle<RenderbufferTraits>;
+using GLVertexArray = GLHandle<VertexArrayTraits>;
+using GLFramebuffer = GLHandle<FramebufferTraits>;
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _GPU_MEMORY_H_
+#define _GPU_MEMORY_H_
+
+#include "common/typedefs.hpp"
+#include <cstddef>
+#include <string>
+
+namespace engine {
+
+enum class GpuObject {
+	Buffer,
+	Texture,
+	Renderbuffer,
+};
+
+/*
+GPU Category:
+	Geometry - mesh, quad and instance vertex data
+	Points - fluid point caches
+	RenderTarget - render graph textures
+	Texture - loaded images and fallback textures
+	Readback - pixel buffers the CPU reads from
+*/
+enum class GpuCategory {
+	Geometry,
+	Points,
+	RenderTarget,
+	Texture,
+	Readback,
+	Count,
+};
+
+/**
+	Accounting of every buffer, texture and renderbuffer the engine owns
+
+	Objects are created and deleted through here, or registered with Track
+	when other code (cy textures) creates them, and their storage size is
+	recorded whenever it's specified. Sizes are estimates from the formats,
+	drivers may pad or compress. Safe to call from any thread.
+*/
+class GpuMemory {
+  public:
+	struct Stats {
+		size_t objects = 0, bytes = 0, peakBytes = 0;
+	};
+
+	static GLuint CreateBuffer(GpuCategory category, const std::string &owner);
+	static GLuint CreateTexture(GpuCategory category,
+								const std::string &owner);
+	static GLuint CreateRenderbuffer(GpuCategory category,
+									 const std::string &owner);
+	/** Deletes and forgets the object, leaving id 0 */
+	static void DeleteBuffer(GLuint &id);
+	static void DeleteTexture(GLuint &id);
+	static void DeleteRenderbuffer(GLuint &id);
+
+	/** glBufferData on the buffer bound to target, recording its size */
+	static void BufferData(GLenum target, GLuint id, size_t bytes,
+						   const void *data, GLenum usage);
+	/** Records the size of storage just (re)specified for an object */
+	static void SetSize(GpuObject type, GLuint id, size_t bytes);
+
+	/** Registers an object created elsewhere */
+	static void Track(GpuObject type, GLuint id, GpuCategory category,
+					  const std::string &owner, size_t bytes);
+	/** Forgets an object deleted elsewhere */
+	static void Untrack(GpuObject type, GLuint id);
+
+	static Stats GetStats();
+	static Stats GetStats(GpuCategory category);
+
+	/** Breakdown by category and owner, with high-water marks */
+	static void PrintReport();
+	/** Prints every object still alive and returns how many there are */
+	static size_t CheckLeaks();
+
+	/**
+		Runs CheckLeaks when destroyed, declare it before anything that
+		owns GPU objects
+	*/
+	struct LeakCheck {
+		~LeakCheck() { CheckLeaks(); }
+	};
+};
+
+const char *gpuCategoryName(GpuCategory category);
+
+} // namespace engine
+
+#endif
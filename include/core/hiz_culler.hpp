@@ -0,0 +1,91 @@
+#ifndef _HIZ_CULLER_H_
+#define _HIZ_CULLER_H_
+
+#include "core/gl_handle.hpp"
+#include "core/render_graph.hpp"
+#include <vector>
+
+namespace engine {
+
+class Renderer;
+
+/**
+	Hierarchical-Z occlusion test on the CPU
+
+	The opaque depth is reduced to a max-depth pyramid on the GPU and its
+	coarsest level (at most 64 texels a side) is read back through a pixel
+	buffer a frame later. Opaque geometry is assumed static, so boxes are
+	tested where they were in that older frame, their screen rectangle
+	widened by how far the camera's motion since then moved them. Boxes
+	bound point centres, so the test also takes how far the points' splats
+	reach past them.
+*/
+class HiZCuller {
+  public:
+	struct Stats {
+		size_t tested = 0, hidden = 0;
+	};
+
+  private:
+	struct Readback {
+		GLBuffer pbo;
+		GLsync fence = 0;
+		int width = 0, height = 0;
+		// size of the full-resolution depth and levels below it
+		int baseWidth = 0, baseHeight = 0, levels = 0;
+		Matrix4f projection, viewProj;
+		// AddPasses call that issued it
+		size_t frame = 0;
+	};
+
+	static constexpr int maxReadbackSize = 64;
+
+	Readback readbacks[2];
+	size_t frame = 0;
+
+	// latest depth that made it back
+	std::vector<float> depth;
+	int width = 0, height = 0;
+	int baseWidth = 0, baseHeight = 0, levels = 0;
+	Matrix4f depthProjection, depthViewProj;
+	size_t depthFrame = 0;
+	bool valid = false;
+
+	// this frame's camera and window
+	Matrix4f viewProj;
+	int screenWidth = 1, screenHeight = 1;
+	mutable Stats stats;
+
+	void Resolve();
+
+  public:
+	HiZCuller() = default;
+	~HiZCuller();
+
+	HiZCuller(const HiZCuller &) = delete;
+	HiZCuller &operator=(const HiZCuller &) = delete;
+
+	/**
+		Picks up finished readbacks, then declares the pyramid and readback
+		passes for this frame's opaque depth
+	*/
+	void AddPasses(RenderGraph &graph, Renderer &renderer,
+				   RenderResource opaqueDepth, const Matrix4f &projection,
+				   const Matrix4f &view);
+
+	/**
+		Points in the local-space box certainly draw nothing on screen in
+		front of opaque depth. `splatRadius` is how far their splats reach
+		from them and `spread` how much further the passes reading the
+		splats do, both in window pixels.
+	*/
+	bool IsHidden(const Vec3f &boundMin, const Vec3f &boundMax,
+				  const Matrix4f &model, float splatRadius,
+				  float spread) const;
+
+	inline const Stats &GetStats() const { return stats; }
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _QUALITY_GOVERNOR_H_
+#define _QUALITY_GOVERNOR_H_
+
+#include "core/fluid_settings.hpp"
+#include <cstddef>
+
+namespace engine {
+
+/**
+	Walks the fluid quality ladder to keep measured GPU frame time within
+	FluidSettings::targetFrameMs
+
+	Quality drops after a short run of frames over budget and only rises
+	after a long run well under it, with a pause after every change while
+	the timers catch up. A level that was just dropped from waits twice as
+	long each time before it is tried again.
+*/
+class QualityGovernor {
+  public:
+	struct Stats {
+		int level = 0, levels = 0;
+		double gpuMs = 0, smoothedMs = 0, targetMs = 0;
+	};
+
+  private:
+	int level;
+	double smoothed = 0;
+	size_t overBudget = 0, underBudget = 0;
+	size_t cooldown = 0;
+
+	int failedLevel = -1;
+	size_t retryFrames;
+
+	Stats stats;
+
+	static constexpr double smoothing = 0.1;
+	// raise quality only below this fraction of the budget
+	static constexpr double headroom = 0.7;
+	static constexpr size_t downFrames = 15;
+	static constexpr size_t upFrames = 90;
+	static constexpr size_t settleFrames = 30;
+	static constexpr size_t maxRetryFrames = 1800;
+
+	void SetLevel(int newLevel, FluidSettings &settings);
+
+  public:
+	QualityGovernor();
+
+	/** Ladder from cheapest to the full-quality defaults */
+	static const FluidQuality &GetLevel(int level);
+	static int NumLevels();
+
+	/**
+		Feeds one frame's GPU time (0 while unmeasured) and updates
+		settings.quality when the level changes
+	*/
+	void Update(double gpuMs, FluidSettings &settings);
+
+	inline const Stats &GetStats() const { return stats; }
+	void PrintStats() const;
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef _RENDER_GRAPH_H_
+#define _RENDER_GRAPH_H_
+
+#include "common/typedefs.hpp"
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+struct TextureDesc {
+	int width = 0, height = 0;
+	GLenum internalFormat = GL_RGBA8;
+	GLenum format = GL_RGBA;
+	GLenum type = GL_UNSIGNED_BYTE;
+	GLenum filter = GL_NEAREST;
+	GLenum wrap = GL_CLAMP_TO_EDGE;
+
+	inline bool IsDepth() const { return format == GL_DEPTH_COMPONENT; }
+	size_t ByteSize() const;
+
+	bool operator==(const TextureDesc &other) const {
+		return width == other.width && height == other.height &&
+			   internalFormat == other.internalFormat &&
+			   format == other.format && type == other.type &&
+			   filter == other.filter && wrap == other.wrap;
+	}
+};
+
+using RenderResource = int;
+constexpr RenderResource NullResource = -1;
+
+/**
+	Per-frame graph of render passes
+
+	Passes declare the textures they read and write during setup. On compile
+	the graph culls passes whose outputs are never read, works out how long
+	each transient texture lives, and lets textures with non-overlapping
+	lifetimes share the same GL texture. Physical textures and framebuffers
+	are pooled across frames.
+
+	Every executed pass is wrapped in a GPU timer query, and in a samples
+	passed query while sample counting is on. Results are read back a few
+	frames later so the CPU never waits on them.
+
+	Persistent textures sit outside the pool and keep their contents from
+	one frame to the next, for results that are reused while their inputs
+	don't change.
+*/
+class RenderGraph {
+  public:
+	class Builder {
+	  public:
+		RenderResource Read(RenderResource res);
+		/** Adds a color attachment, in declaration order */
+		RenderResource Write(RenderResource res);
+		RenderResource WriteDepth(RenderResource res);
+		/** Keeps the pass alive even if nothing reads its outputs */
+		void SideEffect();
+
+	  private:
+		friend class RenderGraph;
+		Builder(RenderGraph &graph, size_t pass) : graph(graph), pass(pass) {}
+
+		RenderGraph &graph;
+		size_t pass;
+	};
+
+	using SetupFn = std::function<void(Builder &)>;
+	using ExecuteFn = std::function<void()>;
+
+	struct Stats {
+		size_t passes = 0, culledPasses = 0;
+		size_t virtualTextures = 0, physicalTextures = 0;
+		size_t virtualBytes = 0, physicalBytes = 0;
+		size_t persistentTextures = 0, persistentBytes = 0;
+
+		bool operator==(const Stats &other) const {
+			return passes == other.passes &&
+				   culledPasses == other.culledPasses &&
+				   virtualTextures == other.virtualTextures &&
+				   physicalTextures == other.physicalTextures &&
+				   persistentTextures == other.persistentTextures;
+		}
+	};
+
+	struct PassTime {
+		std::string name;
+		double ms;
+		// samples passing the depth test, 0 unless counting
+		GLuint64 samples = 0;
+	};
+
+  private:
+	struct Resource {
+		std::string name;
+		TextureDesc desc;
+		bool imported = false;
+		GLuint fbo = 0; // imported render targets only
+		bool persistent = false;
+		GLuint texture = 0; // persistent textures only
+		int physical = -1;
+		int firstPass = -1, lastPass = -1;
+	};
+
+	struct Pass {
+		std::string name;
+		ExecuteFn execute;
+		std::vector<RenderResource> reads, writes;
+		RenderResource depth = NullResource;
+		bool sideEffect = false;
+		bool alive = false;
+	};
+
+	struct TimerFrame {
+		std::vector<GLuint> queries, sampleQueries;
+		std::vector<std::string> names;
+		size_t used = 0;
+		bool pending = false;
+		bool countedSamples = false;
+	};
+
+	struct PhysicalTexture {
+		GLuint id;
+		TextureDesc desc;
+		bool inUse;
+		size_t lastUsedFrame;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PhysicalTexture> pool;
+	std::map<std::string, PhysicalTexture> persistentTextures;
+	std::map<std::vector<GLuint>, GLuint> framebuffers;
+
+	size_t frameIndex = 0;
+	bool compiled = false;
+	Stats stats;
+	// recently printed stats, so frames alternating between a few graph
+	// shapes don't print every frame
+	std::deque<Stats> printed;
+
+	// pooled textures unused for this many frames are deleted
+	static constexpr size_t maxIdleFrames = 8;
+	static constexpr size_t printedHistory = 4;
+
+	// frames between issuing a timer query and reading it back
+	static constexpr size_t timerLatency = 3;
+	TimerFrame timerFrames[timerLatency];
+	std::vector<PassTime> passTimes;
+	double gpuTime = 0;
+	bool countSamples = false;
+
+	static GLuint AllocateTexture(const TextureDesc &desc);
+	int AcquireTexture(const TextureDesc &desc);
+	void DeleteTexture(GLuint texture);
+	void ReleaseUnused();
+	GLuint GetFramebuffer(const Pass &pass);
+	void BindTarget(const Pass &pass);
+	void ResolveTimers(TimerFrame &frame);
+
+  public:
+	RenderGraph() = default;
+	~RenderGraph();
+
+	RenderGraph(const RenderGraph &) = delete;
+	RenderGraph &operator=(const RenderGraph &) = delete;
+
+	RenderResource CreateTexture(const std::string &name,
+								 const TextureDesc &desc);
+	RenderResource ImportBackbuffer(const std::string &name, int width,
+									int height);
+	/**
+		Texture that keeps its contents across frames, found again by key.
+		Writing it keeps a pass alive. `created` is set when the texture was
+		just (re)allocated and holds nothing yet.
+	*/
+	RenderResource CreatePersistentTexture(const std::string &key,
+										   const TextureDesc &desc,
+										   bool *created = nullptr);
+	RenderResource Find(const std::string &name) const;
+	inline const TextureDesc &GetDesc(RenderResource res) const {
+		return resources.at(res).desc;
+	}
+
+	void AddPass(const std::string &name, const SetupFn &setup,
+				 const ExecuteFn &execute);
+
+	/**
+		Culls unused passes and assigns physical textures
+	*/
+	void Compile();
+	void Execute();
+	/**
+		Drops this frame's passes and resources, keeps the texture pool
+	*/
+	void Reset();
+
+	/**
+		Physical texture backing a resource, only valid during Execute
+	*/
+	GLuint GetTexture(RenderResource res) const;
+
+	inline const Stats &GetStats() const { return stats; }
+	void PrintStats() const;
+
+	/** GPU time of each executed pass, from a few frames ago */
+	inline const std::vector<PassTime> &GetPassTimes() const {
+		return passTimes;
+	}
+	/** Sum of the pass times in milliseconds, 0 until the first readback */
+	inline double GetGpuTime() const { return gpuTime; }
+
+	/** Also counts the samples each pass writes, for fill-rate analysis */
+	inline void SetSampleCounting(bool count) { countSamples = count; }
+	inline bool GetSampleCounting() const { return countSamples; }
+};
+
+} // namespace engine
+
+#endif
@@ -2,12 +2,17 @@
 #define _RENDERER_H_
 
 #include "common/typedefs.hpp"
+#include "core/draw_list.hpp"
+#include "core/fluid_settings.hpp"
+#include "core/gl_handle.hpp"
+#include "core/quality_governor.hpp"
+#include "core/render_graph.hpp"
 #include <string>
 #include <unordered_map>
 
 namespace engine {
 
-enum ShadingType {
+enum ShadingType : int {
 	None = 0,
 	BlinnPhong = 1,
 	SolidAmbient = 2,
@@ -46,27 +51,24 @@ class Renderer {
 
 	// dummy textures
 	bool dummyTexturesInitialized;
-	GLuint dummy2DTexture;
-	GLuint dummyCubemapTexture;
+	GLTexture dummy2DTexture;
+	GLTexture dummyCubemapTexture;
 
 	void CollectSamplerUniforms(GLuint programId);
 	void InitializeDummyTextures();
 
-	// buffers
-	struct BufferInfo {
-		GLuint id;
-		GLuint texture;
-		int width, height;
-		GLuint depthTex;
-	};
-	std::unordered_map<std::string, BufferInfo> framebuffers = {};
+	// passes & transient targets
+	RenderGraph graph;
+	DrawList drawList;
+	FluidSettings fluidSettings;
+	QualityGovernor governor;
 
 	//
-	GLuint fullscreenQuadVAO, fullscreenQuadVBO;
+	GLVertexArray fullscreenQuadVAO;
+	GLBuffer fullscreenQuadVBO;
 
   public:
 	Renderer(const cy::Vec2f *windowSize);
-	~Renderer();
 
 	void CreateProgram(std::string name, GLSLProgram *prog);
 	GLSLProgram *GetProgram(std::string name);
@@ -134,108 +136,29 @@ class Renderer {
 
 	void SetDummyTextures();
 
-	GLuint CreateDummyTexture2D();
-	GLuint CreateDummyCubemap();
-
-	/**
-		Creates a framebuffer and a texture
-
-		Returns texture id
-	 */
-	inline GLint CreateBuffer(std::string name, int width, int height,
-							  GLenum attachment = GL_COLOR_ATTACHMENT0,
-							  GLenum target = GL_TEXTURE_2D,
-							  GLenum iFormat = GL_RGBA8,
-							  GLenum format = GL_RGBA,
-							  GLenum type = GL_UNSIGNED_BYTE,
-							  bool withDepth = false) {
-		GLint current = CurrentDrawFBO();
-
-		GLuint fbo, tex;
-		glGenFramebuffers(1, &fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-		glGenTextures(1, &tex);
-		glBindTexture(target, tex);
-		glTexImage2D(target, 0, iFormat, width, height, 0, format, type,
-					 nullptr);
-		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, target, tex, 0);
-
-		GLuint depthTex = 0;
-		if (withDepth) {
-			glGenTextures(1, &depthTex);
-			glBindTexture(GL_TEXTURE_2D, depthTex);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height,
-						 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-								   GL_TEXTURE_2D, depthTex, 0);
-		}
-
-		glBindFramebuffer(GL_FRAMEBUFFER, current);
-
-		framebuffers[name] = {fbo, tex, width, height, depthTex};
-		return tex;
-	}
-
-	/**
-		Find a buffer
-
-		Return buffer pointer
-	*/
-	BufferInfo *FindBuffer(const std::string &name) {
-		auto it = framebuffers.find(name);
-		if (it != framebuffers.end()) {
-			return &it->second;
-		} else {
-			return nullptr;
-		}
-	}
-
-	/**
-		Bind a buffer if found
+	GLTexture CreateDummyTexture2D();
+	GLTexture CreateDummyCubemap();
 
-		Returns success
-	*/
-	inline bool BindBuffer(const std::string &name) {
-		auto it = framebuffers.find(name);
-		if (it != framebuffers.end()) {
-			glBindFramebuffer(GL_FRAMEBUFFER, it->second.id);
-			glViewport(0, 0, it->second.width, it->second.height);
-			return true;
-		} else {
-			return false;
-		}
-	}
-	inline bool BindBuffer(GLuint id) {
-		for (const auto &[name, fb] : framebuffers) {
-			if (fb.id == id) {
-				glBindFramebuffer(GL_FRAMEBUFFER, fb.id);
-				glViewport(0, 0, fb.width, fb.height);
-				return true;
-			}
-		}
-		return false;
-	}
+	inline RenderGraph &GetGraph() { return graph; }
+	inline DrawList &GetDrawList() { return drawList; }
+	inline FluidSettings &GetFluidSettings() { return fluidSettings; }
+	inline const QualityGovernor &GetGovernor() const { return governor; }
+	inline int GetWidth() const { return (int)windowSize->x; }
+	inline int GetHeight() const { return (int)windowSize->y; }
 
 	/**
 		Draws a fullscreen quad
 	*/
 	inline void DrawFullscreenQuad() {
-		glBindVertexArray(fullscreenQuadVAO);
+		glBindVertexArray(fullscreenQuadVAO.Get());
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		glBindVertexArray(0);
 	}
 
 	/**
-		Compose layers together
+		Compose layers together, trans may be 0 when no layer was rendered
 	 */
-	void Composite();
+	void Composite(GLuint scene, GLuint trans, GLuint post);
 };
 
 } // namespace engine
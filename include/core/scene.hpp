@@ -1,6 +1,8 @@
 #ifndef _SCENE_H_
 #define _SCENE_H_
 
+#include "core/fluid_pipeline.hpp"
+#include "core/hiz_culler.hpp"
 #include "core/renderer.hpp"
 #include <memory>
 #include <unordered_map>
@@ -23,6 +25,13 @@ class Scene {
 
 	Vec3f sunPosition = Vec3f{0., 0., 0.};
 
+	// all fluid bodies share one set of screen-space targets and passes
+	bool batchFluids = true;
+	FluidPipeline fluidPipeline;
+	HiZCuller hiZCuller;
+	// what this frame's opaque pass draws, see GetOpaqueVersion
+	uint64_t opaqueVersion = 0;
+
   public:
 	Scene();
 	~Scene();
@@ -51,16 +60,35 @@ class Scene {
 	inline void SetSunPosition(const Vec3f &pos) { sunPosition = pos; }
 	inline const Vec3f &GetSunPosition() { return sunPosition; }
 
+	inline void SetFluidBatching(bool batch) { batchFluids = batch; }
+	inline bool GetFluidBatching() const { return batchFluids; }
+
+	inline const HiZCuller &GetHiZCuller() const { return hiZCuller; }
+	/**
+		Hash of the opaque layer this frame, from its draws and transforms,
+		valid once Render has started declaring passes
+	*/
+	inline uint64_t GetOpaqueVersion() const { return opaqueVersion; }
+
+	/** GPU residency of the scene's fluid data, see FluidData */
+	bool Prefetch(size_t &budget);
+	void MakeResident();
+	void Evict();
+
 	void Update(float deltaTime);
 	void Render(Renderer &renderer);
 
-	void RenderOpaque(Renderer &renderer, std::vector<SceneObject *> objects,
-					  std::string buffer = "opaque");
+	/**
+		Fills the renderer's draw list from the opaque objects and sets the
+		opaque version, returning the objects that draw themselves
+	*/
+	std::vector<SceneObject *>
+	GatherOpaque(Renderer &renderer, const std::vector<SceneObject *> &objects);
+	/** Draws the gathered list, then the objects that draw themselves */
+	void RenderOpaque(Renderer &renderer, std::vector<SceneObject *> immediate);
 	void RenderTransparent(Renderer &renderer,
-						   std::vector<SceneObject *> objects,
-						   std::string buffer = "trans");
-	void RenderPost(Renderer &renderer, std::vector<SceneObject *> objects,
-					std::string buffer = "post");
+						   std::vector<SceneObject *> objects);
+	void RenderPost(Renderer &renderer, std::vector<SceneObject *> objects);
 };
 
 } // namespace engine
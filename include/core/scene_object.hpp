@@ -96,6 +96,21 @@ class SceneObject {
 		}
 	}
 
+	/**
+		Queues the object's draws on a sorted draw list instead of rendering
+		it directly
+
+		Returns false if the object has to be rendered with Render
+	*/
+	virtual bool SubmitDraws(DrawList &drawList) { return false; }
+
+	/**
+		Declares any render graph passes the object needs this frame, called
+		after its bucket's pass has been added
+	*/
+	virtual void AddRenderPasses(RenderGraph &graph, Renderer &renderer,
+								 Scene *scene) {}
+
 	inline RenderingOrder GetRenderingOrder() { return renderingOrder; }
 
   protected:
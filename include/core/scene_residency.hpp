@@ -0,0 +1,41 @@
+#ifndef _SCENE_RESIDENCY_H_
+#define _SCENE_RESIDENCY_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace engine {
+
+class Scene;
+
+/**
+	Keeps only the drawn scene and the one expected next on the GPU
+
+	The active scene is made resident before it's drawn, finishing its
+	upload if the prefetch hadn't. The next scene is queued on the upload
+	worker, or streams in a slice per frame without one, and every other
+	scene is evicted to its CPU copy, so VRAM peaks at about one scene plus
+	the prefetch.
+
+	Only fluid point data is managed. Meshes and textures are shared
+	between scenes through their caches and stay resident.
+*/
+class SceneResidency {
+  private:
+	std::vector<Scene *> scenes;
+	Scene *active = nullptr, *next = nullptr;
+	bool nextResident = false;
+	// bytes uploaded towards the next scene per frame, without a worker
+	size_t uploadBudget;
+
+  public:
+	explicit SceneResidency(const std::vector<Scene *> &scenes,
+							size_t uploadBudget = 16 * 1024 * 1024);
+
+	/** Call once per frame before drawing `active` */
+	void Update(Scene *active, Scene *next);
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _STREAM_BUFFER_H_
+#define _STREAM_BUFFER_H_
+
+#include "core/gl_handle.hpp"
+#include <string>
+
+namespace engine {
+
+/**
+	Vertex buffer rewritten every frame, split into three regions
+
+	Each write goes to the region after the last one, straight into mapped
+	memory: persistently and coherently mapped storage where
+	ARB_buffer_storage exists, an unsynchronized glMapBufferRange of the
+	region otherwise. A fence placed when the writer moves on guards every
+	region, so the CPU only waits when it gets three frames ahead of the
+	GPU and never on the driver's implicit sync.
+*/
+class StreamBuffer {
+  public:
+	static constexpr int regions = 3;
+
+  private:
+	GLBuffer buffer;
+	size_t elementSize;
+	std::string owner;
+	// elements per region
+	size_t capacity = 0;
+	int region = 0;
+	GLsync fences[regions] = {};
+	// whole buffer while persistently mapped, else the region being
+	// written between BeginWrite and EndWrite
+	char *mapped = nullptr;
+	bool persistent = false;
+	// times BeginWrite had to wait for the GPU
+	size_t stalls = 0;
+
+	void Allocate(size_t count);
+
+  public:
+	StreamBuffer(size_t elementSize, const std::string &owner);
+	~StreamBuffer() { Reset(); }
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+	/**
+		Memory for `count` elements in the next region, once the GPU is
+		done reading what it last held. Too little room reallocates the
+		buffer, so its id may change.
+	*/
+	void *BeginWrite(size_t count);
+	/** Hands the region written since BeginWrite to the GPU */
+	void EndWrite();
+	/** Frees the buffer and its fences */
+	void Reset();
+
+	inline GLuint Get() const { return buffer.Get(); }
+	inline explicit operator bool() const { return (bool)buffer; }
+	/** Index of the last written region's first element, for draws */
+	inline GLint First() const { return (GLint)(region * capacity); }
+	inline bool IsPersistent() const { return persistent; }
+	/** Bytes of storage behind all three regions */
+	inline size_t GetBytes() const { return regions * capacity * elementSize; }
+	inline size_t GetStalls() const { return stalls; }
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _UPLOAD_WORKER_H_
+#define _UPLOAD_WORKER_H_
+
+#include "common/typedefs.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace engine {
+
+/**
+	Completion of one upload job, polled by the render thread
+
+	Ready once the job ran on the worker and the fence it left behind has
+	signaled, so the data is visible to the render context. An empty ticket
+	is always ready.
+*/
+class UploadTicket {
+  private:
+	friend class UploadWorker;
+
+	struct State {
+		std::mutex mutex;
+		std::condition_variable done;
+		bool submitted = false;
+		GLsync fence = 0;
+
+		~State();
+	};
+	std::shared_ptr<State> state;
+
+  public:
+	bool IsReady() const;
+	/** Blocks until the job has run and its fence signaled */
+	void Wait() const;
+};
+
+/**
+	Thread with its own GL context, sharing objects with the render context
+
+	Jobs run in submission order with the worker's context current, each
+	followed by a fence. Only buffer and texture contents should be
+	written: VAOs and framebuffers aren't shared between contexts, so the
+	render thread sets those up once the ticket is ready. Writes go through
+	GL_COPY_WRITE_BUFFER so no VAO is needed.
+*/
+class UploadWorker {
+  public:
+	using Job = std::function<void()>;
+
+  private:
+	GLFWwindow *context = nullptr;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::pair<Job, std::shared_ptr<UploadTicket::State>>> jobs;
+	bool stopping = false;
+
+	static UploadWorker *instance;
+
+	void Run();
+
+  public:
+	/**
+		Creates a hidden window sharing `share`'s objects. GLFW only allows
+		this on the main thread.
+	*/
+	explicit UploadWorker(GLFWwindow *share);
+	/** Finishes the queued jobs first */
+	~UploadWorker();
+
+	UploadWorker(const UploadWorker &) = delete;
+	UploadWorker &operator=(const UploadWorker &) = delete;
+
+	inline bool IsRunning() const { return context != nullptr; }
+
+	UploadTicket Submit(Job job);
+
+	/** The running worker, or null when uploads happen on the render thread */
+	static UploadWorker *Get();
+};
+
+} // namespace engine
+
+#endif
@@ -2,7 +2,10 @@
 #define _FLUID_OBJECT_H_
 
 #include "components/fluid_simulation.hpp"
+#include "core/fluid_pipeline.hpp"
 #include "core/scene_object.hpp"
+#include "sim/pbf_solver.hpp"
+#include "sim/wcsph_solver.hpp"
 #include <memory>
 
 namespace engine {
@@ -30,15 +33,37 @@ class FluidObject : public SceneObject {
 
 	inline Vec3f &GetColor() const;
 
-	void Render(Renderer &renderer, Scene *scene) override;
+	void AddRenderPasses(RenderGraph &graph, Renderer &renderer,
+						 Scene *scene) override;
+	FluidSplat GetSplat() const;
 
 	bool fromFile(const std::string &path);
+	/** `order` is the order createFrameData put the points in */
 	bool fromFrameData(const std::vector<Vec3f> &, const size_t &numPoints,
-					   const size_t &numFrames);
-	bool fromSimulation();
+					   const size_t &numFrames,
+					   PointOrder order = PointOrder::MortonLod);
+	/**
+		Live dam break: a block filling the lower corner of the solver's
+		domain collapses under gravity
+	*/
+	bool fromSimulation(std::unique_ptr<FluidSolver> solver);
+	bool fromSimulation(const WcsphSettings &settings = WcsphSettings());
+	bool fromSimulation(const PbfSettings &settings);
+	/**
+		Turns every mesh in the scene into an obstacle for a live
+		simulation, returns how many overlap its domain. Meshes are taken
+		where they are now, later moves aren't followed.
+	*/
+	size_t AddColliders(const Scene &scene);
+	/** Records a live simulation into an Alembic cache at path */
+	bool Record(const std::string &path);
+	/** Closes the cache Record started, if it's still open */
+	void StopRecording();
 
 	bool IsFinished() { return fluid->IsFinished(); }
 	void Reset() { fluid->Reset(); }
+
+	inline FluidData *GetData() const { return fluid.get(); }
 };
 
 } // namespace engine
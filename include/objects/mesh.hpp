@@ -41,6 +41,7 @@ class MeshObject : public SceneObject {
 	}
 
 	void Render(Renderer &renderer, Scene *scene) override;
+	bool SubmitDraws(DrawList &drawList) override;
 };
 
 } // namespace engine
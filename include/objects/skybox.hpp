@@ -1,6 +1,7 @@
 #ifndef _SKYBOX_H_
 #define _SKYBOX_H_
 
+#include "core/gl_handle.hpp"
 #include "core/scene.hpp"
 #include "core/scene_object.hpp"
 
@@ -8,12 +9,14 @@ namespace engine {
 
 class SkyboxObject : public SceneObject {
   private:
-	GLuint skyboxVAO, skyboxVBO;
+	GLVertexArray skyboxVAO;
+	GLBuffer skyboxVBO;
 	cy::GLTextureCubeMap skybox;
 	cy::GLSLProgram skyboxProg;
 
   public:
 	SkyboxObject();
+	~SkyboxObject();
 
 	inline cy::GLTextureCubeMap &GetTexture() { return skybox; }
 
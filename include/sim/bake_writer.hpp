@@ -0,0 +1,85 @@
+#ifndef _BAKE_WRITER_H_
+#define _BAKE_WRITER_H_
+
+#include "common/typedefs.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+/**
+	Records particle frames into an Alembic point cache on its own thread
+
+	Write only copies the positions into one of a few pooled buffers and
+	queues it, the writer thread encodes and appends it to an OPoints
+	schema. When the disk falls behind and every buffer is queued, Write
+	waits for one to free up rather than dropping frames or growing the
+	queue. The cache loads back through BakedPointDataComponent.
+*/
+class BakeWriter {
+  public:
+	// frames in flight before Write waits
+	static constexpr size_t poolFrames = 4;
+
+  private:
+	struct Archive;
+	std::unique_ptr<Archive> archive;
+	const double interval;
+
+	std::vector<std::vector<Vec3f>> pool;
+	std::vector<std::vector<Vec3f> *> freeFrames;
+	std::deque<std::vector<Vec3f> *> queued;
+	std::mutex mutex;
+	std::condition_variable frameFreed, frameQueued;
+	bool closing = false;
+	std::thread thread;
+	// set by the writer thread once everything queued is written
+	std::atomic<bool> closed{false};
+
+	std::atomic<size_t> written{0}, stalls{0};
+	// spent in Write by the caller, and encoding by the writer
+	std::atomic<uint64_t> writeNanos{0}, encodeNanos{0};
+
+	BakeWriter(std::unique_ptr<Archive> archive, double interval);
+	void Run();
+
+  public:
+	/**
+		Creates the cache at path with a frame every `interval` seconds,
+		null if it can't be created
+	*/
+	static std::unique_ptr<BakeWriter> Open(const std::string &path,
+											double interval);
+	/** Writes out every queued frame and closes the cache */
+	~BakeWriter();
+	/**
+		Lets the writer thread finish the queue and stop without waiting
+		for it, no more frames may be written
+	*/
+	void Close();
+	/** Whether the queue is written out, so destroying it won't wait */
+	inline bool IsClosed() const { return closed; }
+
+	BakeWriter(const BakeWriter &) = delete;
+	BakeWriter &operator=(const BakeWriter &) = delete;
+
+	/** Queues the next frame, waiting while the writer is a pool behind */
+	void Write(const std::vector<Vec3f> &positions);
+
+	inline double GetInterval() const { return interval; }
+	inline size_t GetWritten() const { return written; }
+	inline size_t GetStalls() const { return stalls; }
+	/** Seconds Write has cost its callers so far */
+	inline double GetWriteSeconds() const { return writeNanos * 1e-9; }
+	inline double GetEncodeSeconds() const { return encodeNanos * 1e-9; }
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef _FLUID_SOLVER_H_
+#define _FLUID_SOLVER_H_
+
+#include "common/typedefs.hpp"
+#include "sim/neighbor_grid.hpp"
+#include "sim/particle_store.hpp"
+#include "sim/sdf_collider.hpp"
+#include "sim/sph_kernels.hpp"
+#include "sim/sph_simd.hpp"
+
+namespace engine {
+
+/**
+	Particle fluid solver stepping a cell-sorted particle store inside a box
+*/
+class FluidSolver {
+  protected:
+	ParticleStore particles;
+	NeighborGrid grid;
+	float spacing = 0;
+	size_t steps = 0;
+	// length of the step in progress
+	float dt = 0;
+	std::vector<std::shared_ptr<const SdfCollider>> colliders;
+
+	/** Mass putting the seeding lattice at restDensity under `kernel` */
+	float LatticeMass(const Poly6Kernel &kernel, float restDensity) const;
+	/** Particle i's position and velocity against the whole store */
+	SphQuery Query(size_t i, float h) const;
+	/** Speed of the fastest particle */
+	float MaxSpeed() const;
+	/** Largest acceleration the last force pass left in ax, ay, az */
+	float MaxAcceleration() const;
+
+	/**
+		Pushes a particle of `radius` at (x, y, z) out of every collider it
+		overlaps. False if none touched it, else normal is the outward
+		surface normal of the last one.
+	*/
+	inline bool Collide(float &x, float &y, float &z, float radius,
+						Vec3f &normal) const {
+		bool hit = false;
+		for (const std::shared_ptr<const SdfCollider> &collider : colliders) {
+			float d;
+			Vec3f gradient;
+			if (!collider->Sample(x, y, z, d, gradient) || d >= radius)
+				continue;
+			const float length = gradient.Length();
+			if (length <= 0.0f)
+				continue;
+			normal = gradient / length;
+			x += normal.x * (radius - d);
+			y += normal.y * (radius - d);
+			z += normal.z * (radius - d);
+			hit = true;
+		}
+		return hit;
+	}
+
+  public:
+	virtual ~FluidSolver() = default;
+
+	/** Short name for logs */
+	virtual const char *GetName() const = 0;
+	/** Step of a fixed-step run */
+	virtual float GetTimeStep() const = 0;
+	/**
+		Longest step the current velocities and accelerations allow (CFL
+		condition), at most MaxTimeStep
+	*/
+	virtual float StableTimeStep() const = 0;
+	/** Longest step the solver stays stable at in any state */
+	virtual float MaxTimeStep() const = 0;
+	virtual void GetDomain(Vec3f &boundMin, Vec3f &boundMax) const = 0;
+	/** Advances the particles by `dt` seconds */
+	virtual void Step(float dt) = 0;
+
+	void Clear();
+	/** Static obstacles in the solver's space, replacing any earlier ones */
+	inline void
+	SetColliders(std::vector<std::shared_ptr<const SdfCollider>> sdfs) {
+		colliders = std::move(sdfs);
+	}
+	/** Fills the box with particles on a grid at the rest spacing */
+	void AddBlock(const Vec3f &boundMin, const Vec3f &boundMax,
+				  const Vec3f &velocity = Vec3f(0.0f));
+
+	inline const ParticleStore &GetParticles() const { return particles; }
+	inline size_t NumParticles() const { return particles.Size(); }
+	inline size_t GetSteps() const { return steps; }
+	inline float GetSpacing() const { return spacing; }
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _NEIGHBOR_GRID_H_
+#define _NEIGHBOR_GRID_H_
+
+#include "common/neighbor_search.hpp"
+#include "common/typedefs.hpp"
+#include "sim/particle_store.hpp"
+#include <cstdint>
+
+namespace engine {
+
+/**
+	Neighbour search over a fixed domain with cells one kernel radius wide
+
+	Build sorts the particles by cell, so each cell's particles sit in one
+	contiguous range of the store and a neighbourhood is at most 9 row
+	ranges of nearby memory. The store is only permuted when some particle
+	changed cell since the last step.
+*/
+class NeighborGrid {
+  private:
+	NeighborSearch search;
+
+  public:
+	void Configure(const Vec3f &boundMin, const Vec3f &boundMax,
+				   float cellSize);
+	/** Sorts the store by cell and rebuilds the cell ranges */
+	void Build(ParticleStore &particles);
+
+	inline size_t NumCells() const { return search.NumKeys(); }
+
+	/**
+		Calls fn(begin, end) for the store ranges holding particle i's 27
+		neighbouring cells, the x neighbours of each row merged into one
+	*/
+	template <typename Fn>
+	void ForEachRange(const ParticleStore &p, size_t i, Fn &&fn) const {
+		search.ForEachRange(p.px[i], p.py[i], p.pz[i], fn);
+	}
+
+	/**
+		Calls fn(j, dx, dy, dz, r2) for every particle j within `radius` of
+		particle i, i itself included, with d = x_i - x_j
+	*/
+	template <typename Fn>
+	void ForEachNeighbor(const ParticleStore &p, size_t i, float radius,
+						 Fn &&fn) const {
+		const float xi = p.px[i], yi = p.py[i], zi = p.pz[i];
+		const float radius2 = radius * radius;
+		ForEachRange(p, i, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t j = begin; j < end; ++j) {
+				const float dx = xi - p.px[j], dy = yi - p.py[j],
+							dz = zi - p.pz[j];
+				const float r2 = dx * dx + dy * dy + dz * dz;
+				if (r2 < radius2)
+					fn(j, dx, dy, dz, r2);
+			}
+		});
+	}
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _PARTICLE_STORE_H_
+#define _PARTICLE_STORE_H_
+
+#include "common/aligned_allocator.hpp"
+#include "common/typedefs.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+/**
+	Structure-of-arrays particle state, one array per scalar so the solver
+	passes stream through only what they read
+*/
+struct ParticleStore {
+	FloatArray px, py, pz;
+	FloatArray vx, vy, vz;
+	FloatArray density, pressure;
+	// acceleration from the last force pass
+	FloatArray ax, ay, az;
+	// index each particle was added with, follows it through Permute
+	std::vector<uint32_t> id;
+	// Permute gathers each array into these and swaps, so they keep the
+	// previous array's storage for the next one
+	FloatArray scratch;
+	std::vector<uint32_t> scratchId;
+
+	inline size_t Size() const { return px.size(); }
+	inline Vec3f Position(size_t i) const { return {px[i], py[i], pz[i]}; }
+
+	void Clear();
+	void Add(const Vec3f &position, const Vec3f &velocity);
+	/** Moves every array so slot i holds what slot order[i] held */
+	void Permute(const std::vector<uint32_t> &order);
+	/**
+		Interleaved positions indexed by particle id, so every copy lists
+		the particles in the same order however the store was sorted
+	*/
+	void CopyPositions(std::vector<Vec3f> &out) const;
+};
+
+} // namespace engine
+
+#endif
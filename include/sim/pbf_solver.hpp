@@ -0,0 +1,93 @@
+#ifndef _PBF_SOLVER_H_
+#define _PBF_SOLVER_H_
+
+#include "common/typedefs.hpp"
+#include "sim/fluid_solver.hpp"
+#include "sim/sph_kernels.hpp"
+#include "sim/wall_density.hpp"
+#include <vector>
+
+namespace engine {
+
+struct PbfSettings {
+	// particles are seeded 2 * particleRadius apart
+	float particleRadius = 0.01f;
+	float restDensity = 1000.0f;
+	// density constraint projections per step
+	int iterations = 4;
+	// constraint force mixing, softens the constraint near zero gradient
+	float relaxation = 100.0f;
+	// tensile instability correction s_corr = -k * (W(r) / W(dq * h))^n,
+	// keeps surface particles from clumping. k is the density error the
+	// correction is worth at r = dq * h
+	float tensileK = 0.1f;
+	float tensileDq = 0.2f;
+	int tensileN = 4;
+	// XSPH velocity smoothing, 0 turns it off
+	float xsphViscosity = 0.01f;
+	// vorticity confinement epsilon, 0 turns it off
+	float vorticity = 0.0f;
+	Vec3f gravity = Vec3f(0.0f, -9.81f, 0.0f);
+	// unconditionally stable, the step only limits how far particles move
+	// between neighbour searches
+	float timeStep = 1.0f / 120.0f;
+	// adaptive steps: the fastest particle crosses at most cflNumber * h
+	// per step, and no step is longer than maxTimeStep, past which the
+	// fixed iteration count leaves the fluid visibly compressible
+	float cflNumber = 0.6f;
+	float maxTimeStep = 1.0f / 60.0f;
+	// particles are kept inside this box
+	Vec3f domainMin = Vec3f(0.0f), domainMax = Vec3f(1.0f);
+};
+
+/**
+	Position based fluids (Macklin & Müller 2013)
+
+	Positions are predicted from gravity, sorted into the neighbour grid and
+	then projected onto the density constraint a fixed number of times.
+	Every projection is Jacobi style: all multipliers are computed from the
+	same positions, then all corrections, so the result doesn't depend on
+	how the passes are split across threads.
+*/
+class PbfSolver : public FluidSolver {
+  private:
+	PbfSettings settings;
+	// poly6 for density, spiky for constraint gradients
+	Poly6Kernel kernel;
+	SpikyKernel gradKernel;
+	float mass, invTensileW, tensileScale;
+	WallDensityTable walls;
+
+	// positions after prediction, velocity comes from how far they moved
+	FloatArray startX, startY, startZ;
+	FloatArray lambda;
+	FloatArray deltaX, deltaY, deltaZ;
+	// vorticity, then smoothed velocity
+	FloatArray scratchX, scratchY, scratchZ;
+
+	/** Density the domain walls add to particle i, and its gradient */
+	void WallTerms(size_t i, float &density, Vec3f &gradient) const;
+
+	void Predict();
+	void ComputeLambda();
+	void ApplyCorrections();
+	void UpdateVelocities();
+	void ConfineVorticity();
+	void SmoothVelocities();
+
+  public:
+	explicit PbfSolver(const PbfSettings &settings = PbfSettings());
+
+	const char *GetName() const override { return "pbf"; }
+	float GetTimeStep() const override { return settings.timeStep; }
+	float StableTimeStep() const override;
+	float MaxTimeStep() const override { return settings.maxTimeStep; }
+	void GetDomain(Vec3f &boundMin, Vec3f &boundMax) const override;
+	void Step(float dt) override;
+
+	inline const PbfSettings &GetSettings() const { return settings; }
+};
+
+} // namespace engine
+
+#endif
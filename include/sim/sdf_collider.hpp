@@ -0,0 +1,97 @@
+#ifndef _SDF_COLLIDER_H_
+#define _SDF_COLLIDER_H_
+
+#include "common/typedefs.hpp"
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+/**
+	Static obstacle as a narrow-band signed distance grid, negative inside
+
+	Baked once from a triangle mesh: voxels within `band` of the surface
+	hold the exact distance, signed by the angle-weighted pseudonormal of
+	the closest feature, and everything further is +-band, flood filled
+	from the side of the band it touches. A particle then costs one
+	trilinear lookup however many triangles the mesh has.
+*/
+class SdfCollider {
+  private:
+	Vec3f origin;
+	float cellSize = 1, invCellSize = 1;
+	float band = 0;
+	// samples at origin + (x, y, z) * cellSize, x fastest
+	int dims[3] = {0, 0, 0};
+	std::vector<float> distance;
+
+	inline float At(int x, int y, int z) const {
+		return distance[((size_t)z * dims[1] + y) * dims[0] + x];
+	}
+
+	bool Load(const std::string &path, uint64_t hash);
+	void Save(const std::string &path, uint64_t hash) const;
+
+  public:
+	/**
+		Bakes the field of the triangles (indices into positions, three per
+		triangle) over their bounds grown by `band` and clipped to the clip
+		box, reusing a bake of the same inputs from cacheDir when there is
+		one. Null when nothing of the mesh is inside the clip box.
+	*/
+	static std::shared_ptr<SdfCollider>
+	Bake(const std::vector<Vec3f> &positions,
+		 const std::vector<unsigned int> &indices, float cellSize, float band,
+		 const Vec3f &clipMin, const Vec3f &clipMax,
+		 const std::string &cacheDir = "assets/caches/sdf");
+
+	inline float GetBand() const { return band; }
+	inline float GetCellSize() const { return cellSize; }
+	inline size_t NumSamples() const { return distance.size(); }
+	void GetBounds(Vec3f &boundMin, Vec3f &boundMax) const;
+
+	/**
+		Trilinear distance at p and its gradient, pointing away from the
+		surface outside. False outside the grid, where p is at least `band`
+		from the mesh.
+	*/
+	inline bool Sample(float px, float py, float pz, float &d,
+					   Vec3f &gradient) const {
+		const float gx = (px - origin.x) * invCellSize,
+					gy = (py - origin.y) * invCellSize,
+					gz = (pz - origin.z) * invCellSize;
+		if (!(gx >= 0.0f && gy >= 0.0f && gz >= 0.0f &&
+			  gx < (float)(dims[0] - 1) && gy < (float)(dims[1] - 1) &&
+			  gz < (float)(dims[2] - 1)))
+			return false;
+		const int x = (int)gx, y = (int)gy, z = (int)gz;
+		const float fx = gx - x, fy = gy - y, fz = gz - z;
+
+		const float c000 = At(x, y, z), c100 = At(x + 1, y, z),
+					c010 = At(x, y + 1, z), c110 = At(x + 1, y + 1, z),
+					c001 = At(x, y, z + 1), c101 = At(x + 1, y, z + 1),
+					c011 = At(x, y + 1, z + 1), c111 = At(x + 1, y + 1, z + 1);
+		// along x, then y, then z
+		const float c00 = c000 + (c100 - c000) * fx,
+					c10 = c010 + (c110 - c010) * fx,
+					c01 = c001 + (c101 - c001) * fx,
+					c11 = c011 + (c111 - c011) * fx;
+		const float c0 = c00 + (c10 - c00) * fy, c1 = c01 + (c11 - c01) * fy;
+		d = c0 + (c1 - c0) * fz;
+
+		const float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * fy,
+					dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * fy;
+		gradient.x = (dx0 + (dx1 - dx0) * fz) * invCellSize;
+		gradient.y = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * fz) *
+					 invCellSize;
+		gradient.z = (c1 - c0) * invCellSize;
+		return true;
+	}
+};
+
+} // namespace engine
+
+#endif
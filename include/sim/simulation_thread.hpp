@@ -0,0 +1,158 @@
+#ifndef _SIMULATION_THREAD_H_
+#define _SIMULATION_THREAD_H_
+
+#include "common/triple_buffer.hpp"
+#include "common/typedefs.hpp"
+#include "sim/bake_writer.hpp"
+#include "sim/fluid_solver.hpp"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+/** Two consecutive solver states, for the renderer to interpolate */
+struct SimFrame {
+	// indexed by particle id, `previous` is one time step before `current`
+	std::vector<Vec3f> previous, current;
+	// sim time of `current`, and how long before it `previous` was
+	double time = 0, step = 0;
+	// counts every publish, so readers can tell a new frame
+	size_t sequence = 0;
+};
+
+/** What the sim did between two SimulationThread::TakeStats */
+struct SimStats {
+	size_t steps = 0;
+	// spent stepping, and simulated by those steps
+	double seconds = 0, simulated = 0;
+	double minStep = 0, maxStep = 0;
+};
+
+/**
+	Steps a solver on its own thread, by the solver's fixed time step or
+	by the longest its CFL condition allows
+
+	The owner advances a target time, usually by the frame time, and the
+	thread steps until it reaches it, then sleeps: the sim keeps pace with
+	real time, and stops when the owner stops advancing it (paused or
+	inactive scenes). Adaptive steps are kept to at most maxSubsteps per
+	Advance by lengthening them past the CFL limit, though never past the
+	solver's MaxTimeStep, so a violent moment costs accuracy rather than
+	frames. Every step is published through a triple buffer the render
+	thread reads without locking, so a slow step never holds up a frame.
+*/
+class SimulationThread {
+  private:
+	std::unique_ptr<FluidSolver> solver;
+	const double fixedStep;
+
+	// guards the time targets, the step settings and the sleep
+	std::mutex mutex;
+	std::condition_variable wake;
+	double simTime = 0, targetTime = 0;
+	// length of the next step, and of the last Advance
+	double timeStep, frameTime = 0;
+	bool adaptive = true;
+	int maxSubsteps = 32;
+	// bumped by Restart, a step planned before one is dropped
+	size_t restarts = 0;
+	bool stopping = false;
+	// held for every step, so Restart can swap the particles safely
+	std::mutex stepMutex;
+
+	TripleBuffer<SimFrame> frames;
+	// last published state, the next frame's `previous`
+	std::vector<Vec3f> latest;
+	size_t sequence = 0;
+
+	// gets a published state every recorder->GetInterval() seconds of
+	// simulated time, counted in steps so lag drops don't skip frames.
+	// swapped only by the sim thread, stepMutex held
+	std::unique_ptr<BakeWriter> recorder;
+	double recordTime = 0, nextRecord = 0;
+	// writers passed to Record, for the sim thread to take between steps,
+	// mutex held
+	std::vector<std::unique_ptr<BakeWriter>> handoff;
+	// replaced writers finishing their queue, freed once they have,
+	// stepMutex held
+	std::vector<std::unique_ptr<BakeWriter>> retired;
+	// what Record last passed in, for the render thread
+	const BakeWriter *recording = nullptr;
+
+	std::mutex statsMutex;
+	SimStats stats;
+
+	std::thread thread;
+
+	void Run();
+	/**
+		Publishes the solver's state `time` seconds in, `step` after the
+		last one, stepMutex held
+	*/
+	void Publish(double time, double step, bool restarted);
+	/**
+		Length of the next step given the solver's stable and maximum
+		ones, mutex held
+	*/
+	double ChooseStep(double stable, double ceiling) const;
+	/** Starts recording to `writer` and retires the old one, sim thread */
+	void SwapRecorder(std::unique_ptr<BakeWriter> writer);
+	/** Closes `writer` without waiting for its queue, stepMutex held */
+	void Retire(std::unique_ptr<BakeWriter> writer);
+
+  public:
+	// backlog past which the sim gives up on real time and drops it
+	static constexpr int maxLagSteps = 8;
+
+	/** Starts idle, with the solver's current particles published */
+	explicit SimulationThread(std::unique_ptr<FluidSolver> solver);
+	/** Finishes the step in flight and joins */
+	~SimulationThread();
+
+	SimulationThread(const SimulationThread &) = delete;
+	SimulationThread &operator=(const SimulationThread &) = delete;
+
+	/** Lets the sim run `dt` seconds further */
+	void Advance(double dt);
+	/**
+		Adaptive steps, capped at maxSubsteps per Advance, or the solver's
+		fixed step
+	*/
+	void SetAdaptive(bool enabled, int maxSubsteps);
+	/**
+		Waits for the step in flight, lets `refill` rebuild the particles
+		and rewinds the clocks to zero. Stops recording, a cache never
+		joins two runs.
+	*/
+	void Restart(const std::function<void(FluidSolver &)> &refill);
+	/** Waits for the step in flight and lets `edit` change the solver */
+	void Edit(const std::function<void(FluidSolver &)> &edit);
+	/**
+		Hands the states published from the next step on to `writer`, one
+		per its interval. Null stops recording. Returns at once: the sim
+		thread switches writers between steps and lets the previous one
+		finish writing in the background.
+	*/
+	void Record(std::unique_ptr<BakeWriter> writer);
+	/** Writer last passed to Record, only for the thread that calls it */
+	inline const BakeWriter *GetRecorder() const { return recording; }
+
+	/**
+		Newest published frame, valid until the next call. Only the render
+		thread may call this
+	*/
+	const SimFrame &Latest();
+	/** Short name of the solver, for logs */
+	inline const char *GetName() const { return solver->GetName(); }
+
+	/** What the sim did since the last call */
+	SimStats TakeStats();
+};
+
+} // namespace engine
+
+#endif
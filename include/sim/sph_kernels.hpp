@@ -0,0 +1,54 @@
+#ifndef _SPH_KERNELS_H_
+#define _SPH_KERNELS_H_
+
+#include <cmath>
+
+namespace engine {
+
+/**
+	Poly6 density kernel (Müller et al. 2003), support h
+*/
+struct Poly6Kernel {
+	float h = 1, h2 = 1;
+	float k = 0;
+
+	Poly6Kernel() = default;
+	explicit Poly6Kernel(float radius)
+		: h(radius), h2(radius * radius),
+		  k(315.0f / (64.0f * (float)M_PI * std::pow(radius, 9.0f))) {}
+
+	/** W from the squared distance, no square root needed */
+	inline float W2(float r2) const {
+		if (r2 >= h2)
+			return 0.0f;
+		const float a = h2 - r2;
+		return k * a * a * a;
+	}
+};
+
+/**
+	Spiky kernel gradient (Desbrun & Gascuel 1996), which unlike poly6 and
+	the cubic spline doesn't vanish as particles get close
+*/
+struct SpikyKernel {
+	float h = 1;
+	float l = 0;
+
+	SpikyKernel() = default;
+	explicit SpikyKernel(float radius)
+		: h(radius), l(-45.0f / ((float)M_PI * std::pow(radius, 6.0f))) {}
+
+	/**
+		Scale s with grad W(d) = s * d for an offset d of length r > 0
+	*/
+	inline float GradScale(float r) const {
+		if (r >= h || r <= 1e-9f)
+			return 0.0f;
+		const float a = h - r;
+		return l * a * a / r;
+	}
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _SPH_SIMD_H_
+#define _SPH_SIMD_H_
+
+#include <cstdint>
+#include <string>
+
+namespace engine {
+
+/*
+Simd Level:
+	Scalar - one neighbour at a time, any CPU
+	Avx2 - 8 neighbours per instruction, AVX2 + FMA
+	Avx512 - 16 neighbours per instruction, AVX-512F
+*/
+enum class SimdLevel {
+	Scalar,
+	Avx2,
+	Avx512,
+};
+
+bool parseSimdLevel(const std::string &name, SimdLevel &level);
+const char *simdLevelName(SimdLevel level);
+/** Widest level the CPU and OS support */
+SimdLevel detectSimdLevel();
+
+/**
+	One particle's view of the neighbour arrays. Fields a kernel doesn't
+	use may be left unset.
+*/
+struct SphQuery {
+	const float *px, *py, *pz;
+	const float *vx = nullptr, *vy = nullptr, *vz = nullptr;
+	const float *density = nullptr, *pressure = nullptr, *lambda = nullptr;
+
+	float xi, yi, zi;
+	float vxi = 0, vyi = 0, vzi = 0;
+	// p_i / rho_i^2
+	float pressureI = 0;
+	float lambdaI = 0;
+
+	// kernel support and its square
+	float h, h2;
+	// PBF s_corr = -tensileScale * ((h^2 - r^2)^3 * invTensileW)^tensileN
+	float tensileScale = 0, invTensileW = 0;
+	int tensileN = 4;
+};
+
+/**
+	Neighbour sums, accumulated across ranges. The kernels leave out the
+	normalisation and mass constants, with a = h - r:
+		density: sum (h^2 - r^2)^3
+		x, y, z: sum of a weight times (a^2 / r) * d, d = x_i - x_j
+		gradSq: sum a^4
+		vx, vy, vz: velocity differences v_j - v_i, weighted
+*/
+struct SphSums {
+	float density = 0;
+	float x = 0, y = 0, z = 0;
+	float gradSq = 0;
+	float vx = 0, vy = 0, vz = 0;
+};
+
+/**
+	Neighbour loops over one contiguous range [begin, end) of the cell
+	sorted store, pairs closer than h only. The particle itself is skipped
+	by every sum that would divide by its zero distance.
+*/
+struct SphKernels {
+	SimdLevel level;
+	/** density */
+	void (*poly6)(const SphQuery &, uint32_t, uint32_t, SphSums &);
+	/** density, spiky gradient in xyz and gradSq, for PBF's multipliers */
+	void (*lambdaTerms)(const SphQuery &, uint32_t, uint32_t, SphSums &);
+	/** xyz weighted by lambda_i + lambda_j + s_corr, PBF's correction */
+	void (*corrections)(const SphQuery &, uint32_t, uint32_t, SphSums &);
+	/**
+		xyz weighted by p_i / rho_i^2 + p_j / rho_j^2, and the viscosity
+		Laplacian sum of (v_j - v_i) * a / rho_j
+	*/
+	void (*pressureViscosity)(const SphQuery &, uint32_t, uint32_t,
+							  SphSums &);
+	/** sum of (v_j - v_i) * (h^2 - r^2)^3 / rho_j, XSPH smoothing */
+	void (*xsph)(const SphQuery &, uint32_t, uint32_t, SphSums &);
+};
+
+/** Kernels of the current level, the widest supported one by default */
+const SphKernels &sphKernels();
+/** Picks a level, capped at what the CPU supports. Returns the result. */
+SimdLevel setSimdLevel(SimdLevel level);
+
+} // namespace engine
+
+#endif
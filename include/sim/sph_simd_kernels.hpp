@@ -0,0 +1,202 @@
+#ifndef _SPH_SIMD_KERNELS_H_
+#define _SPH_SIMD_KERNELS_H_
+
+#include "sim/sph_simd.hpp"
+
+/*
+	Bodies of the SphKernels loops, written once against a lane type L:
+
+		V, M                    vector and mask types
+		width                   floats per V
+		all(), firstN(n)        masks of every lane and of the first n
+		load(p, m)              p[0..width), zero where m is off
+		set1, zero, add, sub, mul, div, fmadd(a, b, c) = a * b + c, sqrt
+		lt(a, b), gt(a, b), and_(m, n)
+		select(m, v)            v where m is on, zero elsewhere
+		reduce(v)               sum of the lanes
+
+	Only the sph_simd*.cpp files include this, each after switching its
+	instruction set on. The templates are in an anonymous namespace so no
+	instantiation built for one instruction set can be picked by the linker
+	for another translation unit.
+*/
+
+namespace engine {
+
+const SphKernels *sphKernelsScalar();
+/** Null when the build has no such code path */
+const SphKernels *sphKernelsAvx2();
+const SphKernels *sphKernelsAvx512();
+
+namespace {
+
+template <typename L, typename Body>
+inline void forLanes(uint32_t begin, uint32_t end, Body &&body) {
+	uint32_t j = begin;
+	for (; j + L::width <= end; j += L::width)
+		body(j, L::all());
+	if (j < end)
+		body(j, L::firstN((int)(end - j)));
+}
+
+/** Offsets to the neighbours in lanes j.., and which are within h */
+template <typename L> struct Pair {
+	typename L::V dx, dy, dz, r2;
+	typename L::M near;
+
+	inline Pair(const SphQuery &q, uint32_t j, typename L::M m) {
+		dx = L::sub(L::set1(q.xi), L::load(q.px + j, m));
+		dy = L::sub(L::set1(q.yi), L::load(q.py + j, m));
+		dz = L::sub(L::set1(q.zi), L::load(q.pz + j, m));
+		r2 = L::fmadd(dx, dx, L::fmadd(dy, dy, L::mul(dz, dz)));
+		near = L::and_(m, L::lt(r2, L::set1(q.h2)));
+	}
+
+	/** Neighbours within h other than the particle itself */
+	inline typename L::M Apart() const {
+		return L::and_(near, L::gt(r2, L::set1(1e-18f)));
+	}
+};
+
+template <typename L>
+void poly6Lanes(const SphQuery &q, uint32_t begin, uint32_t end,
+				SphSums &sums) {
+	using V = typename L::V;
+	V density = L::zero();
+	forLanes<L>(begin, end, [&](uint32_t j, typename L::M m) {
+		const Pair<L> pair(q, j, m);
+		const V a = L::sub(L::set1(q.h2), pair.r2);
+		density = L::add(density, L::select(pair.near, L::mul(L::mul(a, a), a)));
+	});
+	sums.density += L::reduce(density);
+}
+
+template <typename L>
+void lambdaTermsLanes(const SphQuery &q, uint32_t begin, uint32_t end,
+					  SphSums &sums) {
+	using V = typename L::V;
+	V density = L::zero(), gx = L::zero(), gy = L::zero(), gz = L::zero(),
+	  gradSq = L::zero();
+	forLanes<L>(begin, end, [&](uint32_t j, typename L::M m) {
+		const Pair<L> pair(q, j, m);
+		const V a = L::sub(L::set1(q.h2), pair.r2);
+		density = L::add(density, L::select(pair.near, L::mul(L::mul(a, a), a)));
+
+		const typename L::M apart = pair.Apart();
+		const V r = L::sqrt(pair.r2);
+		const V ar = L::sub(L::set1(q.h), r);
+		const V ar2 = L::mul(ar, ar);
+		const V s = L::select(apart, L::div(ar2, r));
+		gx = L::fmadd(s, pair.dx, gx);
+		gy = L::fmadd(s, pair.dy, gy);
+		gz = L::fmadd(s, pair.dz, gz);
+		gradSq = L::add(gradSq, L::select(apart, L::mul(ar2, ar2)));
+	});
+	sums.density += L::reduce(density);
+	sums.x += L::reduce(gx);
+	sums.y += L::reduce(gy);
+	sums.z += L::reduce(gz);
+	sums.gradSq += L::reduce(gradSq);
+}
+
+template <typename L>
+void correctionsLanes(const SphQuery &q, uint32_t begin, uint32_t end,
+					  SphSums &sums) {
+	using V = typename L::V;
+	V cx = L::zero(), cy = L::zero(), cz = L::zero();
+	forLanes<L>(begin, end, [&](uint32_t j, typename L::M m) {
+		const Pair<L> pair(q, j, m);
+		const typename L::M apart = pair.Apart();
+
+		V weight = L::add(L::set1(q.lambdaI), L::load(q.lambda + j, m));
+		if (q.tensileScale > 0.0f) {
+			const V a = L::sub(L::set1(q.h2), pair.r2);
+			const V ratio = L::mul(L::mul(L::mul(a, a), a),
+								   L::set1(q.invTensileW));
+			V power = ratio;
+			for (int n = 1; n < q.tensileN; ++n)
+				power = L::mul(power, ratio);
+			weight = L::fmadd(L::set1(-q.tensileScale), power, weight);
+		}
+
+		const V r = L::sqrt(pair.r2);
+		const V ar = L::sub(L::set1(q.h), r);
+		const V s = L::select(apart, L::mul(weight, L::div(L::mul(ar, ar), r)));
+		cx = L::fmadd(s, pair.dx, cx);
+		cy = L::fmadd(s, pair.dy, cy);
+		cz = L::fmadd(s, pair.dz, cz);
+	});
+	sums.x += L::reduce(cx);
+	sums.y += L::reduce(cy);
+	sums.z += L::reduce(cz);
+}
+
+template <typename L>
+void pressureViscosityLanes(const SphQuery &q, uint32_t begin, uint32_t end,
+							SphSums &sums) {
+	using V = typename L::V;
+	V fx = L::zero(), fy = L::zero(), fz = L::zero();
+	V ux = L::zero(), uy = L::zero(), uz = L::zero();
+	forLanes<L>(begin, end, [&](uint32_t j, typename L::M m) {
+		const Pair<L> pair(q, j, m);
+		const typename L::M apart = pair.Apart();
+
+		const V rhoJ = L::load(q.density + j, m);
+		const V r = L::sqrt(pair.r2);
+		const V ar = L::sub(L::set1(q.h), r);
+
+		// masked-off lanes divide by a zero density, select drops them
+		const V term = L::add(L::set1(q.pressureI),
+							  L::div(L::load(q.pressure + j, m),
+									 L::mul(rhoJ, rhoJ)));
+		const V s = L::select(apart, L::mul(term, L::div(L::mul(ar, ar), r)));
+		fx = L::fmadd(s, pair.dx, fx);
+		fy = L::fmadd(s, pair.dy, fy);
+		fz = L::fmadd(s, pair.dz, fz);
+
+		const V w = L::select(apart, L::div(ar, rhoJ));
+		ux = L::fmadd(L::sub(L::load(q.vx + j, m), L::set1(q.vxi)), w, ux);
+		uy = L::fmadd(L::sub(L::load(q.vy + j, m), L::set1(q.vyi)), w, uy);
+		uz = L::fmadd(L::sub(L::load(q.vz + j, m), L::set1(q.vzi)), w, uz);
+	});
+	sums.x += L::reduce(fx);
+	sums.y += L::reduce(fy);
+	sums.z += L::reduce(fz);
+	sums.vx += L::reduce(ux);
+	sums.vy += L::reduce(uy);
+	sums.vz += L::reduce(uz);
+}
+
+template <typename L>
+void xsphLanes(const SphQuery &q, uint32_t begin, uint32_t end,
+			   SphSums &sums) {
+	using V = typename L::V;
+	V ux = L::zero(), uy = L::zero(), uz = L::zero();
+	forLanes<L>(begin, end, [&](uint32_t j, typename L::M m) {
+		const Pair<L> pair(q, j, m);
+		const V a = L::sub(L::set1(q.h2), pair.r2);
+		const V w = L::select(pair.near, L::div(L::mul(L::mul(a, a), a),
+												L::load(q.density + j, m)));
+		ux = L::fmadd(L::sub(L::load(q.vx + j, m), L::set1(q.vxi)), w, ux);
+		uy = L::fmadd(L::sub(L::load(q.vy + j, m), L::set1(q.vyi)), w, uy);
+		uz = L::fmadd(L::sub(L::load(q.vz + j, m), L::set1(q.vzi)), w, uz);
+	});
+	sums.vx += L::reduce(ux);
+	sums.vy += L::reduce(uy);
+	sums.vz += L::reduce(uz);
+}
+
+template <typename L> SphKernels makeSphKernels(SimdLevel level) {
+	return {level,
+			poly6Lanes<L>,
+			lambdaTermsLanes<L>,
+			correctionsLanes<L>,
+			pressureViscosityLanes<L>,
+			xsphLanes<L>};
+}
+
+} // namespace
+
+} // namespace engine
+
+#endif
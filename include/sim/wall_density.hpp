@@ -0,0 +1,49 @@
+#ifndef _WALL_DENSITY_H_
+#define _WALL_DENSITY_H_
+
+#include "sim/sph_kernels.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace engine {
+
+/**
+	Density a flat wall adds to a particle at distance d from it, and its
+	gradient along the wall normal, tabulated over [0, h]
+
+	The wall is modelled as a half-space of frozen particles on the seeding
+	lattice, so a particle resting against it sees a full neighbourhood
+	instead of being squeezed into the wall plane.
+*/
+class WallDensityTable {
+  private:
+	float h = 1, invStep = 1;
+	std::vector<float> density, gradient;
+
+  public:
+	static constexpr int samples = 64;
+
+	void Build(const Poly6Kernel &kernel, const SpikyKernel &gradKernel,
+			   float spacing, float mass);
+
+	/**
+		Density at distance d, and the normal component of its gradient
+		with respect to the particle position (negative, towards the wall)
+	*/
+	inline void Lookup(float d, float &outDensity,
+					   float &outGradient) const {
+		if (d >= h || density.empty()) {
+			outDensity = outGradient = 0.0f;
+			return;
+		}
+		const float x = std::max(d, 0.0f) * invStep;
+		const int i = std::min((int)x, samples - 1);
+		const float t = x - (float)i;
+		outDensity = density[i] + (density[i + 1] - density[i]) * t;
+		outGradient = gradient[i] + (gradient[i + 1] - gradient[i]) * t;
+	}
+};
+
+} // namespace engine
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _WCSPH_SOLVER_H_
+#define _WCSPH_SOLVER_H_
+
+#include "common/typedefs.hpp"
+#include "sim/fluid_solver.hpp"
+#include "sim/sph_kernels.hpp"
+
+namespace engine {
+
+struct WcsphSettings {
+	// particles are seeded 2 * particleRadius apart
+	float particleRadius = 0.01f;
+	float restDensity = 1000.0f;
+	// numerical speed of sound, ~10x the fastest flow keeps density
+	// within about 1% of rest
+	float soundSpeed = 20.0f;
+	// kinematic viscosity (m^2/s), far above water's so the flow stays
+	// smooth at this resolution
+	float viscosity = 0.02f;
+	Vec3f gravity = Vec3f(0.0f, -9.81f, 0.0f);
+	// fixed step, within the CFL limit 0.4 * h / soundSpeed
+	float timeStep = 0.0008f;
+	// adaptive steps: sound and the fastest particle cross at most
+	// cflNumber * h per step, and the largest acceleration moves a
+	// particle from rest at most forceNumber^2 * h
+	float cflNumber = 0.4f;
+	float forceNumber = 0.25f;
+	// particles are kept inside this box
+	Vec3f domainMin = Vec3f(0.0f), domainMax = Vec3f(1.0f);
+	// fraction of the normal velocity kept after hitting a wall
+	float wallRestitution = 0.1f;
+};
+
+/**
+	Weakly compressible SPH (Becker & Teschner 2007)
+
+	Each step sorts the particles into the neighbour grid, then runs the
+	density/pressure pass (poly6), the force pass (spiky pressure gradient,
+	viscosity kernel Laplacian, gravity) and a symplectic Euler
+	integration, each split across the cores with parallelFor and the
+	neighbour loops vectorised through sphKernels.
+*/
+class WcsphSolver : public FluidSolver {
+  private:
+	WcsphSettings settings;
+	Poly6Kernel kernel;
+	SpikyKernel gradKernel;
+	// Laplacian of the viscosity kernel, 45 / (pi h^6) * (h - r)
+	float laplacian;
+	float mass, stiffness;
+
+	void ComputeDensity();
+	void ComputeForces();
+	void Integrate();
+
+  public:
+	explicit WcsphSolver(const WcsphSettings &settings = WcsphSettings());
+
+	const char *GetName() const override { return "wcsph"; }
+	float GetTimeStep() const override { return settings.timeStep; }
+	float StableTimeStep() const override;
+	float MaxTimeStep() const override;
+	void GetDomain(Vec3f &boundMin, Vec3f &boundMax) const override;
+	void Step(float dt) override;
+
+	inline const WcsphSettings &GetSettings() const { return settings; }
+};
+
+} // namespace engine
+
+#endif
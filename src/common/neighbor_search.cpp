@@ -0,0 +1,253 @@
+#include "common/neighbor_search.hpp"
+#include "common/parallel.hpp"
+#include <limits>
+#include <mutex>
+#include <numeric>
+
+using namespace engine;
+
+namespace {
+
+// below this many points or keys per worker threads cost more than they
+// save
+constexpr size_t minPointsPerWorker = 4096;
+constexpr size_t minKeysPerWorker = 16384;
+// dense cells per point past which the grid switches to a hash table
+constexpr double maxCellsPerPoint = 8.0;
+
+} // namespace
+
+NeighborSearch::Points NeighborSearch::Points::soa(const float *x,
+												   const float *y,
+												   const float *z,
+												   size_t count) {
+	Points points;
+	points.x = x;
+	points.y = y;
+	points.z = z;
+	points.stride = 1;
+	points.count = count;
+	return points;
+}
+
+NeighborSearch::Points NeighborSearch::Points::of(const Vec3f *data,
+												  size_t count) {
+	Points points;
+	if (data != nullptr) {
+		points.x = &data->x;
+		points.y = &data->y;
+		points.z = &data->z;
+	}
+	points.stride = sizeof(Vec3f) / sizeof(float);
+	points.count = count;
+	return points;
+}
+
+void NeighborSearch::SetRadius(float radius) {
+	cellSize = radius;
+	invCellSize = 1.0f / radius;
+}
+
+void NeighborSearch::SetDomain(const Vec3f &boundMin, const Vec3f &boundMax) {
+	fixedDomain = true;
+	domainMin = boundMin;
+	domainMax = boundMax;
+}
+
+void NeighborSearch::ClearDomain() { fixedDomain = false; }
+
+void NeighborSearch::Layout(const Points &points) {
+	const size_t n = points.count;
+	Vec3f boundMin = domainMin, boundMax = domainMax;
+	if (!fixedDomain) {
+		boundMin = Vec3f(std::numeric_limits<float>::max());
+		boundMax = Vec3f(std::numeric_limits<float>::lowest());
+		std::mutex merge;
+		parallelFor(
+			n,
+			[&](size_t begin, size_t end) {
+				Vec3f lo(std::numeric_limits<float>::max());
+				Vec3f hi(std::numeric_limits<float>::lowest());
+				for (size_t i = begin; i < end; ++i) {
+					const float p[3] = {points.x[i * points.stride],
+										points.y[i * points.stride],
+										points.z[i * points.stride]};
+					for (int a = 0; a < 3; ++a) {
+						lo[a] = std::min(lo[a], p[a]);
+						hi[a] = std::max(hi[a], p[a]);
+					}
+				}
+				std::lock_guard<std::mutex> lock(merge);
+				for (int a = 0; a < 3; ++a) {
+					boundMin[a] = std::min(boundMin[a], lo[a]);
+					boundMax[a] = std::max(boundMax[a], hi[a]);
+				}
+			},
+			minPointsPerWorker);
+		if (boundMin.x > boundMax.x)
+			boundMin = boundMax = Vec3f(0.0f);
+	}
+
+	origin = boundMin;
+	double cells = 1.0;
+	for (int a = 0; a < 3; ++a) {
+		const double extent =
+			std::max((double)boundMax[a] - boundMin[a], 0.0) * invCellSize;
+		dims[a] = (int)std::min(std::max(std::ceil(extent), 1.0), 1e9);
+		cells *= dims[a];
+	}
+
+	hashed = cells > maxCellsPerPoint * n + 4096.0;
+	if (hashed) {
+		// power of two buckets, about two per point
+		numKeys = 1024;
+		while (numKeys < 2 * n)
+			numKeys *= 2;
+	} else {
+		numKeys = (size_t)cells;
+	}
+}
+
+void NeighborSearch::Sort() {
+	const size_t n = inputKeys.size();
+
+	if (keyCountsSize < numKeys) {
+		keyCounts.reset(new std::atomic<uint32_t>[numKeys]);
+		keyCountsSize = numKeys;
+	}
+	parallelFor(
+		numKeys,
+		[&](size_t begin, size_t end) {
+			for (size_t k = begin; k < end; ++k)
+				keyCounts[k].store(0, std::memory_order_relaxed);
+		},
+		minKeysPerWorker);
+
+	// counts, and each point's rank among its key's points
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				ranks[i] = keyCounts[inputKeys[i]].fetch_add(
+					1, std::memory_order_relaxed);
+		},
+		minPointsPerWorker);
+
+	// exclusive prefix sum: per-block totals, a serial scan over the
+	// blocks, then every block offsets its own range
+	keyStart.resize(numKeys + 1);
+	const size_t blocks = std::min(
+		workerCount(), std::max<size_t>(numKeys / minKeysPerWorker, 1));
+	auto blockBegin = [&](size_t b) { return numKeys * b / blocks; };
+	std::vector<size_t> blockSum(blocks + 1, 0);
+	parallelFor(blocks, [&](size_t first, size_t last) {
+		for (size_t b = first; b < last; ++b)
+			for (size_t k = blockBegin(b); k < blockBegin(b + 1); ++k)
+				blockSum[b + 1] +=
+					keyCounts[k].load(std::memory_order_relaxed);
+	});
+	for (size_t b = 0; b < blocks; ++b)
+		blockSum[b + 1] += blockSum[b];
+	parallelFor(blocks, [&](size_t first, size_t last) {
+		for (size_t b = first; b < last; ++b) {
+			uint32_t sum = (uint32_t)blockSum[b];
+			for (size_t k = blockBegin(b); k < blockBegin(b + 1); ++k) {
+				keyStart[k] = sum;
+				sum += keyCounts[k].load(std::memory_order_relaxed);
+			}
+		}
+	});
+	keyStart[numKeys] = (uint32_t)n;
+
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				order[keyStart[inputKeys[i]] + ranks[i]] = (uint32_t)i;
+		},
+		minPointsPerWorker);
+
+	// ranks from several threads interleave, restore input order within
+	// each key so the result doesn't depend on the thread count
+	if (std::min(workerCount(), n / minPointsPerWorker) > 1) {
+		parallelFor(
+			numKeys,
+			[&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end; ++k)
+					if (keyStart[k + 1] - keyStart[k] > 1)
+						std::sort(order.begin() + keyStart[k],
+								  order.begin() + keyStart[k + 1]);
+			},
+			minKeysPerWorker);
+	}
+}
+
+bool NeighborSearch::Build(const Points &points) {
+	const size_t n = points.count;
+	const size_t previousKeys = numKeys;
+	const bool previousHashed = hashed;
+	const Vec3f previousOrigin = origin;
+	const int previousDims[3] = {dims[0], dims[1], dims[2]};
+	Layout(points);
+	const bool sameLayout =
+		numKeys == previousKeys && hashed == previousHashed &&
+		origin == previousOrigin && dims[0] == previousDims[0] &&
+		dims[1] == previousDims[1] && dims[2] == previousDims[2];
+
+	inputKeys.resize(n);
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const size_t s = i * points.stride;
+				inputKeys[i] =
+					Key(CellCoord(points.x[s], 0), CellCoord(points.y[s], 1),
+						CellCoord(points.z[s], 2));
+			}
+		},
+		minPointsPerWorker);
+
+	// incremental rebuild: every point still in its slot's cell leaves the
+	// key ranges as they are
+	bool moved = !sameLayout || sortedKeys.size() != n;
+	if (!moved) {
+		std::atomic<bool> changed{false};
+		parallelFor(
+			n,
+			[&](size_t begin, size_t end) {
+				if (!std::equal(inputKeys.begin() + begin,
+								inputKeys.begin() + end,
+								sortedKeys.begin() + begin))
+					changed.store(true, std::memory_order_relaxed);
+			},
+			minPointsPerWorker);
+		moved = changed.load();
+	}
+
+	order.resize(n);
+	px.resize(n);
+	py.resize(n);
+	pz.resize(n);
+	if (moved) {
+		ranks.resize(n);
+		Sort();
+	} else {
+		std::iota(order.begin(), order.end(), 0u);
+	}
+
+	sortedKeys.resize(n);
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t s = begin; s < end; ++s) {
+				const size_t i = order[s];
+				const size_t src = i * points.stride;
+				px[s] = points.x[src];
+				py[s] = points.y[src];
+				pz[s] = points.z[src];
+				sortedKeys[s] = inputKeys[i];
+			}
+		},
+		minPointsPerWorker);
+	return moved;
+}
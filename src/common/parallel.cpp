@@ -0,0 +1,141 @@
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace engine;
+
+namespace {
+
+size_t hardwareWorkers() {
+	static const size_t count =
+		std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	return count;
+}
+
+std::atomic<size_t> workerOverride{0};
+
+// set on pool workers and on a thread while it runs a job, so a nested
+// parallelFor runs inline instead of waiting on the pool it is part of
+thread_local bool insideJob = false;
+
+/**
+	Threads parallelFor hands ranges to, kept for the life of the program
+
+	One job runs at a time. The calling thread does the first range and
+	worker i the (i + 1)th, so a job split n ways wakes n - 1 workers.
+*/
+class WorkerPool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable started, finished;
+	// held by whoever is running a job
+	std::mutex dispatch;
+
+	const std::function<void(size_t, size_t)> *fn = nullptr;
+	size_t count = 0, workers = 0, pending = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	void Run(size_t index, uint64_t seen) {
+		insideJob = true;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			started.wait(lock,
+						 [&]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			if (index >= workers)
+				continue;
+			const std::function<void(size_t, size_t)> &job = *fn;
+			const size_t first = count * index / workers,
+						 last = count * (index + 1) / workers;
+			lock.unlock();
+			job(first, last);
+			lock.lock();
+			if (--pending == 0)
+				finished.notify_one();
+		}
+	}
+
+  public:
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		started.notify_all();
+		for (std::thread &thread : threads)
+			thread.join();
+	}
+
+	/** Runs the job split `workers` ways, false if another job is running */
+	bool TryRun(size_t count, const std::function<void(size_t, size_t)> &fn,
+				size_t workers) {
+		std::unique_lock<std::mutex> busy(dispatch, std::try_to_lock);
+		if (!busy.owns_lock())
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (threads.size() + 1 < workers) {
+				threads.emplace_back(&WorkerPool::Run, this,
+									 threads.size() + 1, generation);
+			}
+			this->fn = &fn;
+			this->count = count;
+			this->workers = workers;
+			pending = workers - 1;
+			generation++;
+		}
+		started.notify_all();
+
+		insideJob = true;
+		fn(0, count / workers);
+		insideJob = false;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]() { return pending == 0; });
+		this->fn = nullptr;
+		return true;
+	}
+};
+
+WorkerPool &workerPool() {
+	static WorkerPool pool;
+	return pool;
+}
+
+} // namespace
+
+size_t engine::workerCount() {
+	const size_t count = workerOverride.load(std::memory_order_relaxed);
+	return count > 0 ? count : hardwareWorkers();
+}
+
+void engine::setWorkerCount(size_t count) {
+	workerOverride.store(count, std::memory_order_relaxed);
+}
+
+void engine::parallelFor(size_t count,
+						 const std::function<void(size_t, size_t)> &fn,
+						 size_t minPerWorker) {
+	if (count == 0)
+		return;
+
+	const size_t workers =
+		std::min(workerCount(), std::max<size_t>(count / minPerWorker, 1));
+	if (workers == 1) {
+		fn(0, count);
+		return;
+	}
+
+	// nested, or racing a job from another thread: the cores are busy
+	// anyway, so this one runs inline
+	if (insideJob || !workerPool().TryRun(count, fn, workers))
+		fn(0, count);
+}
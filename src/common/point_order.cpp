@@ -0,0 +1,194 @@
+#include "common/point_order.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+using namespace engine;
+
+bool engine::parsePointOrder(const std::string &name, PointOrder &order) {
+	if (name == "original")
+		order = PointOrder::Original;
+	else if (name == "morton")
+		order = PointOrder::Morton;
+	else if (name == "lod")
+		order = PointOrder::MortonLod;
+	else
+		return false;
+	return true;
+}
+
+const char *engine::pointOrderName(PointOrder order) {
+	switch (order) {
+	case PointOrder::Original:
+		return "original";
+	case PointOrder::Morton:
+		return "morton";
+	default:
+		return "lod";
+	}
+}
+
+// spreads the low 10 bits of v three apart
+static uint32_t expandBits(uint32_t v) {
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+uint32_t engine::mortonCode(const Vec3f &p, const Vec3f &boundMin,
+							const Vec3f &boundMax) {
+	uint32_t cell[3];
+	for (int i = 0; i < 3; ++i) {
+		float extent = std::max(boundMax[i] - boundMin[i], 1e-6f);
+		float t = std::clamp((p[i] - boundMin[i]) / extent, 0.0f, 1.0f);
+		cell[i] = std::min((uint32_t)(t * 1024.0f), 1023u);
+	}
+	return (expandBits(cell[0]) << 2) | (expandBits(cell[1]) << 1) |
+		   expandBits(cell[2]);
+}
+
+void engine::radixSort(std::vector<uint32_t> &keys,
+					   std::vector<uint32_t> &ids) {
+	constexpr int digitBits = 8;
+	constexpr size_t buckets = 1 << digitBits;
+	// below this many keys per worker threads cost more than they save
+	constexpr size_t minPerWorker = 16384;
+
+	const size_t n = keys.size();
+	const size_t workers =
+		std::min(workerCount(), std::max<size_t>(n / minPerWorker, 1));
+	auto chunkBegin = [&](size_t w) { return n * w / workers; };
+
+	std::vector<uint32_t> keysOut(n), idsOut(n);
+	std::vector<std::array<size_t, buckets>> offsets(workers);
+
+	for (int shift = 0; shift < 32; shift += digitBits) {
+		// per-chunk histograms
+		parallelFor(workers, [&](size_t first, size_t last) {
+			for (size_t w = first; w < last; ++w) {
+				offsets[w].fill(0);
+				for (size_t i = chunkBegin(w); i < chunkBegin(w + 1); ++i)
+					offsets[w][(keys[i] >> shift) & (buckets - 1)]++;
+			}
+		});
+
+		// exclusive scan, digit-major then chunk, keeps the sort stable
+		size_t sum = 0;
+		bool allInOneBucket = false;
+		for (size_t d = 0; d < buckets; ++d) {
+			size_t digitTotal = 0;
+			for (size_t w = 0; w < workers; ++w) {
+				size_t count = offsets[w][d];
+				offsets[w][d] = sum;
+				sum += count;
+				digitTotal += count;
+			}
+			allInOneBucket = allInOneBucket || digitTotal == n;
+		}
+		// every key shares this digit, the pass would be a copy
+		if (allInOneBucket)
+			continue;
+
+		parallelFor(workers, [&](size_t first, size_t last) {
+			for (size_t w = first; w < last; ++w) {
+				auto &offset = offsets[w];
+				for (size_t i = chunkBegin(w); i < chunkBegin(w + 1); ++i) {
+					size_t dst = offset[(keys[i] >> shift) & (buckets - 1)]++;
+					keysOut[dst] = keys[i];
+					idsOut[dst] = ids[i];
+				}
+			}
+		});
+		keys.swap(keysOut);
+		ids.swap(idsOut);
+	}
+}
+
+// LOD level of the point with the given rank along the curve, the coarsest
+// level holds every 2^(pointLodLevels - 1)-th rank
+static int lodLevel(size_t rank) {
+	int level = pointLodLevels - 1;
+	while (level > 0 && rank % ((size_t)1 << (pointLodLevels - level)) == 0)
+		level--;
+	return level;
+}
+
+static size_t ceilDiv(size_t a, size_t b) { return (a + b - 1) / b; }
+
+// ranks below r stored in `level`
+static size_t ranksInLevel(size_t r, int level) {
+	size_t stride = (size_t)1 << (pointLodLevels - 1 - level);
+	return level == 0 ? ceilDiv(r, stride)
+					  : ceilDiv(r, stride) - ceilDiv(r, stride * 2);
+}
+
+static size_t levelStart(size_t n, int level) {
+	return level == 0 ? 0 : lodPointCount(n, pointLodLevels - level);
+}
+
+size_t engine::rankSlot(size_t n, PointOrder order, size_t rank) {
+	if (order != PointOrder::MortonLod)
+		return rank;
+	int level = lodLevel(rank);
+	return levelStart(n, level) + ranksInLevel(rank, level);
+}
+
+void engine::lodLevelSlots(size_t n, int level, size_t rankBegin,
+						   size_t rankEnd, size_t &first, size_t &last) {
+	size_t start = levelStart(n, level);
+	first = start + ranksInLevel(std::min(rankBegin, n), level);
+	last = start + ranksInLevel(std::min(rankEnd, n), level);
+}
+
+std::vector<uint32_t> engine::orderPoints(std::vector<Vec3f> &points,
+										  const Vec3f &boundMin,
+										  const Vec3f &boundMax,
+										  PointOrder order) {
+	const size_t n = points.size();
+	std::vector<uint32_t> ids(n);
+	std::iota(ids.begin(), ids.end(), 0);
+	if (order == PointOrder::Original)
+		return ids;
+
+	std::vector<uint32_t> codes(n);
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const Vec3f &p = points[i];
+				bool outside = false;
+				for (int c = 0; c < 3; ++c)
+					outside = outside || p[c] < boundMin[c] ||
+							  p[c] > boundMax[c];
+				codes[i] = outside ? UINT32_MAX
+								   : mortonCode(p, boundMin, boundMax);
+			}
+		},
+		16384);
+	radixSort(codes, ids);
+
+	if (order == PointOrder::MortonLod) {
+		// counting sort by level, stable so each level stays in Morton order
+		size_t levelStart[pointLodLevels] = {};
+		for (size_t rank = 0; rank < n; ++rank) {
+			if (lodLevel(rank) + 1 < pointLodLevels)
+				levelStart[lodLevel(rank) + 1]++;
+		}
+		for (int level = 1; level < pointLodLevels; ++level)
+			levelStart[level] += levelStart[level - 1];
+
+		std::vector<uint32_t> byLevel(n);
+		for (size_t rank = 0; rank < n; ++rank)
+			byLevel[levelStart[lodLevel(rank)]++] = ids[rank];
+		ids.swap(byLevel);
+	}
+
+	std::vector<Vec3f> ordered(n);
+	for (size_t i = 0; i < n; ++i)
+		ordered[i] = points[ids[i]];
+	points = std::move(ordered);
+	return ids;
+}
@@ -1,9 +1,16 @@
 #include "components/fluid_simulation.hpp"
+#include "common/parallel.hpp"
+#include "common/point_order.hpp"
 #include "common/typedefs.hpp"
+#include "core/fluid_pipeline.hpp"
+#include "core/gpu_memory.hpp"
 #include "core/renderer.hpp"
 #include "core/scene_object.hpp"
-#include "objects/camera.hpp"
-#include "objects/skybox.hpp"
+#include "core/upload_worker.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <optional>
 
 using namespace engine;
@@ -91,30 +98,33 @@ std::optional<IArchive> resolveAlembicPath(const std::string &path) {
 }
 
 std::optional<BakedPointDataComponent>
-BakedPointDataComponent::create(const std::string &path) {
+BakedPointDataComponent::create(const std::string &path, PointOrder order) {
 	auto archiveOpt = resolveAlembicPath(path);
 	if (!archiveOpt.has_value())
 		return std::nullopt;
 
 	size_t nPoints, nFrames;
-	auto frameData = createFrameData(*archiveOpt, nPoints, nFrames);
+	auto frameData = createFrameData(*archiveOpt, nPoints, nFrames, order);
 
-	return BakedPointDataComponent(frameData, nPoints, nFrames);
+	return BakedPointDataComponent(std::move(frameData), nPoints, nFrames,
+								   order);
 }
 
 std::optional<std::vector<Vec3f>>
 BakedPointDataComponent::createFrameDataFromPath(const std::string &path,
 												 size_t &numPoints,
-												 size_t &numFrames) {
+												 size_t &numFrames,
+												 PointOrder order) {
 	auto archiveOpt = resolveAlembicPath(path);
 	if (!archiveOpt.has_value())
 		return std::nullopt;
-	return createFrameData(*archiveOpt, numPoints, numFrames);
+	return createFrameData(*archiveOpt, numPoints, numFrames, order);
 }
 
 std::vector<Vec3f>
 BakedPointDataComponent::createFrameData(const IArchive &archive,
-										 size_t &numPoints, size_t &numFrames) {
+										 size_t &numPoints, size_t &numFrames,
+										 PointOrder order) {
 	std::vector<std::vector<Vec3f>> allFrames;
 	findAndExtractPointsRecursive(archive.getTop(), allFrames);
 
@@ -133,150 +143,194 @@ BakedPointDataComponent::createFrameData(const IArchive &archive,
 	numPoints = maxPoints;
 	numFrames = allFrames.size();
 
+	using Clock = std::chrono::steady_clock;
+	Clock::duration orderTime{};
 	for (auto &frame : allFrames) {
+		Vec3f frameMin(std::numeric_limits<float>::max());
+		Vec3f frameMax(std::numeric_limits<float>::lowest());
+		for (const Vec3f &p : frame) {
+			for (int i = 0; i < 3; ++i) {
+				frameMin[i] = std::min(frameMin[i], p[i]);
+				frameMax[i] = std::max(frameMax[i], p[i]);
+			}
+		}
+
 		frame.resize(maxPoints, Vec3f(0.0f, 1000.0f, 0.0f)); // pad
+		// source ids are dropped, frames are drawn as they are and never
+		// matched point-to-point
+		Clock::time_point orderStart = Clock::now();
+		if (frameMin.x <= frameMax.x)
+			orderPoints(frame, frameMin, frameMax, order);
+		orderTime += Clock::now() - orderStart;
 		allFrameData.insert(allFrameData.end(), frame.begin(), frame.end());
 	}
 
+	std::cout << "point order: " << pointOrderName(order) << " in "
+			  << std::chrono::duration<double, std::milli>(orderTime).count()
+			  << " ms" << std::endl;
 	std::cout << "made frame data!" << std::endl;
 
 	return allFrameData;
 }
 
 BakedPointDataComponent::BakedPointDataComponent(
-	const std::vector<Vec3f> &allFrameData, const size_t &nPoints,
-	const size_t &nFrames)
-	: numPoints(nPoints), numFrames(nFrames) {
-	// frame data
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-
-	glBufferData(GL_ARRAY_BUFFER, allFrameData.size() * sizeof(Vec3f),
-				 allFrameData.data(), GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), (void *)0);
-	glEnableVertexAttribArray(0);
-
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	// depth mapping
-	// a
-	glGenFramebuffers(1, &depthFBOA);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthFBOA);
-
-	glGenTextures(1, &depthTextureA);
-	glBindTexture(GL_TEXTURE_2D, depthTextureA);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, frameWidth,
-				 frameHeight, // width and height hard-coded for now
-				 0, GL_RED, GL_FLOAT, nullptr);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   depthTextureA, 0);
-	GLuint depthRenderbuffer;
-	glGenRenderbuffers(1, &depthRenderbuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, frameWidth,
-						  frameHeight);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-							  GL_RENDERBUFFER, depthRenderbuffer);
-
-	GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-	glDrawBuffers(1, drawBuffers);
-
-	// b
-	glGenFramebuffers(1, &depthFBOB);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthFBOB);
-
-	glGenTextures(1, &depthTextureB);
-	glBindTexture(GL_TEXTURE_2D, depthTextureB);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, frameWidth,
-				 frameHeight, // width and height hard-coded for now
-				 0, GL_RED, GL_FLOAT, nullptr);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   depthTextureB, 0);
-	GLuint depthRenderbuffer2;
-	glGenRenderbuffers(1, &depthRenderbuffer2);
-	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer2);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, frameWidth,
-						  frameHeight);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-							  GL_RENDERBUFFER, depthRenderbuffer2);
-
-	glDrawBuffers(1, drawBuffers);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// filtering
-	glGenFramebuffers(1, &filterFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, filterFBO);
-
-	glGenTextures(1, &filteredDepthTexture);
-	glBindTexture(GL_TEXTURE_2D, filteredDepthTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, frameWidth,
-				 frameHeight, // more hard-coded
-				 0, GL_RED, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   filteredDepthTexture, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// normal frame buffer
-	glGenFramebuffers(1, &normalFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, normalFBO);
-
-	glGenTextures(1, &normalTexture);
-	glBindTexture(GL_TEXTURE_2D, normalTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, frameWidth, frameHeight, 0,
-				 GL_RGB, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	// idk if this does what i want
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	//
-
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   normalTexture, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// thickness
-
-	glGenTextures(1, &thicknessTexture);
-	glBindTexture(GL_TEXTURE_2D, thicknessTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, frameWidth, frameHeight, 0, GL_RED,
-				 GL_FLOAT, // hard-coded
-				 nullptr);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	glGenFramebuffers(1, &thicknessFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, thicknessFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-						   thicknessTexture, 0);
-}
-
-void BakedPointDataComponent::Bind() { glBindVertexArray(vao); }
+	std::vector<Vec3f> allFrameData, const size_t &nPoints,
+	const size_t &nFrames, PointOrder order)
+	: currentFrame(0), numPoints(nPoints), numFrames(nFrames),
+	  lodOrdered(order == PointOrder::MortonLod), order(order) {
+	// bounds, ignoring the padding points
+	const Vec3f pad(0.0f, 1000.0f, 0.0f);
+	boundMin = Vec3f(std::numeric_limits<float>::max());
+	boundMax = Vec3f(std::numeric_limits<float>::lowest());
+	for (const Vec3f &p : allFrameData) {
+		if (p == pad)
+			continue;
+		for (int i = 0; i < 3; ++i) {
+			boundMin[i] = std::min(boundMin[i], p[i]);
+			boundMax[i] = std::max(boundMax[i], p[i]);
+		}
+	}
+	if (boundMin.x > boundMax.x)
+		boundMin = boundMax = Vec3f(0.0f);
+
+	// mean spacing if the points filled their bounds
+	Vec3f extent = boundMax - boundMin;
+	spacing = std::cbrt(extent.x * extent.y * extent.z /
+						(float)std::max<size_t>(numPoints, 1));
+
+	// culling chunks, runs of the Morton curve are spatially compact. a
+	// chunk of only padding gets inverted bounds and is never drawn
+	if (order != PointOrder::Original && numPoints > 0) {
+		numChunks = (numPoints + pointChunkSize - 1) / pointChunkSize;
+		chunkMin.assign(numFrames * numChunks,
+						Vec3f(std::numeric_limits<float>::max()));
+		chunkMax.assign(numFrames * numChunks,
+						Vec3f(std::numeric_limits<float>::lowest()));
+		for (size_t frame = 0; frame < numFrames; ++frame) {
+			const Vec3f *points = allFrameData.data() + frame * numPoints;
+			for (size_t rank = 0; rank < numPoints; ++rank) {
+				const Vec3f &p = points[rankSlot(numPoints, order, rank)];
+				if (p == pad)
+					continue;
+				size_t chunk = frame * numChunks + rank / pointChunkSize;
+				for (int i = 0; i < 3; ++i) {
+					chunkMin[chunk][i] = std::min(chunkMin[chunk][i], p[i]);
+					chunkMax[chunk][i] = std::max(chunkMax[chunk][i], p[i]);
+				}
+			}
+		}
+	}
+
+	// uploaded on demand, see Prefetch
+	frameData = std::move(allFrameData);
+}
+
+void BakedPointDataComponent::Bind() {
+	MakeResident();
+	glBindVertexArray(vao.Get());
+}
+
+BakedPointDataComponent::~BakedPointDataComponent() { Evict(); }
+
+void BakedPointDataComponent::BeginUpload() {
+	const size_t totalBytes = frameData.size() * sizeof(Vec3f);
+	buffer = GLBuffer::Create(GpuCategory::Points, "baked points");
+	uploadedBytes = 0;
+
+	UploadWorker *worker = UploadWorker::Get();
+	if (worker == nullptr) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+		GpuMemory::BufferData(GL_ARRAY_BUFFER, buffer.Get(), totalBytes,
+							  nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	// the whole cache is queued at once, in batches so other jobs can
+	// get in between. frameData outlives the jobs, Evict waits for them
+	const GLuint id = buffer.Get();
+	const char *data = (const char *)frameData.data();
+	uploads.push_back(worker->Submit([=]() {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+		GpuMemory::BufferData(GL_COPY_WRITE_BUFFER, id, totalBytes, nullptr,
+							  GL_STATIC_DRAW);
+	}));
+	for (size_t offset = 0; offset < totalBytes; offset += uploadBatchBytes) {
+		const size_t bytes = std::min(uploadBatchBytes, totalBytes - offset);
+		uploads.push_back(worker->Submit([=]() {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes,
+							data + offset);
+		}));
+	}
+}
+
+bool BakedPointDataComponent::Prefetch(size_t &budget) {
+	const size_t totalBytes = frameData.size() * sizeof(Vec3f);
+	if (!buffer)
+		BeginUpload();
+
+	if (!uploads.empty()) {
+		// queued on the worker, which paces itself
+		uploads.erase(std::remove_if(uploads.begin(), uploads.end(),
+									 [](const UploadTicket &ticket) {
+										 return ticket.IsReady();
+									 }),
+					  uploads.end());
+		if (uploads.empty())
+			uploadedBytes = totalBytes;
+	} else if (uploadedBytes < totalBytes) {
+		const size_t bytes = std::min(totalBytes - uploadedBytes, budget);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+		glBufferSubData(GL_ARRAY_BUFFER, uploadedBytes, bytes,
+						(const char *)frameData.data() + uploadedBytes);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		uploadedBytes += bytes;
+		budget -= bytes;
+	}
+
+	// VAOs aren't shared between contexts, so this waits for the data
+	if (uploadedBytes == totalBytes && !vao) {
+		vao = GLVertexArray::Create();
+		glBindVertexArray(vao.Get());
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f),
+							  (void *)0);
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	return IsResident();
+}
+
+void BakedPointDataComponent::MakeResident() {
+	if (IsResident())
+		return;
+	if (!buffer)
+		BeginUpload();
+	for (const UploadTicket &ticket : uploads)
+		ticket.Wait();
+	size_t budget = std::numeric_limits<size_t>::max();
+	Prefetch(budget);
+}
+
+void BakedPointDataComponent::Evict() {
+	// queued jobs still write into the buffer
+	for (const UploadTicket &ticket : uploads)
+		ticket.Wait();
+	uploads.clear();
+	vao.Reset();
+	buffer.Reset();
+	uploadedBytes = 0;
+}
+
+bool BakedPointDataComponent::IsResident() const {
+	return vao && uploadedBytes == frameData.size() * sizeof(Vec3f);
+}
 
 void BakedPointDataComponent::Update(double dt) {
 	timer += dt;
-	if (timer >= (1. / 60.)) {
+	if (timer >= frameInterval) {
 		currentFrame++;
 		if (currentFrame >= numFrames) {
 			currentFrame = 0;
@@ -286,176 +340,70 @@ void BakedPointDataComponent::Update(double dt) {
 	}
 }
 
-void BakedPointDataComponent::Draw(Renderer &renderer, Scene *scene,
-								   Matrix4f model) {
-	SceneObject *owner = GetOwner();
-	if (owner != nullptr) {
-		GLuint old = CurrentDrawFBO();
-
-		constexpr int pointSize = 10;
-
-		// thickness
-		renderer.BindProgram("thicknessMap");
-		glBindFramebuffer(GL_FRAMEBUFFER, thicknessFBO);
-		glViewport(0, 0, frameWidth, frameHeight); // hard-coded
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_ONE, GL_ONE);
-		Bind();
-		renderer.SetModel(model);
-		renderer.SetView(scene->GetActiveCamera()->GetView());
-		renderer.SetProjection(scene->GetActiveCamera()->GetProjection());
-		renderer.SetUniform("pointSize", pointSize * 2);
-		glDrawArrays(GL_POINTS, currentFrame * numPoints, numPoints);
-		glDisable(GL_BLEND);
-
-		// PARTICLE DEPTH MAP
-		glEnable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE);
-		glDepthFunc(GL_LESS); // or GL_LEQUAL
-		glDisable(GL_CULL_FACE);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, depthFBOA);
-		glViewport(0, 0, frameWidth, frameHeight); // hard-coded
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		renderer.BindProgram("waterDepth");
-		renderer.SetModel(model);
-		renderer.SetView(scene->GetActiveCamera()->GetView());
-		renderer.SetProjection(scene->GetActiveCamera()->GetProjection());
-		renderer.SetUniform("pointSize", pointSize);
-		Bind(); // binds vao
-		glDrawArrays(GL_POINTS, currentFrame * numPoints, numPoints);
-
-		// NARROW FILTER
-
-		int numPasses = 3;
-		bool ping = true;
-		GLuint inputTex = depthTextureA;
-		GLuint outputTex = depthTextureB;
-
-		float aspect = (float)frameWidth / (float)frameHeight;
-		float fov_v_rad =
-			2.0f *
-			std::atan(
-				std::tan(deg2rad(scene->GetActiveCamera()->GetFov()) / 2.0f) /
-				aspect);
-		float r = pointSize;
-
-		for (int i = 0; i < numPasses; ++i) {
-			glBindFramebuffer(GL_FRAMEBUFFER, filterFBO);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-								   GL_TEXTURE_2D, outputTex, 0);
-			glViewport(0, 0, frameWidth, frameHeight);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-			renderer.BindProgram("narrowFilter");
-			renderer.BindTexture("uDepthTex", inputTex, GL_TEXTURE0);
-
-			renderer.SetUniform("uDelta", 10 * r);
-			renderer.SetUniform("uMu", r);
-			renderer.SetUniform("uWorldSigma", 0.7f * r);
-
-			renderer.SetUniform("uFOV", fov_v_rad);
-			renderer.SetUniform("uScreenHeight", (float)frameHeight);
-
-			renderer.DrawFullscreenQuad();
-
-			std::swap(inputTex, outputTex);
-		}
+void BakedPointDataComponent::DrawPoints(int lod,
+										 const ChunkFilter &visible) {
+	Bind();
+	// frames are stored in prefix LOD order, so a coarser level is a
+	// shorter draw
+	lod = std::clamp(lod, 0, pointLodLevels - 1);
+	if (!visible || numChunks == 0) {
+		glDrawArrays(GL_POINTS, currentFrame * numPoints,
+					 lodPointCount(numPoints, lod));
+		return;
+	}
 
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, ping ? depthFBOB : depthFBOA);
-		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-							   GL_TEXTURE_2D, filteredDepthTexture, 0);
-		glBlitFramebuffer(0, 0, frameWidth, frameHeight, 0, 0, frameWidth,
-						  frameHeight,
-						  GL_COLOR_BUFFER_BIT, // hard-coded
-						  GL_NEAREST);
-
-		// NORMAL RECONSTRUCTION
-		glBindFramebuffer(GL_FRAMEBUFFER, normalFBO);
-		glViewport(0, 0, frameWidth, frameHeight); // hard-coded
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		renderer.BindProgram("normalReconstruction");
-		renderer.BindTexture("uFilteredDepth", filteredDepthTexture,
-							 GL_TEXTURE0);
-		renderer.SetUniform("uFOV", fov_v_rad);
-		renderer.SetUniform("uScreenHeight", (float)frameHeight); // hard-coded
-
-		renderer.DrawFullscreenQuad();
-
-		// RENDERING
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		renderer.BindProgram("fluidProgram");
-
-		renderer.SetModel(model);
-		renderer.SetView(scene->GetActiveCamera()->GetView());
-		renderer.SetProjection(scene->GetActiveCamera()->GetProjection());
-		renderer.SetUniform("viewPos", scene->GetActiveCamera()->GetPosition());
-		renderer.SetUniform("lightPos", scene->GetSunPosition());
-
-		renderer.SetUniform("materialType", 1);
-		renderer.SetUniform("shading", 1);
-
-		renderer.SetUniform("shininess", 64.0f);
-		renderer.SetUniform("ambientColor", Vec3f(0.1f, 0.2f, 0.25f));
-		renderer.SetUniform("diffuseColor", Vec3f(0.25f, 0.55f, 0.75f));
-		renderer.SetUniform("specularColor", Vec3f(1.0f, 1.0f, 1.0f));
-
-		renderer.BindTexture("uNormalTex", normalTexture, GL_TEXTURE0);
-		renderer.BindTexture("uDepthTex", filteredDepthTexture, GL_TEXTURE1);
-		renderer.BindTexture("uThicknessTex", thicknessTexture, GL_TEXTURE2);
-		glActiveTexture(GL_TEXTURE3);
-		scene->GetActiveSkybox()->GetTexture().Bind();
-		renderer.SetUniform("uSkyboxTex", 3);
-		renderer.BindTexture("uOpaqueDepthTex",
-							 renderer.FindBuffer("opaque")->depthTex,
-							 GL_TEXTURE4);
-		renderer.BindTexture("uBackgroundColorTex",
-							 renderer.FindBuffer("opaque")->texture,
-							 GL_TEXTURE5);
-
-		renderer.SetUniform("uFovY", fov_v_rad);
-		renderer.SetUniform("uAspect", aspect);
-		// renderer.SetUniform("uTime", (float)glfwGetTime());
-		renderer.SetUniform("uTime", fmod((float)glfwGetTime(), 60.0f));
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		renderer.BindBuffer(old);
-		renderer.DrawFullscreenQuad();
-
-		// DEBUG
-		// glEnable(GL_BLEND);
-		// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		// renderer.BindBuffer(old);
-		// glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		// renderer.BindProgram("debugDisplay");
-		// renderer.BindTexture("uTexture", depthTextureA);
-		// renderer.BindTexture("uTexture", normalTexture);
-		// renderer.BindTexture("uTexture",
-		// renderer.FindBuffer("opaque")->texture);
-		// renderer.DrawFullscreenQuad();
-
-		// revert if we changed & then render normally
-		// glDisable(GL_BLEND);
-		// glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		// glViewport(0, 0, 640, 480); // HARD-CODED, BAD
-
-		// renderer.BindProgram("default");
-		// renderer.SetUniform("materialType", 0);
-
-		// glClear(GL_DEPTH_BUFFER_BIT);
-		// Bind();
-		// glDrawArrays(GL_POINTS, currentFrame * numPoints, numPoints);
-	} else {
-		// render normally
-		glDrawArrays(GL_POINTS, currentFrame * numPoints, numPoints);
+	// runs of visible chunks as curve rank ranges
+	std::vector<std::pair<size_t, size_t>> runs;
+	for (size_t c = 0; c < numChunks; ++c) {
+		const size_t chunk = currentFrame * numChunks + c;
+		if (chunkMin[chunk].x > chunkMax[chunk].x ||
+			!visible(chunkMin[chunk], chunkMax[chunk]))
+			continue;
+		const size_t begin = c * pointChunkSize;
+		const size_t end = std::min(begin + pointChunkSize, numPoints);
+		if (!runs.empty() && runs.back().second == begin)
+			runs.back().second = end;
+		else
+			runs.emplace_back(begin, end);
 	}
+
+	// a run is one range per stored level the LOD reaches
+	drawFirsts.clear();
+	drawCounts.clear();
+	const GLint frameStart = (GLint)(currentFrame * numPoints);
+	const int levels = lodOrdered ? pointLodLevels - lod : 1;
+	for (int level = 0; level < levels; ++level) {
+		for (const auto &run : runs) {
+			size_t first = run.first, last = run.second;
+			if (lodOrdered)
+				lodLevelSlots(numPoints, level, run.first, run.second, first,
+							  last);
+			if (last > first) {
+				drawFirsts.push_back(frameStart + (GLint)first);
+				drawCounts.push_back((GLsizei)(last - first));
+			}
+		}
+	}
+	if (!drawFirsts.empty())
+		glMultiDrawArrays(GL_POINTS, drawFirsts.data(), drawCounts.data(),
+						  (GLsizei)drawFirsts.size());
+}
+
+void BakedPointDataComponent::GetBounds(Vec3f &outMin, Vec3f &outMax) {
+	outMin = boundMin;
+	outMax = boundMax;
+}
+
+size_t BakedPointDataComponent::GetVersion() const { return currentFrame; }
+float BakedPointDataComponent::GetSpacing() const {
+	// without LOD order the pipeline has to draw every point
+	return lodOrdered ? spacing : 0.0f;
+}
+
+void BakedPointDataComponent::AddPasses(RenderGraph &graph,
+										Renderer &renderer, Scene *scene,
+										Matrix4f model) {
+	pipeline.AddPasses(graph, renderer, scene, {{this, model}});
 }
 
 bool BakedPointDataComponent::IsFinished() { return loopCount > 0; }
@@ -465,9 +413,210 @@ void BakedPointDataComponent::Reset() {
 	currentFrame = 0;
 }
 
-void FluidSimulationComponent::Bind() {}
-void FluidSimulationComponent::Update(double) {}
-void FluidSimulationComponent::Draw(Renderer &renderer, Scene *scene,
-									Matrix4f model) {}
-bool FluidSimulationComponent::IsFinished() { return true; }
-void FluidSimulationComponent::Reset() {}
+FluidSimulationComponent::FluidSimulationComponent(
+	std::unique_ptr<FluidSolver> solver, const Vec3f &blockMin,
+	const Vec3f &blockMax)
+	: blockMin(blockMin), blockMax(blockMax) {
+	solver->AddBlock(blockMin, blockMax);
+	solver->GetDomain(domainMin, domainMax);
+	spacing = solver->GetSpacing();
+	sim = std::make_unique<SimulationThread>(std::move(solver));
+	// nothing has been uploaded yet
+	version = 1;
+	Interpolate();
+	std::cout << sim->GetName() << ": " << numPoints
+			  << " particles, " << simdLevelName(sphKernels().level)
+			  << " kernels" << std::endl;
+}
+
+bool FluidSimulationComponent::AddCollider(
+	const std::vector<Vec3f> &positions,
+	const std::vector<unsigned int> &indices) {
+	// a band of a few particles covers any push a step can need
+	std::shared_ptr<const SdfCollider> collider = SdfCollider::Bake(
+		positions, indices, spacing, 3.0f * spacing, domainMin, domainMax);
+	if (!collider)
+		return false;
+	colliders.push_back(collider);
+	sim->Edit([&](FluidSolver &solver) { solver.SetColliders(colliders); });
+	return true;
+}
+
+bool FluidSimulationComponent::StartRecording(const std::string &path) {
+	std::unique_ptr<BakeWriter> writer =
+		BakeWriter::Open(path, BakedPointDataComponent::frameInterval);
+	if (!writer)
+		return false;
+	sim->Record(std::move(writer));
+	return true;
+}
+
+void FluidSimulationComponent::StopRecording() { sim->Record(nullptr); }
+
+void FluidSimulationComponent::SetAdaptiveStepping(bool enabled,
+												   int maxSubsteps) {
+	sim->SetAdaptive(enabled, maxSubsteps);
+}
+
+void FluidSimulationComponent::Interpolate() {
+	const SimFrame &frame = sim->Latest();
+	// the thread stops short of its target, so once it caught up with
+	// shownTime the newest state is less than a step before it. drawing a
+	// step behind shownTime lands between the last two states; a sim
+	// further behind has its newest state drawn as is
+	const float blend = (float)std::clamp(
+		(shownTime - frame.time) / frame.step, 0.0, 1.0);
+	shown = &frame;
+	numPoints = frame.current.size();
+	if (frame.sequence == shownSequence && blend == shownBlend)
+		return;
+	shownSequence = frame.sequence;
+	shownBlend = blend;
+	version++;
+}
+
+void FluidSimulationComponent::Upload() {
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+
+	Vec3f *out = static_cast<Vec3f *>(points.BeginWrite(numPoints));
+	const Vec3f *previous = shown->previous.data();
+	const Vec3f *current = shown->current.data();
+	const float blend = shownBlend;
+	if (blend == 0.0f || blend == 1.0f) {
+		std::copy_n(blend == 0.0f ? previous : current, numPoints, out);
+	} else {
+		// mapped memory is write-combined, written once front to back
+		parallelFor(
+			numPoints,
+			[&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i)
+					out[i] = previous[i] + (current[i] - previous[i]) * blend;
+			},
+			65536);
+	}
+	points.EndWrite();
+
+	// storage is immutable with buffer_storage, growing makes a new buffer
+	if (points.Get() != vaoBuffer) {
+		glBindVertexArray(vao.Get());
+		glBindBuffer(GL_ARRAY_BUFFER, points.Get());
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f),
+							  (void *)0);
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		vaoBuffer = points.Get();
+	}
+	uploadedVersion = version;
+
+	uploadSeconds +=
+		std::chrono::duration<double>(Clock::now() - start).count();
+	reportUploads++;
+}
+
+void FluidSimulationComponent::Bind() {
+	MakeResident();
+	if (uploadedVersion != version)
+		Upload();
+	glBindVertexArray(vao.Get());
+}
+
+void FluidSimulationComponent::DrawPoints(int, const ChunkFilter &) {
+	// particles are in the order they were added, there are no LOD
+	// prefixes or culling chunks to pick from
+	Bind();
+	glDrawArrays(GL_POINTS, points.First(), (GLsizei)numPoints);
+}
+
+void FluidSimulationComponent::GetBounds(Vec3f &boundMin, Vec3f &boundMax) {
+	boundMin = domainMin;
+	boundMax = domainMax;
+}
+
+size_t FluidSimulationComponent::GetVersion() const { return version; }
+float FluidSimulationComponent::GetSpacing() const { return 0; }
+
+void FluidSimulationComponent::MakeResident() {
+	if (IsResident())
+		return;
+	// positions change every frame, so there's nothing worth queueing on
+	// the upload worker
+	vao = GLVertexArray::Create();
+	vaoBuffer = 0;
+	Upload();
+}
+
+bool FluidSimulationComponent::Prefetch(size_t &budget) {
+	if (!IsResident()) {
+		MakeResident();
+		budget -= std::min(budget, points.GetBytes());
+	}
+	return true;
+}
+
+void FluidSimulationComponent::Evict() {
+	vao.Reset();
+	points.Reset();
+	vaoBuffer = 0;
+}
+
+bool FluidSimulationComponent::IsResident() const { return (bool)vao; }
+
+void FluidSimulationComponent::Update(double dt) {
+	// the thread steps on its own, this only moves its target along
+	shownTime = time;
+	time += dt;
+	sim->Advance(dt);
+	Interpolate();
+
+	reportTimer += dt;
+	reportFrames++;
+	if (reportTimer >= reportInterval) {
+		const SimStats stats = sim->TakeStats();
+		std::cout << sim->GetName() << ": " << numPoints << " particles, "
+				  << stats.steps / std::max(stats.seconds, 1e-9)
+				  << " steps/s ("
+				  << stats.seconds * 1000.0 / std::max<size_t>(stats.steps, 1)
+				  << " ms per step), "
+				  << (double)stats.steps / reportFrames << " steps and "
+				  << stats.seconds * 1000.0 / reportFrames
+				  << " ms per frame, dt " << stats.minStep * 1000.0 << "-"
+				  << stats.maxStep * 1000.0 << " ms, "
+				  << stats.simulated / reportTimer
+				  << "x real time, upload "
+				  << uploadSeconds * 1000.0 /
+						 std::max<size_t>(reportUploads, 1)
+				  << " ms (" << (points.IsPersistent() ? "persistent" : "mapped")
+				  << ", " << points.GetStalls() << " stalls)" << std::endl;
+		if (const BakeWriter *recorder = sim->GetRecorder()) {
+			// cumulative, set against every step since recording started
+			std::cout << "  recording: " << recorder->GetWritten()
+					  << " frames, " << recorder->GetStalls() << " stalls, "
+					  << recorder->GetWriteSeconds() * 1000.0
+					  << " ms spent by the sim, "
+					  << recorder->GetEncodeSeconds() * 1000.0
+					  << " ms encoding" << std::endl;
+		}
+		reportTimer = uploadSeconds = 0;
+		reportUploads = reportFrames = 0;
+	}
+}
+
+void FluidSimulationComponent::AddPasses(RenderGraph &graph,
+										 Renderer &renderer, Scene *scene,
+										 Matrix4f model) {
+	pipeline.AddPasses(graph, renderer, scene, {{this, model}});
+}
+
+// runs until the scene is switched by hand
+bool FluidSimulationComponent::IsFinished() { return false; }
+
+void FluidSimulationComponent::Reset() {
+	sim->Restart([&](FluidSolver &solver) {
+		solver.Clear();
+		solver.AddBlock(blockMin, blockMax);
+	});
+	time = shownTime = 0;
+	Interpolate();
+}
@@ -1,73 +1,222 @@
 #include "components/mesh_renderer.hpp"
 #include "common/meshUtil.h"
 #include "common/typedefs.hpp"
+#include "core/gpu_memory.hpp"
 #include "core/renderer.hpp"
 #include "core/scene_object.hpp"
+#include "core/upload_worker.hpp"
 
-void createVertexArrayAndBuffer(GLuint &VAO, GLuint &VBO, GLuint &EBO) {
-	glGenVertexArrays(1, &VAO);
+MeshGeometry::MeshGeometry(const std::vector<Vertex> &vertices,
+						   const std::vector<unsigned int> &indices)
+	: VAO(GLVertexArray::Create()),
+	  VBO(GLBuffer::Create(GpuCategory::Geometry, "mesh vertices")),
+	  EBO(GLBuffer::Create(GpuCategory::Geometry, "mesh indices")),
+	  vertices(vertices), indices(indices) {
+	UploadWorker *worker = UploadWorker::Get();
+	if (worker == nullptr)
+		return;
+
+	// the job reads the vectors in place, the destructor waits for it
+	const GLuint vbo = VBO.Get(), ebo = EBO.Get();
+	upload = worker->Submit([this, vbo, ebo]() {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+		GpuMemory::BufferData(GL_COPY_WRITE_BUFFER, vbo,
+							  sizeof(Vertex) * this->vertices.size(),
+							  this->vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+		GpuMemory::BufferData(GL_COPY_WRITE_BUFFER, ebo,
+							  sizeof(unsigned int) * this->indices.size(),
+							  this->indices.data(), GL_STATIC_DRAW);
+	});
+	uploadQueued = true;
+}
+
+MeshGeometry::~MeshGeometry() { upload.Wait(); }
+
+bool MeshGeometry::SendData() {
+	if (hasSentData)
+		return true;
+	if (uploadQueued && !upload.IsReady())
+		return false;
+	hasSentData = true;
+
+	glBindVertexArray(VAO.Get());
+	glBindBuffer(GL_ARRAY_BUFFER, VBO.Get());
+	if (!uploadQueued)
+		GpuMemory::BufferData(GL_ARRAY_BUFFER, VBO.Get(),
+							  sizeof(Vertex) * vertices.size(),
+							  vertices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.Get());
+	if (!uploadQueued)
+		GpuMemory::BufferData(GL_ELEMENT_ARRAY_BUFFER, EBO.Get(),
+							  sizeof(unsigned int) * indices.size(),
+							  indices.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+						  (void *)offsetof(Vertex, position));
 
-	GLuint buffers[2];
-	glGenBuffers(2, buffers);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+						  (void *)offsetof(Vertex, normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+						  (void *)offsetof(Vertex, texCoord));
+	return true;
+}
+
+std::shared_ptr<MeshGeometry>
+MeshGeometry::Get(const std::vector<Vertex> &vertices,
+				  const std::vector<unsigned int> &indices) {
+	static std::unordered_map<size_t, std::vector<std::weak_ptr<MeshGeometry>>>
+		cache;
+
+	size_t hash = vertices.size() ^ (indices.size() << 16);
+	for (const Vertex &v : vertices)
+		hash = hash * 31 + std::hash<Vertex>()(v);
+	for (unsigned int i : indices)
+		hash = hash * 31 + i;
+
+	auto &bucket = cache[hash];
+	for (auto it = bucket.begin(); it != bucket.end();) {
+		std::shared_ptr<MeshGeometry> geometry = it->lock();
+		if (!geometry) {
+			it = bucket.erase(it);
+			continue;
+		}
+		if (geometry->vertices == vertices && geometry->indices == indices)
+			return geometry;
+		++it;
+	}
 
-	VBO = buffers[0];
-	EBO = buffers[1];
+	auto geometry = std::make_shared<MeshGeometry>(vertices, indices);
+	bucket.push_back(geometry);
+	return geometry;
+}
+
+void MaterialTextures::Bind(Renderer &renderer,
+							const MaterialTextures *textures) {
+	renderer.SetUniform("hasDiff", false);
+	renderer.SetUniform("uDispTex", false);
+	renderer.SetUniform("uNormalTex", false);
+	renderer.SetUniform("uRoughTex", false);
+
+	if (textures == nullptr)
+		return;
+
+	if (textures->hasDiffuse) {
+		textures->diffuseTex.Bind(0);
+		renderer.SetUniform("uDiffTex", 0);
+		renderer.SetUniform("hasDiff", true);
+	}
+	// if (textures->hasDisp) {
+	// 	textures->dispTex.Bind(1);
+	// 	renderer.SetUniform("uDispTex", 1);
+	// }
+	if (textures->hasNormal) {
+		textures->normalTex.Bind(2);
+		renderer.SetUniform("uNormalTex", 2);
+	}
+	if (textures->hasRough) {
+		textures->roughTex.Bind(3);
+		renderer.SetUniform("uRoughTex", 3);
+	}
+}
+
+// mipmapped RGBA8, sized from level 0
+static void TrackTexture(cyGLTexture2D &texture, const std::string &owner) {
+	GLint width = 0, height = 0;
+	texture.Bind();
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	GpuMemory::Track(GpuObject::Texture, texture.GetID(), GpuCategory::Texture,
+					 owner, (size_t)width * height * 4 * 4 / 3);
+}
+
+MaterialTextures::~MaterialTextures() {
+	for (const cyGLTexture2D *texture :
+		 {&diffuseTex, &normalTex, &roughTex, &dispTex}) {
+		if (!texture->IsNull())
+			GpuMemory::Untrack(GpuObject::Texture, texture->GetID());
+	}
+}
+
+std::shared_ptr<MaterialTextures>
+MaterialTextures::Get(const std::string &path) {
+	static std::unordered_map<std::string, std::weak_ptr<MaterialTextures>>
+		cache;
+
+	auto it = cache.find(path);
+	if (it != cache.end()) {
+		if (auto textures = it->second.lock())
+			return textures;
+	}
+
+	auto textures = std::make_shared<MaterialTextures>();
+	if (loadTexture(textures->diffuseTex, path + "/diff.png")) {
+		textures->diffuseTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
+		textures->diffuseTex.SetFilteringMode(GL_LINEAR,
+											  GL_LINEAR_MIPMAP_LINEAR);
+		textures->hasDiffuse = true;
+		TrackTexture(textures->diffuseTex, path);
+	}
+	// if (loadTexture(textures->dispTex, path + "/disp.png"))
+	// 	textures->hasDisp = true;
+	if (loadTexture(textures->normalTex, path + "/norm.png")) {
+		textures->normalTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
+		textures->normalTex.SetFilteringMode(GL_LINEAR,
+											 GL_LINEAR_MIPMAP_LINEAR);
+		textures->hasNormal = true;
+		TrackTexture(textures->normalTex, path);
+	}
+	if (loadTexture(textures->roughTex, path + "/rough.png")) {
+		textures->roughTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
+		textures->roughTex.SetFilteringMode(GL_LINEAR,
+											GL_LINEAR_MIPMAP_LINEAR);
+		textures->hasRough = true;
+		TrackTexture(textures->roughTex, path);
+	}
+
+	cache[path] = textures;
+	return textures;
 }
 
 MeshRendererComponent::MeshRendererComponent() : meshSize({1, 1, 1}) {
-	createVertexArrayAndBuffer(VAO, VBO, EBO);
+	geometry = MeshGeometry::Get({}, {});
 	UpdateModelMatrix();
 }
 
 MeshRendererComponent::MeshRendererComponent(cy::TriMesh &mesh)
 	: meshSize({1, 1, 1}) {
-	createVertexArrayAndBuffer(VAO, VBO, EBO);
-
 	mesh.ComputeBoundingBox();
 	Vec3f boundMin = mesh.GetBoundMin();
 	Vec3f boundMax = mesh.GetBoundMax();
 
 	center = (boundMin + boundMax) * 0.5f;
 
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
 	preprocessOBJ(mesh, vertices, indices);
+	geometry = MeshGeometry::Get(vertices, indices);
 	UpdateModelMatrix();
 }
 
 MeshRendererComponent::MeshRendererComponent(
 	const std::vector<Vertex> &vertices,
 	const std::vector<unsigned int> &indices)
-	: vertices(vertices), indices(indices), meshSize({1, 1, 1}) {
-	createVertexArrayAndBuffer(VAO, VBO, EBO);
+	: meshSize({1, 1, 1}) {
+	geometry = MeshGeometry::Get(vertices, indices);
 	UpdateModelMatrix();
 }
 
-void MeshRendererComponent::Bind(Renderer &renderer) { glBindVertexArray(VAO); }
+void MeshRendererComponent::Bind(Renderer &renderer) {
+	glBindVertexArray(geometry->VAO.Get());
+}
 
 void MeshRendererComponent::SendData(Renderer &renderer) {
-	if (hasSentData)
-		return;
-	hasSentData = true;
-
-	this->Bind(renderer);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(),
-				 vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(),
-				 indices.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-						  (void *)offsetof(Vertex, position));
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-						  (void *)offsetof(Vertex, normal));
-
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-						  (void *)offsetof(Vertex, texCoord));
+	geometry->SendData();
 }
 
 void MeshRendererComponent::SetMeshSize(const Vec3f &size) {
@@ -92,37 +241,26 @@ void MeshRendererComponent::UpdateModelMatrix() {
 	}
 }
 
+DrawItem MeshRendererComponent::MakeDrawItem() {
+	DrawItem item;
+	item.geometry = geometry.get();
+	item.textures = textures.get();
+	item.shading = ShadingType::BlinnPhong;
+	item.model = modelMatrix;
+	return item;
+}
+
 void MeshRendererComponent::Render(Renderer &renderer, Scene *scene) {
-	if (!hasSentData)
-		SendData(renderer);
+	// skipped until a queued upload lands
+	if (!geometry->SendData())
+		return;
 
 	Bind(renderer);
 	renderer.SetUniform("model", modelMatrix);
 	renderer.SetShadingType(ShadingType::BlinnPhong);
 	renderer.DrawMesh(); // set shading uniform
 
-	renderer.SetUniform("hasDiff", false);
-	renderer.SetUniform("uDispTex", false);
-	renderer.SetUniform("uNormalTex", false);
-	renderer.SetUniform("uRoughTex", false);
-
-	if (hasDiffuse) {
-		diffuseTex.Bind(0);
-		renderer.SetUniform("uDiffTex", 0);
-		renderer.SetUniform("hasDiff", true);
-	}
-	// if (hasDisp) {
-	// 	dispTex.Bind(1);
-	// 	renderer.SetUniform("uDispTex", 1);
-	// }
-	if (hasNormal) {
-		normalTex.Bind(2);
-		renderer.SetUniform("uNormalTex", 2);
-	}
-	if (hasRough) {
-		roughTex.Bind(3);
-		renderer.SetUniform("uRoughTex", 3);
-	}
+	MaterialTextures::Bind(renderer, textures.get());
 
 	glDrawElements(GL_TRIANGLES, NV(), GL_UNSIGNED_INT, 0);
 }
@@ -130,21 +268,5 @@ void MeshRendererComponent::Render(Renderer &renderer, Scene *scene) {
 void MeshRendererComponent::Update() { UpdateModelMatrix(); }
 
 void MeshRendererComponent::SetTextures(const std::string path) {
-	if (loadTexture(diffuseTex, path + "/diff.png")) {
-		diffuseTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
-		diffuseTex.SetFilteringMode(GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-		hasDiffuse = true;
-	}
-	// if (loadTexture(dispTex, path + "/disp.png"))
-	// 	hasDisp = true;
-	if (loadTexture(normalTex, path + "/norm.png")) {
-		normalTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
-		normalTex.SetFilteringMode(GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-		hasNormal = true;
-	}
-	if (loadTexture(roughTex, path + "/rough.png")) {
-		roughTex.SetWrappingMode(GL_REPEAT, GL_REPEAT);
-		roughTex.SetFilteringMode(GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR);
-		hasRough = true;
-	}
+	textures = MaterialTextures::Get(path);
 }
@@ -0,0 +1,175 @@
+#include "core/draw_list.hpp"
+#include "core/gpu_memory.hpp"
+#include "components/mesh_renderer.hpp"
+#include "core/renderer.hpp"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+using namespace engine;
+
+bool DrawItem::SameMaterial(const DrawItem &other) const {
+	return ambientColor == other.ambientColor &&
+		   diffuseColor == other.diffuseColor &&
+		   shininess == other.shininess && shading == other.shading;
+}
+
+bool DrawItem::Batches(const DrawItem &other) const {
+	return program == other.program && textures == other.textures &&
+		   geometry == other.geometry && SameMaterial(other);
+}
+
+void DrawList::Clear() {
+	items.clear();
+	textureIds.clear();
+	materials.clear();
+}
+
+uint64_t DrawList::MakeKey(size_t index, GLuint programId) {
+	// | program 12 | texture set 16 | material 12 | geometry 24 |
+	const DrawItem &item = items[index];
+	auto texIt = textureIds.find(item.textures);
+	if (texIt == textureIds.end())
+		texIt = textureIds.emplace(item.textures, textureIds.size()).first;
+
+	uint64_t material = 0;
+	while (material < materials.size() &&
+		   !items[materials[material]].SameMaterial(item))
+		material++;
+	if (material == materials.size())
+		materials.push_back(index);
+
+	return ((uint64_t)(programId & 0xfff) << 52) |
+		   ((texIt->second & 0xffff) << 36) | ((material & 0xfff) << 24) |
+		   (uint64_t)(item.geometry->VAO.Get() & 0xffffff);
+}
+
+void DrawList::Add(const DrawItem &item) { items.push_back(item); }
+
+uint64_t DrawList::Hash() const {
+	// FNV-1a over the fields the key is built from, and the transform
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](const void *data, size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < bytes; ++i) {
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	for (const DrawItem &item : items) {
+		const size_t program = std::hash<std::string>()(item.program);
+		add(&program, sizeof(program));
+		add(&item.textures, sizeof(item.textures));
+		add(&item.geometry, sizeof(item.geometry));
+		add(&item.ambientColor, sizeof(item.ambientColor));
+		add(&item.diffuseColor, sizeof(item.diffuseColor));
+		add(&item.shininess, sizeof(item.shininess));
+		add(&item.shading, sizeof(item.shading));
+		add(&item.model, sizeof(item.model));
+	}
+	return hash;
+}
+
+void DrawList::BindInstances(size_t first) {
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.Get());
+	for (GLuint column = 0; column < 4; ++column) {
+		GLuint location = 3 + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(
+			location, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f),
+			(void *)(first * sizeof(Matrix4f) + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(location, 1);
+	}
+}
+
+void DrawList::Submit(Renderer &renderer) {
+	stats = Stats{};
+	stats.items = items.size();
+	if (items.empty())
+		return;
+
+	// materials are looked up by item index, so every key is built before
+	// the sort moves anything
+	for (size_t i = 0; i < items.size(); ++i) {
+		GLuint programId = renderer.GetProgram(items[i].program)->GetID();
+		items[i].key = MakeKey(i, programId);
+	}
+	std::stable_sort(
+		items.begin(), items.end(),
+		[](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+
+	// model matrices in draw order, one upload per frame
+	instanceData.clear();
+	for (const DrawItem &item : items)
+		instanceData.push_back(item.model);
+
+	if (!instanceVBO)
+		instanceVBO = GLBuffer::Create(GpuCategory::Geometry, "draw list");
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.Get());
+	if (instanceData.size() > instanceCapacity) {
+		instanceCapacity = instanceData.size();
+		GpuMemory::BufferData(GL_ARRAY_BUFFER, instanceVBO.Get(),
+							  instanceCapacity * sizeof(Matrix4f), nullptr,
+							  GL_STREAM_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceData.size() * sizeof(Matrix4f),
+					instanceData.data());
+
+	const DrawItem *bound = nullptr;
+	for (size_t i = 0; i < items.size();) {
+		size_t end = i + 1;
+		while (end < items.size() && items[i].Batches(items[end]))
+			end++;
+
+		const DrawItem &item = items[i];
+		const bool programChanged =
+			bound == nullptr || bound->program != item.program;
+
+		if (programChanged) {
+			renderer.BindProgram(item.program);
+			renderer.SetDummyTextures();
+			renderer.SetUniform("uInstanced", true);
+			stats.programBinds++;
+		}
+		if (programChanged || bound->textures != item.textures) {
+			MaterialTextures::Bind(renderer, item.textures);
+			stats.textureBinds++;
+		}
+		if (programChanged || !bound->SameMaterial(item)) {
+			renderer.SetUniform("ambientColor", item.ambientColor);
+			renderer.SetUniform("diffuseColor", item.diffuseColor);
+			renderer.SetUniform("shininess", item.shininess);
+			renderer.SetShadingType(item.shading);
+			renderer.DrawMesh();
+			stats.materialChanges++;
+		}
+		if (bound == nullptr || bound->geometry != item.geometry) {
+			glBindVertexArray(item.geometry->VAO.Get());
+			stats.vaoBinds++;
+		}
+
+		BindInstances(i);
+		glDrawElementsInstanced(GL_TRIANGLES, item.geometry->NV(),
+								GL_UNSIGNED_INT, 0, (GLsizei)(end - i));
+		stats.draws++;
+
+		bound = &item;
+		i = end;
+	}
+
+	renderer.SetUniform("uInstanced", false);
+	glBindVertexArray(0);
+
+	if (!(stats == lastPrinted)) {
+		PrintStats();
+		lastPrinted = stats;
+	}
+}
+
+void DrawList::PrintStats() const {
+	std::cout << "draw list: " << stats.items << " meshes -> " << stats.draws
+			  << " draws (" << stats.programBinds << " program, "
+			  << stats.textureBinds << " texture, " << stats.materialChanges
+			  << " material, " << stats.vaoBinds << " vao changes)"
+			  << std::endl;
+}
@@ -0,0 +1,807 @@
+#include "core/fluid_pipeline.hpp"
+#include "common/point_order.hpp"
+#include "components/fluid_simulation.hpp"
+#include "core/scene.hpp"
+#include "objects/camera.hpp"
+#include "objects/skybox.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace engine;
+
+namespace {
+
+// splat diameter in pixels at full render scale
+constexpr int pointSize = 10;
+
+struct FluidView {
+	CameraObject *camera;
+	// fluid targets, already scaled by the quality level
+	int width, height;
+	int thicknessWidth, thicknessHeight;
+	float fovY, aspect;
+	FluidQuality quality;
+	// opaque depth the splats are tested against, or NullResource
+	RenderResource occluder;
+	// rejects point chunks behind the occluder, or null
+	const HiZCuller *culler;
+	// window pixels past its splats' edges a chunk still changes the
+	// surface by, through the depth copy and the narrow filter
+	float cullSpread;
+};
+
+struct FluidSurface {
+	RenderResource depth, normal, thickness;
+};
+
+} // namespace
+
+static void DrawSplats(Renderer &renderer,
+					   const std::vector<FluidSplat> &splats,
+					   const HiZCuller *culler, float cullSpread) {
+	for (const FluidSplat &splat : splats) {
+		renderer.SetModel(splat.model);
+		// each level doubles the points' volume
+		const float pointScale = std::exp2(splat.lod / 3.0f);
+		renderer.SetUniform("uPointScale", pointScale);
+		FluidData::ChunkFilter visible;
+		if (culler != nullptr) {
+			const Matrix4f model = splat.model;
+			// the thickness splats, twice the depth ones across, so every
+			// pass culls the same chunks
+			const float radius = pointSize * pointScale;
+			visible = [culler, model, radius,
+					   cullSpread](const Vec3f &min, const Vec3f &max) {
+				return !culler->IsHidden(min, max, model, radius, cullSpread);
+			};
+		}
+		splat.fluid->DrawPoints(splat.lod, visible);
+	}
+	renderer.SetUniform("uPointScale", 1.0f);
+}
+
+// fills the bound depth attachment from the occluder's depth
+static void CopyOccluderDepth(RenderGraph &graph, Renderer &renderer,
+							  RenderResource occluder) {
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	renderer.BindProgram("depthCopy");
+	renderer.BindTexture("uDepthTex", graph.GetTexture(occluder),
+						 GL_TEXTURE0);
+	renderer.DrawFullscreenQuad();
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+static TextureDesc MakeDesc(int width, int height, GLenum internalFormat) {
+	TextureDesc desc;
+	desc.width = width;
+	desc.height = height;
+	desc.internalFormat = internalFormat;
+	desc.type = GL_FLOAT;
+	switch (internalFormat) {
+	case GL_DEPTH_COMPONENT24:
+		desc.format = GL_DEPTH_COMPONENT;
+		break;
+	case GL_RGB16F:
+		desc.format = GL_RGB;
+		break;
+	case GL_RG8:
+	case GL_RG16:
+		desc.format = GL_RG;
+		break;
+	default:
+		desc.format = GL_RED;
+		break;
+	}
+	return desc;
+}
+
+// spacing of half floats around z
+static float HalfStep(float z) {
+	int exponent;
+	std::frexp(z, &exponent);
+	return std::ldexp(1.0f, exponent - 11);
+}
+
+// furthest eye depth of any splat source's bounds
+static float MaxEyeDepth(const std::vector<FluidSplat> &splats,
+						 const Matrix4f &view) {
+	float maxDepth = 0;
+	for (const FluidSplat &splat : splats) {
+		Vec3f boundMin, boundMax;
+		splat.fluid->GetBounds(boundMin, boundMax);
+
+		Matrix4f modelView = view * splat.model;
+		for (int c = 0; c < 8; ++c) {
+			Vec3f corner((c & 1) ? boundMax.x : boundMin.x,
+						 (c & 2) ? boundMax.y : boundMin.y,
+						 (c & 4) ? boundMax.z : boundMin.z);
+			cy::Vec4f p = modelView * cy::Vec4f(corner, 1.0f);
+			maxDepth = std::max(maxDepth, -p.z);
+		}
+	}
+	return maxDepth;
+}
+
+/**
+	Coarsest LOD level at which each source's points, projected at the
+	nearest corner of its bounds, stay at least lodSpacingPx apart
+*/
+static void ChooseLods(std::vector<FluidSplat> &splats, const FluidView &view,
+					   const FluidSettings &settings) {
+	const float focalPx = view.height / (2.0f * std::tan(view.fovY * 0.5f));
+	const Matrix4f viewMatrix = view.camera->GetView();
+
+	for (FluidSplat &splat : splats) {
+		splat.lod = 0;
+		float spacing = splat.fluid->GetSpacing();
+		if (!settings.particleLod || spacing <= 0)
+			continue;
+
+		Vec3f boundMin, boundMax;
+		splat.fluid->GetBounds(boundMin, boundMax);
+		Matrix4f modelView = viewMatrix * splat.model;
+		float nearest = std::numeric_limits<float>::max();
+		for (int c = 0; c < 8; ++c) {
+			Vec3f corner((c & 1) ? boundMax.x : boundMin.x,
+						 (c & 2) ? boundMax.y : boundMin.y,
+						 (c & 4) ? boundMax.z : boundMin.z);
+			cy::Vec4f p = modelView * cy::Vec4f(corner, 1.0f);
+			nearest = std::min(nearest, -p.z);
+		}
+		// camera inside or next to the fluid
+		if (nearest <= 0.01f)
+			continue;
+
+		float scale = 0;
+		for (int column = 0; column < 3; ++column) {
+			const float *c = &splat.model.cell[column * 4];
+			scale = std::max(scale, Vec3f(c[0], c[1], c[2]).Length());
+		}
+		float spacingPx = spacing * scale * focalPx / nearest;
+		if (spacingPx >= settings.lodSpacingPx)
+			continue;
+
+		// skipping every other point grows the spacing by 2^(1/3)
+		int lod = (int)std::floor(
+			3.0f * std::log2(settings.lodSpacingPx / spacingPx));
+		splat.lod = std::clamp(lod, 0, pointLodLevels - 1);
+	}
+}
+
+FluidFormats FluidPipeline::ResolveFormats(const FluidSettings &settings,
+										   float maxEyeDepth) {
+	FluidFormats formats;
+	if (!settings.compactFormats)
+		return formats;
+
+	if (HalfStep(maxEyeDepth) <= settings.depthTolerance)
+		formats.depth = GL_R16F;
+	formats.normal = settings.compactNormal;
+	formats.thickness = GL_R16F;
+	return formats;
+}
+
+namespace {
+
+// final targets of a surface
+struct SurfaceDescs {
+	TextureDesc depth, normal, thickness;
+
+	SurfaceDescs(const FluidView &view, const FluidFormats &formats)
+		: depth(MakeDesc(view.width, view.height, formats.depth)),
+		  normal(MakeDesc(view.width, view.height, formats.normal)),
+		  thickness(MakeDesc(view.thicknessWidth, view.thicknessHeight,
+							 formats.thickness)) {
+		thickness.filter = GL_LINEAR;
+	}
+};
+
+} // namespace
+
+/**
+	Persistent targets holding the last filtered surface, `created` is set
+	when any of them had to be reallocated
+*/
+static FluidSurface AddHistoryTargets(RenderGraph &graph,
+									  const FluidView &view,
+									  const FluidFormats &formats,
+									  const std::string &key, bool &created) {
+	SurfaceDescs descs(view, formats);
+	bool depthCreated, normalCreated, thicknessCreated;
+	FluidSurface surface;
+	surface.depth = graph.CreatePersistentTexture(key + "Depth", descs.depth,
+												  &depthCreated);
+	surface.normal = graph.CreatePersistentTexture(key + "Normal", descs.normal,
+												   &normalCreated);
+	surface.thickness = graph.CreatePersistentTexture(
+		key + "Thickness", descs.thickness, &thicknessCreated);
+	created = depthCreated || normalCreated || thicknessCreated;
+	return surface;
+}
+
+/**
+	Splats, filters and reconstructs the surface, into `targets` when given
+	or into transient textures otherwise
+*/
+static FluidSurface AddSurfacePasses(RenderGraph &graph, Renderer &renderer,
+									 const FluidView &view,
+									 const std::vector<FluidSplat> &splats,
+									 const FluidFormats &formats,
+									 const std::string &name,
+									 const FluidSurface *targets = nullptr) {
+	const int numPasses = std::max(view.quality.filterIterations, 1);
+	const int kernelRadius = view.quality.kernelRadius;
+	// splat sizes are in pixels of their own target
+	const float depthScale = view.quality.renderScale;
+	const float thicknessScale = depthScale * view.quality.thicknessScale;
+
+	CameraObject *camera = view.camera;
+	const int frameHeight = view.height;
+	const float fov_v_rad = view.fovY;
+
+	const SurfaceDescs descs(view, formats);
+	TextureDesc zDesc =
+		MakeDesc(view.width, view.height, GL_DEPTH_COMPONENT24);
+	const NormalEncoding encoding = formats.GetNormalEncoding();
+	const RenderResource occluder = view.occluder;
+	const HiZCuller *culler = view.culler;
+	const float cullSpread = view.cullSpread;
+
+	// thickness, only counting fluid in front of the opaque layer
+	RenderResource thickness =
+		targets ? targets->thickness
+				: graph.CreateTexture(name + "Thickness", descs.thickness);
+	RenderResource thicknessZ = NullResource;
+	if (occluder != NullResource) {
+		thicknessZ = graph.CreateTexture(
+			name + "ThicknessZ", MakeDesc(view.thicknessWidth,
+										  view.thicknessHeight,
+										  GL_DEPTH_COMPONENT24));
+	}
+	graph.AddPass(
+		name + "Thickness",
+		[&](RenderGraph::Builder &builder) {
+			builder.Write(thickness);
+			builder.Read(occluder);
+			if (thicknessZ != NullResource)
+				builder.WriteDepth(thicknessZ);
+		},
+		[=, &graph, &renderer]() {
+			glClear(GL_COLOR_BUFFER_BIT);
+			if (occluder != NullResource) {
+				CopyOccluderDepth(graph, renderer, occluder);
+				glDepthMask(GL_FALSE);
+			}
+
+			renderer.BindProgram("thicknessMap");
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			renderer.SetView(camera->GetView());
+			renderer.SetProjection(camera->GetProjection());
+			renderer.SetUniform(
+				"pointSize",
+				std::max((int)std::lround(pointSize * 2 * thicknessScale), 1));
+			DrawSplats(renderer, splats, culler, cullSpread);
+			glDisable(GL_BLEND);
+
+			if (occluder != NullResource) {
+				glDepthMask(GL_TRUE);
+				glDisable(GL_DEPTH_TEST);
+			}
+		});
+
+	// PARTICLE DEPTH MAP
+	// Z starts out as the opaque depth, so hidden splats fail the depth test
+	// and never reach the filter
+	RenderResource depth = graph.CreateTexture(name + "Depth", descs.depth);
+	RenderResource z = graph.CreateTexture(name + "Z", zDesc);
+	graph.AddPass(
+		name + "Depth",
+		[&](RenderGraph::Builder &builder) {
+			builder.Write(depth);
+			builder.WriteDepth(z);
+			builder.Read(occluder);
+		},
+		[=, &graph, &renderer]() {
+			glEnable(GL_DEPTH_TEST);
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS); // or GL_LEQUAL
+			glDisable(GL_CULL_FACE);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (occluder != NullResource)
+				CopyOccluderDepth(graph, renderer, occluder);
+
+			renderer.BindProgram("waterDepth");
+			renderer.SetView(camera->GetView());
+			renderer.SetProjection(camera->GetProjection());
+			renderer.SetUniform(
+				"pointSize",
+				std::max((int)std::lround(pointSize * depthScale), 1));
+			DrawSplats(renderer, splats, culler, cullSpread);
+		});
+
+	// NARROW FILTER
+	// each iteration gets its own resource, the graph aliases them down to a
+	// ping-pong pair. The last iteration also reconstructs normals from the
+	// filtered depth it has in registers, writing both through MRT.
+	float r = pointSize;
+	RenderResource normal = NullResource;
+	for (int i = 0; i < numPasses; ++i) {
+		const bool last = i == numPasses - 1;
+		RenderResource input = depth;
+		if (last && targets) {
+			depth = targets->depth;
+			normal = targets->normal;
+		} else {
+			depth = graph.CreateTexture(name + "FilteredDepth", descs.depth);
+			if (last)
+				normal = graph.CreateTexture(name + "Normal", descs.normal);
+		}
+		RenderResource output = depth;
+
+		graph.AddPass(
+			"narrowFilter",
+			[&](RenderGraph::Builder &builder) {
+				builder.Read(input);
+				builder.Write(output);
+				if (last)
+					builder.Write(normal);
+			},
+			[=, &graph, &renderer]() {
+				glClear(GL_COLOR_BUFFER_BIT);
+
+				renderer.BindProgram("narrowFilter");
+				renderer.BindTexture("uDepthTex", graph.GetTexture(input),
+									 GL_TEXTURE0);
+
+				renderer.SetUniform("uDelta", 10 * r);
+				renderer.SetUniform("uMu", r);
+				renderer.SetUniform("uWorldSigma", 0.7f * r);
+				renderer.SetUniform("uKernelRadius", kernelRadius);
+
+				renderer.SetUniform("uFOV", fov_v_rad);
+				renderer.SetUniform("uScreenHeight", (float)frameHeight);
+
+				renderer.SetUniform("uWriteNormals", last);
+				renderer.SetUniform("uNormalEncoding", (int)encoding);
+
+				renderer.DrawFullscreenQuad();
+			});
+	}
+
+	return {depth, normal, thickness};
+}
+
+
+static std::vector<float> ReadTexture(GLuint texture, int width, int height,
+									  GLenum format, int components) {
+	std::vector<float> data((size_t)width * height * components);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, format, GL_FLOAT, data.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return data;
+}
+
+static Vec3f DecodeNormal(const float *texel, NormalEncoding encoding) {
+	if (encoding == PackedNormals)
+		return Vec3f(texel[0], texel[1], texel[2]) * 2.0f - Vec3f(1.0f);
+
+	float x = texel[0] * 2.0f - 1.0f, y = texel[1] * 2.0f - 1.0f;
+	Vec3f n(x, y, 1.0f - std::abs(x) - std::abs(y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return n.GetNormalized();
+}
+
+/**
+	Reads both sets of targets back and prints how far the compact formats
+	drift from the 32-bit ones
+*/
+static void AddFormatErrorReport(RenderGraph &graph, const FluidView &view,
+								 const FluidSurface &compact,
+								 const FluidSurface &reference,
+								 const FluidFormats &formats) {
+	graph.AddPass(
+		"fluidFormatError",
+		[&](RenderGraph::Builder &builder) {
+			builder.Read(compact.depth);
+			builder.Read(compact.normal);
+			builder.Read(compact.thickness);
+			builder.Read(reference.depth);
+			builder.Read(reference.normal);
+			builder.Read(reference.thickness);
+			builder.SideEffect();
+		},
+		[=, &graph]() {
+			const int w = view.width, h = view.height;
+			const NormalEncoding encoding = formats.GetNormalEncoding();
+			const int normalComponents = encoding == PackedNormals ? 3 : 2;
+
+			auto depth =
+				ReadTexture(graph.GetTexture(compact.depth), w, h, GL_RED, 1);
+			auto refDepth = ReadTexture(graph.GetTexture(reference.depth), w,
+										h, GL_RED, 1);
+			const int tw = view.thicknessWidth, th = view.thicknessHeight;
+			auto thickness = ReadTexture(graph.GetTexture(compact.thickness),
+										 tw, th, GL_RED, 1);
+			auto refThickness = ReadTexture(
+				graph.GetTexture(reference.thickness), tw, th, GL_RED, 1);
+			auto normal = ReadTexture(graph.GetTexture(compact.normal), w, h,
+									  normalComponents == 3 ? GL_RGB : GL_RG,
+									  normalComponents);
+			auto refNormal = ReadTexture(graph.GetTexture(reference.normal),
+										 w, h, GL_RGB, 3);
+
+			size_t covered = 0, coverageMismatch = 0;
+			double depthSum = 0, thicknessSum = 0, angleSum = 0;
+			float depthMax = 0, thicknessMax = 0, angleMax = 0;
+			for (size_t i = 0; i < refDepth.size(); ++i) {
+				if ((refDepth[i] == 0.0f) != (depth[i] == 0.0f))
+					coverageMismatch++;
+				if (refDepth[i] == 0.0f)
+					continue;
+				covered++;
+
+				float depthError = std::abs(depth[i] - refDepth[i]);
+
+				Vec3f n = DecodeNormal(&normal[i * normalComponents], encoding);
+				Vec3f refN =
+					DecodeNormal(&refNormal[i * 3], PackedNormals).GetNormalized();
+				float cosAngle = std::clamp(n.Dot(refN), -1.0f, 1.0f);
+				float angle = rad2deg(std::acos(cosAngle));
+
+				depthSum += depthError;
+				angleSum += angle;
+				depthMax = std::max(depthMax, depthError);
+				angleMax = std::max(angleMax, angle);
+			}
+
+			// thickness may be at a lower resolution than depth
+			size_t thicknessCovered = 0;
+			for (size_t i = 0; i < refThickness.size(); ++i) {
+				if (refThickness[i] == 0.0f)
+					continue;
+				thicknessCovered++;
+				float thicknessError =
+					std::abs(thickness[i] - refThickness[i]);
+				thicknessSum += thicknessError;
+				thicknessMax = std::max(thicknessMax, thicknessError);
+			}
+
+			auto texelBytes = [&](GLenum depthFormat, GLenum normalFormat,
+								  GLenum thicknessFormat) {
+				return MakeDesc(1, 1, depthFormat).ByteSize() +
+					   MakeDesc(1, 1, normalFormat).ByteSize() +
+					   MakeDesc(1, 1, thicknessFormat).ByteSize();
+			};
+			FluidFormats full;
+			double n = std::max<size_t>(covered, 1);
+
+			std::cout << "fluid format error over " << covered
+					  << " fluid pixels (" << coverageMismatch
+					  << " coverage mismatches)" << std::endl;
+			std::cout << "  depth" << (formats.depth == GL_R16F ? " R16F" : " R32F")
+					  << ": mean " << depthSum / n << ", max " << depthMax
+					  << std::endl;
+			std::cout << "  normal"
+					  << (formats.normal == GL_RG8
+							  ? " RG8 oct"
+							  : (formats.normal == GL_RG16 ? " RG16 oct"
+														   : " RGB16F"))
+					  << ": mean " << angleSum / n << " deg, max " << angleMax
+					  << " deg" << std::endl;
+			std::cout << "  thickness"
+					  << (formats.thickness == GL_R16F ? " R16F" : " R32F")
+					  << ": mean "
+					  << thicknessSum / std::max<size_t>(thicknessCovered, 1)
+					  << ", max " << thicknessMax << std::endl;
+			std::cout << "  bytes per pixel: "
+					  << texelBytes(formats.depth, formats.normal,
+									formats.thickness)
+					  << " vs "
+					  << texelBytes(full.depth, full.normal, full.thickness)
+					  << std::endl;
+		});
+}
+
+// fragments per pixel at which the heatmap saturates
+static constexpr float overdrawHeatmapMax = 16.0f;
+static constexpr size_t overdrawReportFrames = 60;
+
+/**
+	Re-splats one pass's points with additive blending, so each texel ends
+	up holding how many fragments the pass shades there. Splats still test
+	against the occluder but not against each other, as the depth pass's
+	discard keeps early depth testing from rejecting its own layers. The
+	counts are read back every frame, so this is an analysis mode only.
+*/
+static RenderResource
+AddOverdrawPass(RenderGraph &graph, Renderer &renderer, const FluidView &view,
+				const std::vector<FluidSplat> &splats, OverdrawView mode,
+				FluidPipeline::OverdrawStats &stats) {
+	const bool thicknessPass = mode == OverdrawView::Thickness;
+	const int width = thicknessPass ? view.thicknessWidth : view.width;
+	const int height = thicknessPass ? view.thicknessHeight : view.height;
+	const float scale = thicknessPass ? view.quality.renderScale *
+											 view.quality.thicknessScale
+									  : view.quality.renderScale;
+	const int size =
+		std::max((int)std::lround(pointSize * (thicknessPass ? 2 : 1) * scale),
+				 1);
+
+	const RenderResource occluder = view.occluder;
+	const HiZCuller *culler = view.culler;
+	const float cullSpread = view.cullSpread;
+	CameraObject *camera = view.camera;
+	RenderResource count =
+		graph.CreateTexture("fluidOverdraw", MakeDesc(width, height, GL_R32F));
+	RenderResource z = NullResource;
+	if (occluder != NullResource)
+		z = graph.CreateTexture("fluidOverdrawZ",
+								MakeDesc(width, height, GL_DEPTH_COMPONENT24));
+	graph.AddPass(
+		"fluidOverdraw",
+		[&](RenderGraph::Builder &builder) {
+			builder.Write(count);
+			builder.Read(occluder);
+			if (z != NullResource)
+				builder.WriteDepth(z);
+		},
+		[=, &graph, &renderer, &stats]() {
+			glClear(GL_COLOR_BUFFER_BIT);
+			if (occluder != NullResource) {
+				CopyOccluderDepth(graph, renderer, occluder);
+				glDepthMask(GL_FALSE);
+			}
+
+			// the thickness program writes 1 per fragment
+			renderer.BindProgram("thicknessMap");
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			renderer.SetView(camera->GetView());
+			renderer.SetProjection(camera->GetProjection());
+			renderer.SetUniform("pointSize", size);
+			DrawSplats(renderer, splats, culler, cullSpread);
+			glDisable(GL_BLEND);
+
+			if (occluder != NullResource) {
+				glDepthMask(GL_TRUE);
+				glDisable(GL_DEPTH_TEST);
+			}
+
+			auto counts =
+				ReadTexture(graph.GetTexture(count), width, height, GL_RED, 1);
+			for (float c : counts) {
+				if (c <= 0.0f)
+					continue;
+				stats.fragments += c;
+				stats.coveredPixels++;
+				stats.peak = std::max(stats.peak, c);
+			}
+			stats.pixels += counts.size();
+			if (++stats.frames < overdrawReportFrames)
+				return;
+
+			std::cout << "overdraw ("
+					  << (thicknessPass ? "thickness" : "depth")
+					  << " splats, " << stats.frames << " frames): mean "
+					  << stats.fragments / std::max(stats.coveredPixels, 1.0)
+					  << " fragments per covered pixel, peak " << stats.peak
+					  << ", " << 100.0 * stats.coveredPixels / stats.pixels
+					  << "% of pixels covered" << std::endl;
+			// sample queries lag a few frames behind
+			std::cout << "  samples passed:";
+			for (const auto &pass : graph.GetPassTimes()) {
+				if (pass.samples > 0)
+					std::cout << " " << pass.name << " " << pass.samples;
+			}
+			std::cout << std::endl;
+			stats = FluidPipeline::OverdrawStats{};
+		});
+	return count;
+}
+
+static size_t nextPipelineId = 0;
+
+FluidPipeline::FluidPipeline()
+	: historyKey("fluidHistory" + std::to_string(nextPipelineId++)) {}
+
+bool FluidPipeline::Inputs::operator==(const Inputs &other) const {
+	return fluids == other.fluids && versions == other.versions &&
+		   models == other.models && lods == other.lods &&
+		   view == other.view && projection == other.projection &&
+		   width == other.width &&
+		   height == other.height && formats == other.formats &&
+		   quality == other.quality && occluded == other.occluded &&
+		   opaqueVersion == other.opaqueVersion;
+}
+
+void FluidPipeline::AddPasses(RenderGraph &graph, Renderer &renderer,
+							  Scene *scene,
+							  const std::vector<FluidSplat> &sources) {
+	if (sources.empty())
+		return;
+
+	RenderResource opaque = graph.Find("opaque");
+	RenderResource opaqueDepth = graph.Find("opaqueDepth");
+	RenderResource post = graph.Find("post");
+
+	CameraObject *camera = scene->GetActiveCamera();
+
+	FluidSettings &settings = renderer.GetFluidSettings();
+
+	FluidView view;
+	view.camera = camera;
+	view.quality = settings.quality;
+	auto scaled = [](int size, float scale) {
+		return std::max((int)std::lround(size * scale), 1);
+	};
+	view.width = scaled(renderer.GetWidth(), view.quality.renderScale);
+	view.height = scaled(renderer.GetHeight(), view.quality.renderScale);
+	view.thicknessWidth = scaled(view.width, view.quality.thicknessScale);
+	view.thicknessHeight = scaled(view.height, view.quality.thicknessScale);
+	view.aspect = (float)renderer.GetWidth() / (float)renderer.GetHeight();
+	view.occluder = settings.occludeSplats ? opaqueDepth : NullResource;
+	// chunks are culled only when neither their splats nor the filter
+	// spreading those would get past the depth test, so the surface, and
+	// its reuse, don't depend on the culling
+	view.culler = view.occluder != NullResource && settings.occlusionCulling
+					  ? &scene->GetHiZCuller()
+					  : nullptr;
+	// a copied depth texel of the thickness target covers the most window
+	// pixels, and every filter iteration reaches kernelRadius texels further
+	const int filterIterations = std::max(view.quality.filterIterations, 1);
+	view.cullSpread = (1.0f / view.quality.thicknessScale +
+					   view.quality.kernelRadius * filterIterations) /
+					  view.quality.renderScale;
+	view.fovY = 2.0f * std::atan(std::tan(deg2rad(camera->GetFov()) / 2.0f) /
+								 view.aspect);
+	const float aspect = view.aspect;
+	const float fov_v_rad = view.fovY;
+
+	std::vector<FluidSplat> splats = sources;
+	ChooseLods(splats, view, settings);
+
+	const FluidFormats formats =
+		ResolveFormats(settings, MaxEyeDepth(splats, camera->GetView()));
+	const NormalEncoding encoding = formats.GetNormalEncoding();
+
+	Inputs inputs;
+	for (const FluidSplat &splat : splats) {
+		inputs.fluids.push_back(splat.fluid);
+		inputs.versions.push_back(splat.fluid->GetVersion());
+		inputs.models.push_back(splat.model);
+		inputs.lods.push_back(splat.lod);
+	}
+	inputs.view = camera->GetView();
+	inputs.projection = camera->GetProjection();
+	inputs.width = view.width;
+	inputs.height = view.height;
+	inputs.formats = formats;
+	inputs.quality = view.quality;
+	inputs.occluded = view.occluder != NullResource;
+	if (inputs.occluded)
+		inputs.opaqueVersion = scene->GetOpaqueVersion();
+
+	// the error report and the overdraw view need freshly splatted
+	// surfaces
+	const OverdrawView overdrawView = settings.overdrawView;
+	const bool useHistory = settings.reuseUnchanged &&
+							!settings.reportFormatError &&
+							overdrawView == OverdrawView::Off;
+	FluidSurface surface;
+	reused = false;
+	if (useHistory) {
+		bool created;
+		FluidSurface history =
+			AddHistoryTargets(graph, view, formats, historyKey, created);
+		reused = hasHistory && !created && inputs == lastInputs;
+		surface = reused ? history
+						 : AddSurfacePasses(graph, renderer, view, splats,
+											formats, "fluid", &history);
+	} else {
+		surface =
+			AddSurfacePasses(graph, renderer, view, splats, formats, "fluid");
+	}
+	hasHistory = useHistory;
+	lastInputs = std::move(inputs);
+
+	RenderResource depth = surface.depth;
+	RenderResource normal = surface.normal;
+	RenderResource thickness = surface.thickness;
+
+	if (settings.reportFormatError) {
+		settings.reportFormatError = false;
+		FluidSurface reference = AddSurfacePasses(
+			graph, renderer, view, splats, FluidFormats{}, "fluidReference");
+		AddFormatErrorReport(graph, view, surface, reference, formats);
+	}
+
+	if (overdrawView != OverdrawView::Off) {
+		RenderResource count = AddOverdrawPass(graph, renderer, view, splats,
+											   overdrawView, overdraw);
+		graph.AddPass(
+			"fluidOverdrawView",
+			[&](RenderGraph::Builder &builder) {
+				builder.Read(count);
+				// keeps the surface passes running, so their samples and
+				// timings are still measured
+				builder.Read(depth);
+				builder.Read(normal);
+				builder.Read(thickness);
+				builder.Write(post);
+			},
+			[=, &graph, &renderer]() {
+				renderer.BindProgram("debugDisplay");
+				renderer.BindTexture("uTexture", graph.GetTexture(count),
+									 GL_TEXTURE0);
+				renderer.SetUniform("uHeatmapMax", overdrawHeatmapMax);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				renderer.DrawFullscreenQuad();
+			});
+		return;
+	}
+	overdraw = OverdrawStats{};
+
+	// RENDERING
+	graph.AddPass(
+		"fluidShading",
+		[&](RenderGraph::Builder &builder) {
+			builder.Read(normal);
+			builder.Read(depth);
+			builder.Read(thickness);
+			builder.Read(opaque);
+			builder.Read(opaqueDepth);
+			builder.Write(post);
+		},
+		[=, &graph, &renderer]() {
+			renderer.BindProgram("fluidProgram");
+
+			renderer.SetView(camera->GetView());
+			renderer.SetProjection(camera->GetProjection());
+			renderer.SetUniform("viewPos", camera->GetPosition());
+			renderer.SetUniform("lightPos", scene->GetSunPosition());
+
+			renderer.SetUniform("materialType", 1);
+			renderer.SetUniform("shading", 1);
+
+			renderer.SetUniform("shininess", 64.0f);
+			renderer.SetUniform("ambientColor", Vec3f(0.1f, 0.2f, 0.25f));
+			renderer.SetUniform("diffuseColor", Vec3f(0.25f, 0.55f, 0.75f));
+			renderer.SetUniform("specularColor", Vec3f(1.0f, 1.0f, 1.0f));
+
+			renderer.BindTexture("uNormalTex", graph.GetTexture(normal),
+								 GL_TEXTURE0);
+			renderer.BindTexture("uDepthTex", graph.GetTexture(depth),
+								 GL_TEXTURE1);
+			renderer.BindTexture("uThicknessTex", graph.GetTexture(thickness),
+								 GL_TEXTURE2);
+			glActiveTexture(GL_TEXTURE3);
+			scene->GetActiveSkybox()->GetTexture().Bind();
+			renderer.SetUniform("uSkyboxTex", 3);
+			renderer.BindTexture("uOpaqueDepthTex",
+								 graph.GetTexture(opaqueDepth), GL_TEXTURE4);
+			renderer.BindTexture("uBackgroundColorTex",
+								 graph.GetTexture(opaque), GL_TEXTURE5);
+
+			renderer.SetUniform("uNormalEncoding", (int)encoding);
+			renderer.SetUniform("uFovY", fov_v_rad);
+			renderer.SetUniform("uAspect", aspect);
+			// renderer.SetUniform("uTime", (float)glfwGetTime());
+			renderer.SetUniform("uTime", fmod((float)glfwGetTime(), 60.0f));
+
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			renderer.DrawFullscreenQuad();
+		});
+}
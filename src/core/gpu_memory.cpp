@@ -0,0 +1,238 @@
+#include "core/gpu_memory.hpp"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace engine;
+
+namespace {
+
+struct Allocation {
+	GpuCategory category;
+	std::string owner;
+	size_t bytes = 0;
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::map<std::pair<GpuObject, GLuint>, Allocation> allocations;
+	GpuMemory::Stats total;
+	GpuMemory::Stats categories[(size_t)GpuCategory::Count];
+};
+
+// never destroyed, so objects released during static destruction can
+// still find it
+Registry &registry() {
+	static Registry *instance = new Registry();
+	return *instance;
+}
+
+void addBytes(Registry &reg, GpuCategory category, long long delta) {
+	for (GpuMemory::Stats *stats :
+		 {&reg.total, &reg.categories[(size_t)category]}) {
+		stats->bytes = (size_t)((long long)stats->bytes + delta);
+		stats->peakBytes = std::max(stats->peakBytes, stats->bytes);
+	}
+}
+
+const char *objectName(GpuObject type) {
+	switch (type) {
+	case GpuObject::Buffer:
+		return "buffer";
+	case GpuObject::Texture:
+		return "texture";
+	case GpuObject::Renderbuffer:
+		return "renderbuffer";
+	}
+	return "";
+}
+
+constexpr double mb = 1024.0 * 1024.0;
+
+} // namespace
+
+const char *engine::gpuCategoryName(GpuCategory category) {
+	switch (category) {
+	case GpuCategory::Geometry:
+		return "geometry";
+	case GpuCategory::Points:
+		return "points";
+	case GpuCategory::RenderTarget:
+		return "render targets";
+	case GpuCategory::Texture:
+		return "textures";
+	case GpuCategory::Readback:
+		return "readback";
+	case GpuCategory::Count:
+		break;
+	}
+	return "";
+}
+
+void GpuMemory::Track(GpuObject type, GLuint id, GpuCategory category,
+					  const std::string &owner, size_t bytes) {
+	if (id == 0)
+		return;
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto [it, inserted] =
+		reg.allocations.emplace(std::make_pair(type, id), Allocation{});
+	if (!inserted) {
+		// GL reused the id of an object deleted behind our back
+		addBytes(reg, it->second.category, -(long long)it->second.bytes);
+		reg.categories[(size_t)it->second.category].objects--;
+		reg.total.objects--;
+	}
+	it->second = Allocation{category, owner, bytes};
+	reg.categories[(size_t)category].objects++;
+	reg.total.objects++;
+	addBytes(reg, category, (long long)bytes);
+}
+
+void GpuMemory::Untrack(GpuObject type, GLuint id) {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto it = reg.allocations.find({type, id});
+	if (it == reg.allocations.end())
+		return;
+	addBytes(reg, it->second.category, -(long long)it->second.bytes);
+	reg.categories[(size_t)it->second.category].objects--;
+	reg.total.objects--;
+	reg.allocations.erase(it);
+}
+
+void GpuMemory::SetSize(GpuObject type, GLuint id, size_t bytes) {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto it = reg.allocations.find({type, id});
+	if (it == reg.allocations.end())
+		return;
+	addBytes(reg, it->second.category,
+			 (long long)bytes - (long long)it->second.bytes);
+	it->second.bytes = bytes;
+}
+
+GLuint GpuMemory::CreateBuffer(GpuCategory category,
+							   const std::string &owner) {
+	GLuint id = 0;
+	glGenBuffers(1, &id);
+	Track(GpuObject::Buffer, id, category, owner, 0);
+	return id;
+}
+
+GLuint GpuMemory::CreateTexture(GpuCategory category,
+								const std::string &owner) {
+	GLuint id = 0;
+	glGenTextures(1, &id);
+	Track(GpuObject::Texture, id, category, owner, 0);
+	return id;
+}
+
+GLuint GpuMemory::CreateRenderbuffer(GpuCategory category,
+									 const std::string &owner) {
+	GLuint id = 0;
+	glGenRenderbuffers(1, &id);
+	Track(GpuObject::Renderbuffer, id, category, owner, 0);
+	return id;
+}
+
+void GpuMemory::DeleteBuffer(GLuint &id) {
+	if (id == 0)
+		return;
+	Untrack(GpuObject::Buffer, id);
+	glDeleteBuffers(1, &id);
+	id = 0;
+}
+
+void GpuMemory::DeleteTexture(GLuint &id) {
+	if (id == 0)
+		return;
+	Untrack(GpuObject::Texture, id);
+	glDeleteTextures(1, &id);
+	id = 0;
+}
+
+void GpuMemory::DeleteRenderbuffer(GLuint &id) {
+	if (id == 0)
+		return;
+	Untrack(GpuObject::Renderbuffer, id);
+	glDeleteRenderbuffers(1, &id);
+	id = 0;
+}
+
+void GpuMemory::BufferData(GLenum target, GLuint id, size_t bytes,
+						   const void *data, GLenum usage) {
+	glBufferData(target, (GLsizeiptr)bytes, data, usage);
+	SetSize(GpuObject::Buffer, id, bytes);
+}
+
+GpuMemory::Stats GpuMemory::GetStats() {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return reg.total;
+}
+
+GpuMemory::Stats GpuMemory::GetStats(GpuCategory category) {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return reg.categories[(size_t)category];
+}
+
+void GpuMemory::PrintReport() {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	std::cout << "gpu memory: " << reg.total.bytes / mb << " MB in "
+			  << reg.total.objects << " objects (peak "
+			  << reg.total.peakBytes / mb << " MB)" << std::endl;
+	for (size_t c = 0; c < (size_t)GpuCategory::Count; ++c) {
+		const Stats &stats = reg.categories[c];
+		if (stats.peakBytes == 0 && stats.objects == 0)
+			continue;
+		std::cout << "  " << gpuCategoryName((GpuCategory)c) << ": "
+				  << stats.bytes / mb << " MB in " << stats.objects
+				  << " objects (peak " << stats.peakBytes / mb << " MB)"
+				  << std::endl;
+	}
+
+	// largest owners first
+	std::map<std::string, Stats> owners;
+	for (const auto &[key, allocation] : reg.allocations) {
+		Stats &stats = owners[allocation.owner];
+		stats.objects++;
+		stats.bytes += allocation.bytes;
+	}
+	std::vector<std::pair<std::string, Stats>> sorted(owners.begin(),
+													  owners.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+		return a.second.bytes > b.second.bytes;
+	});
+	for (const auto &[owner, stats] : sorted) {
+		std::cout << "    " << owner << ": " << stats.bytes / mb << " MB in "
+				  << stats.objects << " objects" << std::endl;
+	}
+}
+
+size_t GpuMemory::CheckLeaks() {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	if (reg.allocations.empty()) {
+		std::cout << "gpu memory: no leaks, peak " << reg.total.peakBytes / mb
+				  << " MB" << std::endl;
+		return 0;
+	}
+
+	std::cout << "gpu memory: " << reg.allocations.size()
+			  << " objects leaked (" << reg.total.bytes / mb << " MB)"
+			  << std::endl;
+	for (const auto &[key, allocation] : reg.allocations) {
+		std::cout << "  " << objectName(key.first) << " " << key.second
+				  << ": " << allocation.owner << " ("
+				  << gpuCategoryName(allocation.category) << ", "
+				  << allocation.bytes / mb << " MB)" << std::endl;
+	}
+	return reg.allocations.size();
+}
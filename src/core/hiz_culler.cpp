@@ -0,0 +1,235 @@
+#include "core/hiz_culler.hpp"
+#include "core/gpu_memory.hpp"
+#include "core/renderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace engine;
+
+HiZCuller::~HiZCuller() {
+	for (Readback &readback : readbacks) {
+		if (readback.fence != 0)
+			glDeleteSync(readback.fence);
+	}
+}
+
+void HiZCuller::Resolve() {
+	// both slots can signal in the same frame, only the newer one is kept
+	Readback *newest = nullptr;
+	for (Readback &readback : readbacks) {
+		if (readback.fence == 0)
+			continue;
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+		if (newest == nullptr || readback.frame > newest->frame)
+			newest = &readback;
+	}
+	if (newest == nullptr || (valid && newest->frame <= depthFrame))
+		return;
+
+	width = newest->width;
+	height = newest->height;
+	baseWidth = newest->baseWidth;
+	baseHeight = newest->baseHeight;
+	levels = newest->levels;
+	depth.resize((size_t)width * height);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, newest->pbo.Get());
+	glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, depth.size() * sizeof(float),
+					   depth.data());
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	depthProjection = newest->projection;
+	depthViewProj = newest->viewProj;
+	depthFrame = newest->frame;
+	valid = true;
+}
+
+void HiZCuller::AddPasses(RenderGraph &graph, Renderer &renderer,
+						  RenderResource opaqueDepth,
+						  const Matrix4f &projection, const Matrix4f &view) {
+	Resolve();
+	const Matrix4f viewProj = projection * view;
+	this->viewProj = viewProj;
+	stats = Stats{};
+
+	// max-depth pyramid, halving until the readback size. sizes round
+	// up, so texel i of level k covers full-resolution texels i << k up
+	// to ((i + 1) << k) - 1
+	RenderResource level = opaqueDepth;
+	TextureDesc desc = graph.GetDesc(opaqueDepth);
+	const int baseWidth = desc.width, baseHeight = desc.height;
+	screenWidth = baseWidth;
+	screenHeight = baseHeight;
+	int levels = 0;
+	desc.internalFormat = GL_R32F;
+	desc.format = GL_RED;
+	desc.type = GL_FLOAT;
+	do {
+		desc.width = (desc.width + 1) / 2;
+		desc.height = (desc.height + 1) / 2;
+		levels++;
+
+		RenderResource input = level;
+		RenderResource output = graph.CreateTexture("hiZ", desc);
+		graph.AddPass(
+			"hiZ",
+			[&](RenderGraph::Builder &builder) {
+				builder.Read(input);
+				builder.Write(output);
+			},
+			[=, &graph, &renderer]() {
+				renderer.BindProgram("hiZ");
+				renderer.BindTexture("uDepthTex", graph.GetTexture(input),
+									 GL_TEXTURE0);
+				renderer.DrawFullscreenQuad();
+			});
+		level = output;
+	} while (desc.width > maxReadbackSize || desc.height > maxReadbackSize);
+
+	// a slot whose previous readback never finished is dropped
+	Readback &readback = readbacks[frame % 2];
+	const size_t issued = ++frame;
+	if (readback.fence != 0) {
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+	}
+	if (!readback.pbo)
+		readback.pbo = GLBuffer::Create(GpuCategory::Readback, "hi-z readback");
+
+	graph.AddPass(
+		"hiZReadback",
+		[&](RenderGraph::Builder &builder) {
+			builder.Read(level);
+			builder.SideEffect();
+		},
+		[=, &graph, &readback]() {
+			readback.width = desc.width;
+			readback.height = desc.height;
+			readback.baseWidth = baseWidth;
+			readback.baseHeight = baseHeight;
+			readback.levels = levels;
+			readback.projection = projection;
+			readback.viewProj = viewProj;
+			readback.frame = issued;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo.Get());
+			GpuMemory::BufferData(
+				GL_PIXEL_PACK_BUFFER, readback.pbo.Get(),
+				(size_t)desc.width * desc.height * sizeof(float), nullptr,
+				GL_STREAM_READ);
+			glBindTexture(GL_TEXTURE_2D, graph.GetTexture(level));
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, nullptr);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		});
+}
+
+namespace {
+
+/** Window-space bounds of a box, false if it crosses the camera plane */
+bool projectBox(const Matrix4f &mvp, const Vec3f &boundMin,
+				const Vec3f &boundMax, Vec3f corners[8]) {
+	for (int c = 0; c < 8; ++c) {
+		Vec3f corner((c & 1) ? boundMax.x : boundMin.x,
+					 (c & 2) ? boundMax.y : boundMin.y,
+					 (c & 4) ? boundMax.z : boundMin.z);
+		cy::Vec4f p = mvp * cy::Vec4f(corner, 1.0f);
+		if (p.w <= 1e-4f)
+			return false;
+		// [0, 1] across the window, y flipped like every scene vertex
+		// shader does
+		corners[c] = Vec3f(p.x / p.w * 0.5f + 0.5f, -p.y / p.w * 0.5f + 0.5f,
+						   p.z / p.w * 0.5f + 0.5f);
+	}
+	return true;
+}
+
+} // namespace
+
+bool HiZCuller::IsHidden(const Vec3f &boundMin, const Vec3f &boundMax,
+						 const Matrix4f &model, float splatRadius,
+						 float spread) const {
+	stats.tested++;
+	const float reach = splatRadius + spread;
+
+	Vec3f now[8];
+	if (!projectBox(viewProj * model, boundMin, boundMax, now))
+		return false;
+	Vec3f nowMin = now[0], nowMax = now[0];
+	for (const Vec3f &p : now) {
+		nowMin = Vec3f(std::min(nowMin.x, p.x), std::min(nowMin.y, p.y), 0);
+		nowMax = Vec3f(std::max(nowMax.x, p.x), std::max(nowMax.y, p.y), 0);
+	}
+	const float reachX = reach / screenWidth, reachY = reach / screenHeight;
+	if (nowMax.x + reachX < 0 || nowMax.y + reachY < 0 ||
+		nowMin.x - reachX > 1 || nowMin.y - reachY > 1) {
+		stats.hidden++;
+		return true;
+	}
+	if (!valid)
+		return false;
+
+	// where the box was in the frame the depth is from, grown by how far
+	// the camera moved it since and by how far its splats reach
+	const Matrix4f mvp = depthViewProj * model;
+	Vec3f then[8];
+	if (!projectBox(mvp, boundMin, boundMax, then))
+		return false;
+	float minX = std::numeric_limits<float>::max(), minY = minX;
+	float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+	float shiftX = 0, shiftY = 0;
+	for (int c = 0; c < 8; ++c) {
+		minX = std::min(minX, then[c].x), maxX = std::max(maxX, then[c].x);
+		minY = std::min(minY, then[c].y), maxY = std::max(maxY, then[c].y);
+		shiftX = std::max(shiftX, std::abs(now[c].x - then[c].x));
+		shiftY = std::max(shiftY, std::abs(now[c].y - then[c].y));
+	}
+	minX -= shiftX + reach / baseWidth, maxX += shiftX + reach / baseWidth;
+	minY -= shiftY + reach / baseHeight, maxY += shiftY + reach / baseHeight;
+
+	// the nearest corner, pulled toward the camera by a splat radius. a
+	// splat's world size grows with its distance, so the nearest any
+	// splat gets is that corner's eye depth scaled down
+	float eyeDepth = std::numeric_limits<float>::max();
+	for (int c = 0; c < 8; ++c) {
+		Vec3f corner((c & 1) ? boundMax.x : boundMin.x,
+					 (c & 2) ? boundMax.y : boundMin.y,
+					 (c & 4) ? boundMax.z : boundMin.z);
+		eyeDepth = std::min(eyeDepth, (mvp * cy::Vec4f(corner, 1.0f)).w);
+	}
+	// world units per window pixel are 2 * depth / (cot(fovY / 2) * height)
+	const float pull =
+		2.0f * splatRadius / (depthProjection.cell[5] * baseHeight);
+	if (pull >= 1.0f)
+		return false;
+	const cy::Vec4f nearest = depthProjection *
+							  cy::Vec4f(0.0f, 0.0f, -eyeDepth * (1.0f - pull),
+										1.0f);
+	const float minZ = nearest.z / nearest.w * 0.5f + 0.5f;
+
+	// full-resolution texels, then the pyramid texels covering them
+	auto texel = [&](float f, int base, int size) {
+		const int full = std::clamp((int)std::floor(f * base), 0, base - 1);
+		return std::min(full >> levels, size - 1);
+	};
+	const int x0 = texel(minX, baseWidth, width),
+			  x1 = texel(maxX, baseWidth, width);
+	const int y0 = texel(minY, baseHeight, height),
+			  y1 = texel(maxY, baseHeight, height);
+	float maxDepth = 0;
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x)
+			maxDepth = std::max(maxDepth, depth[(size_t)y * width + x]);
+	}
+
+	const bool hidden = minZ > maxDepth;
+	if (hidden)
+		stats.hidden++;
+	return hidden;
+}
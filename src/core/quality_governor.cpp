@@ -0,0 +1,83 @@
+#include "core/quality_governor.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace engine;
+
+// render scale, filter iterations, kernel radius, thickness scale
+static const FluidQuality ladder[] = {
+	{0.5f, 1, 4, 0.5f},	 {0.5f, 2, 6, 0.5f},  {0.75f, 2, 6, 0.5f},
+	{0.75f, 3, 8, 0.5f}, {1.0f, 3, 8, 0.5f},  {1.0f, 3, 8, 1.0f},
+};
+
+const FluidQuality &QualityGovernor::GetLevel(int level) {
+	return ladder[level];
+}
+
+int QualityGovernor::NumLevels() {
+	return (int)(sizeof(ladder) / sizeof(ladder[0]));
+}
+
+QualityGovernor::QualityGovernor()
+	: level(NumLevels() - 1), retryFrames(upFrames) {
+	stats.level = level;
+	stats.levels = NumLevels();
+}
+
+void QualityGovernor::SetLevel(int newLevel, FluidSettings &settings) {
+	if (newLevel < level) {
+		// dropped straight back from a level we just climbed to
+		retryFrames = level == failedLevel
+						  ? std::min(retryFrames * 2, maxRetryFrames)
+						  : upFrames;
+		failedLevel = level;
+	}
+
+	level = newLevel;
+	settings.quality = GetLevel(level);
+	overBudget = underBudget = 0;
+	cooldown = settleFrames;
+
+	stats.level = level;
+	PrintStats();
+}
+
+void QualityGovernor::Update(double gpuMs, FluidSettings &settings) {
+	stats.gpuMs = gpuMs;
+	stats.targetMs = settings.targetFrameMs;
+	if (!settings.adaptiveQuality || gpuMs <= 0)
+		return;
+
+	smoothed =
+		smoothed == 0 ? gpuMs : smoothed + smoothing * (gpuMs - smoothed);
+	stats.smoothedMs = smoothed;
+
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+
+	const double target = settings.targetFrameMs;
+	if (smoothed > target) {
+		underBudget = 0;
+		if (++overBudget >= downFrames && level > 0)
+			SetLevel(level - 1, settings);
+	} else if (smoothed < target * headroom) {
+		overBudget = 0;
+		size_t wait = level + 1 == failedLevel ? retryFrames : upFrames;
+		if (++underBudget >= wait && level < NumLevels() - 1)
+			SetLevel(level + 1, settings);
+	} else {
+		overBudget = underBudget = 0;
+	}
+}
+
+void QualityGovernor::PrintStats() const {
+	const FluidQuality &quality = GetLevel(stats.level);
+	std::cout << "quality governor: level " << stats.level + 1 << "/"
+			  << stats.levels << " (scale " << quality.renderScale << ", "
+			  << quality.filterIterations << " filter passes, radius "
+			  << quality.kernelRadius << ", thickness "
+			  << quality.thicknessScale << ") at " << stats.smoothedMs
+			  << " ms for " << stats.targetMs << " ms" << std::endl;
+}
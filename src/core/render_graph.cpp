@@ -0,0 +1,458 @@
+#include "core/render_graph.hpp"
+#include "core/gpu_memory.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace engine;
+
+static size_t BytesPerTexel(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_R8:
+		return 1;
+	case GL_R16F:
+	case GL_RG8:
+		return 2;
+	// drivers pad three-channel formats to four, so RGB16F takes as much
+	// memory as RGBA16F
+	case GL_RGB16F:
+	case GL_RGBA16F:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default: // GL_R32F, GL_RGBA8, GL_RG16, GL_DEPTH_COMPONENT24...
+		return 4;
+	}
+}
+
+size_t TextureDesc::ByteSize() const {
+	return (size_t)width * (size_t)height * BytesPerTexel(internalFormat);
+}
+
+RenderResource RenderGraph::Builder::Read(RenderResource res) {
+	if (res != NullResource)
+		graph.passes[pass].reads.push_back(res);
+	return res;
+}
+
+RenderResource RenderGraph::Builder::Write(RenderResource res) {
+	if (res != NullResource)
+		graph.passes[pass].writes.push_back(res);
+	return res;
+}
+
+RenderResource RenderGraph::Builder::WriteDepth(RenderResource res) {
+	graph.passes[pass].depth = res;
+	return res;
+}
+
+void RenderGraph::Builder::SideEffect() { graph.passes[pass].sideEffect = true; }
+
+RenderGraph::~RenderGraph() {
+	for (const auto &[key, fbo] : framebuffers)
+		glDeleteFramebuffers(1, &fbo);
+	for (auto &tex : pool)
+		GpuMemory::DeleteTexture(tex.id);
+	for (auto &[key, tex] : persistentTextures)
+		GpuMemory::DeleteTexture(tex.id);
+	for (const auto &timers : timerFrames) {
+		if (!timers.queries.empty())
+			glDeleteQueries((GLsizei)timers.queries.size(),
+							timers.queries.data());
+		if (!timers.sampleQueries.empty())
+			glDeleteQueries((GLsizei)timers.sampleQueries.size(),
+							timers.sampleQueries.data());
+	}
+}
+
+RenderResource RenderGraph::CreateTexture(const std::string &name,
+										  const TextureDesc &desc) {
+	Resource res;
+	res.name = name;
+	res.desc = desc;
+	resources.push_back(res);
+	return (RenderResource)resources.size() - 1;
+}
+
+RenderResource RenderGraph::ImportBackbuffer(const std::string &name,
+											 int width, int height) {
+	Resource res;
+	res.name = name;
+	res.desc.width = width;
+	res.desc.height = height;
+	res.imported = true;
+	res.fbo = 0;
+	resources.push_back(res);
+	return (RenderResource)resources.size() - 1;
+}
+
+RenderResource RenderGraph::CreatePersistentTexture(const std::string &key,
+													const TextureDesc &desc,
+													bool *created) {
+	auto it = persistentTextures.find(key);
+	const bool fresh =
+		it == persistentTextures.end() || !(it->second.desc == desc);
+	if (fresh) {
+		if (it != persistentTextures.end()) {
+			DeleteTexture(it->second.id);
+			persistentTextures.erase(it);
+		}
+		it = persistentTextures
+				 .emplace(key, PhysicalTexture{AllocateTexture(desc), desc,
+											   true, frameIndex})
+				 .first;
+	}
+	it->second.lastUsedFrame = frameIndex;
+	if (created != nullptr)
+		*created = fresh;
+
+	Resource res;
+	res.name = key;
+	res.desc = desc;
+	res.persistent = true;
+	res.texture = it->second.id;
+	resources.push_back(res);
+	return (RenderResource)resources.size() - 1;
+}
+
+RenderResource RenderGraph::Find(const std::string &name) const {
+	for (size_t i = resources.size(); i-- > 0;) {
+		if (resources[i].name == name)
+			return (RenderResource)i;
+	}
+	return NullResource;
+}
+
+void RenderGraph::AddPass(const std::string &name, const SetupFn &setup,
+						  const ExecuteFn &execute) {
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	passes.push_back(pass);
+
+	Builder builder(*this, passes.size() - 1);
+	setup(builder);
+	compiled = false;
+}
+
+void RenderGraph::Compile() {
+	// passes run in declaration order, which the read/write declarations
+	// turn into a valid dependency order. walk backwards from the passes that
+	// must run and keep whatever produces a resource they consume.
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = passes.size(); i-- > 0;) {
+		Pass &pass = passes[i];
+		pass.alive = pass.sideEffect;
+
+		auto keeps = [&](RenderResource res) {
+			return resources[res].imported || resources[res].persistent ||
+				   needed[res];
+		};
+		for (RenderResource res : pass.writes)
+			pass.alive = pass.alive || keeps(res);
+		if (pass.depth != NullResource)
+			pass.alive = pass.alive || keeps(pass.depth);
+
+		if (!pass.alive)
+			continue;
+		for (RenderResource res : pass.reads)
+			needed[res] = true;
+	}
+
+	// lifetimes
+	for (auto &res : resources) {
+		res.firstPass = res.lastPass = -1;
+		res.physical = -1;
+	}
+	for (size_t i = 0; i < passes.size(); ++i) {
+		const Pass &pass = passes[i];
+		if (!pass.alive)
+			continue;
+
+		auto touch = [&](RenderResource res) {
+			Resource &r = resources[res];
+			if (r.firstPass < 0)
+				r.firstPass = (int)i;
+			r.lastPass = (int)i;
+		};
+		for (RenderResource res : pass.reads)
+			touch(res);
+		for (RenderResource res : pass.writes)
+			touch(res);
+		if (pass.depth != NullResource)
+			touch(pass.depth);
+	}
+
+	// aliasing: a texture goes back to the free list after its last reader
+	for (auto &tex : pool)
+		tex.inUse = false;
+
+	stats = Stats{};
+	for (size_t i = 0; i < passes.size(); ++i) {
+		if (!passes[i].alive) {
+			stats.culledPasses++;
+			continue;
+		}
+		stats.passes++;
+
+		for (size_t r = 0; r < resources.size(); ++r) {
+			Resource &res = resources[r];
+			if (res.imported || res.persistent || res.firstPass != (int)i)
+				continue;
+			res.physical = AcquireTexture(res.desc);
+			stats.virtualTextures++;
+			stats.virtualBytes += res.desc.ByteSize();
+		}
+		for (auto &res : resources) {
+			if (!res.imported && !res.persistent && res.lastPass == (int)i)
+				pool[res.physical].inUse = false;
+		}
+	}
+
+	for (const auto &tex : pool) {
+		if (tex.lastUsedFrame != frameIndex)
+			continue;
+		stats.physicalTextures++;
+		stats.physicalBytes += tex.desc.ByteSize();
+	}
+	for (const auto &[key, tex] : persistentTextures) {
+		if (tex.lastUsedFrame != frameIndex)
+			continue;
+		stats.persistentTextures++;
+		stats.persistentBytes += tex.desc.ByteSize();
+	}
+
+	ReleaseUnused();
+	compiled = true;
+}
+
+GLuint RenderGraph::AllocateTexture(const TextureDesc &desc) {
+	GLuint id = GpuMemory::CreateTexture(GpuCategory::RenderTarget,
+										 "render graph");
+	glBindTexture(GL_TEXTURE_2D, id);
+	glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width,
+				 desc.height, 0, desc.format, desc.type, nullptr);
+	GpuMemory::SetSize(GpuObject::Texture, id, desc.ByteSize());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return id;
+}
+
+int RenderGraph::AcquireTexture(const TextureDesc &desc) {
+	for (size_t i = 0; i < pool.size(); ++i) {
+		PhysicalTexture &tex = pool[i];
+		if (!tex.inUse && tex.desc == desc) {
+			tex.inUse = true;
+			tex.lastUsedFrame = frameIndex;
+			return (int)i;
+		}
+	}
+
+	pool.push_back({AllocateTexture(desc), desc, true, frameIndex});
+	return (int)pool.size() - 1;
+}
+
+void RenderGraph::DeleteTexture(GLuint texture) {
+	for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+		const auto &key = it->first;
+		if (std::find(key.begin(), key.end(), texture) != key.end()) {
+			glDeleteFramebuffers(1, &it->second);
+			it = framebuffers.erase(it);
+		} else {
+			++it;
+		}
+	}
+	GpuMemory::DeleteTexture(texture);
+}
+
+void RenderGraph::ReleaseUnused() {
+	for (size_t i = pool.size(); i-- > 0;) {
+		PhysicalTexture &tex = pool[i];
+		if (frameIndex - tex.lastUsedFrame < maxIdleFrames)
+			continue;
+
+		DeleteTexture(tex.id);
+
+		// physical indices are only held between Compile and Reset, and
+		// idle textures were not handed out this frame
+		pool.erase(pool.begin() + i);
+		for (auto &res : resources) {
+			if (res.physical > (int)i)
+				res.physical--;
+		}
+	}
+
+	for (auto it = persistentTextures.begin(); it != persistentTextures.end();) {
+		if (frameIndex - it->second.lastUsedFrame < maxIdleFrames) {
+			++it;
+			continue;
+		}
+		DeleteTexture(it->second.id);
+		it = persistentTextures.erase(it);
+	}
+}
+
+GLuint RenderGraph::GetFramebuffer(const Pass &pass) {
+	std::vector<GLuint> key;
+	for (RenderResource res : pass.writes)
+		key.push_back(GetTexture(res));
+	// depth goes last, tagged so it can't collide with a color-only key
+	if (pass.depth != NullResource) {
+		key.push_back(0);
+		key.push_back(GetTexture(pass.depth));
+	}
+
+	auto it = framebuffers.find(key);
+	if (it != framebuffers.end())
+		return it->second;
+
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+	std::vector<GLenum> drawBuffers;
+	for (size_t i = 0; i < pass.writes.size(); ++i) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+							   GL_TEXTURE_2D, GetTexture(pass.writes[i]), 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	if (pass.depth != NullResource) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+							   GL_TEXTURE_2D, GetTexture(pass.depth), 0);
+	}
+
+	if (drawBuffers.empty())
+		glDrawBuffer(GL_NONE);
+	else
+		glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "render graph: incomplete framebuffer for pass '"
+				  << pass.name << "'" << std::endl;
+
+	framebuffers[key] = fbo;
+	return fbo;
+}
+
+void RenderGraph::BindTarget(const Pass &pass) {
+	RenderResource first =
+		pass.writes.empty() ? pass.depth : pass.writes.front();
+	if (first == NullResource)
+		return;
+
+	const Resource &res = resources[first];
+	if (res.imported)
+		glBindFramebuffer(GL_FRAMEBUFFER, res.fbo);
+	else
+		glBindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer(pass));
+	glViewport(0, 0, res.desc.width, res.desc.height);
+}
+
+void RenderGraph::Execute() {
+	if (!compiled)
+		Compile();
+
+	TimerFrame &timers = timerFrames[frameIndex % timerLatency];
+	if (timers.pending)
+		ResolveTimers(timers);
+	timers.used = 0;
+	timers.names.clear();
+	timers.countedSamples = countSamples;
+
+	for (const Pass &pass : passes) {
+		if (!pass.alive)
+			continue;
+
+		if (timers.used == timers.queries.size()) {
+			GLuint query;
+			glGenQueries(1, &query);
+			timers.queries.push_back(query);
+		}
+		if (countSamples && timers.used == timers.sampleQueries.size()) {
+			GLuint query;
+			glGenQueries(1, &query);
+			timers.sampleQueries.push_back(query);
+		}
+		const size_t index = timers.used++;
+		timers.names.push_back(pass.name);
+
+		BindTarget(pass);
+		glBeginQuery(GL_TIME_ELAPSED, timers.queries[index]);
+		if (countSamples)
+			glBeginQuery(GL_SAMPLES_PASSED, timers.sampleQueries[index]);
+		pass.execute();
+		if (countSamples)
+			glEndQuery(GL_SAMPLES_PASSED);
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+	timers.pending = timers.used > 0;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (std::find(printed.begin(), printed.end(), stats) == printed.end()) {
+		PrintStats();
+		printed.push_back(stats);
+		if (printed.size() > printedHistory)
+			printed.pop_front();
+	}
+}
+
+void RenderGraph::ResolveTimers(TimerFrame &frame) {
+	frame.pending = false;
+
+	// queries finish in order, so the last one being ready covers the rest.
+	// if the GPU is still that far behind, drop the frame instead of waiting
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE,
+					   &available);
+	if (available && frame.countedSamples)
+		glGetQueryObjectiv(frame.sampleQueries[frame.used - 1],
+						   GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	passTimes.clear();
+	gpuTime = 0;
+	for (size_t i = 0; i < frame.used; ++i) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+		double ms = ns / 1.0e6;
+		GLuint64 samples = 0;
+		if (frame.countedSamples)
+			glGetQueryObjectui64v(frame.sampleQueries[i], GL_QUERY_RESULT,
+								  &samples);
+		passTimes.push_back({frame.names[i], ms, samples});
+		gpuTime += ms;
+	}
+}
+
+void RenderGraph::Reset() {
+	passes.clear();
+	resources.clear();
+	compiled = false;
+	frameIndex++;
+}
+
+GLuint RenderGraph::GetTexture(RenderResource res) const {
+	if (res == NullResource)
+		return 0;
+	const Resource &r = resources.at(res);
+	if (r.persistent)
+		return r.texture;
+	if (r.imported || r.physical < 0)
+		return 0;
+	return pool[r.physical].id;
+}
+
+void RenderGraph::PrintStats() const {
+	constexpr double mb = 1024.0 * 1024.0;
+	std::cout << "render graph: " << stats.passes << " passes ("
+			  << stats.culledPasses << " culled), " << stats.virtualTextures
+			  << " textures -> " << stats.physicalTextures << " physical ("
+			  << stats.virtualBytes / mb << " MB -> "
+			  << stats.physicalBytes / mb << " MB), "
+			  << stats.persistentTextures << " persistent ("
+			  << stats.persistentBytes / mb << " MB)" << std::endl;
+}
@@ -1,23 +1,16 @@
 #include "core/renderer.hpp"
+#include "core/gpu_memory.hpp"
 #include <iostream>
 
 using namespace engine;
 
 Renderer::Renderer(const cy::Vec2f *windowSize)
-	: dummy2DTexture(0), dummyCubemapTexture(0),
-	  dummyTexturesInitialized(false), windowSize(windowSize) {
+	: dummyTexturesInitialized(false), windowSize(windowSize) {
 	glEnable(GL_DEPTH_TEST);
 	glViewport(0, 0, (int)windowSize->x, (int)windowSize->y);
 	glClearColor(0, 0, 0, 1);
 	InitializeDummyTextures();
 
-	// default framebuffers
-	CreateBuffer("opaque", (int)windowSize->x, (int)windowSize->y,
-				 GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, GL_RGBA8, GL_RGBA,
-				 GL_UNSIGNED_BYTE, true);
-	CreateBuffer("trans", (int)windowSize->x, (int)windowSize->y);
-	CreateBuffer("post", (int)windowSize->x, (int)windowSize->y);
-
 	// quad
 	float quadVertices[] = {
 		-1.0f, 1.0f, 0.0f, 1.0f,  -1.0f, -1.0f,
@@ -27,13 +20,14 @@ Renderer::Renderer(const cy::Vec2f *windowSize)
 		1.0f,  0.0f, 1.0f, 1.0f,  1.0f,	 1.0f,
 	};
 
-	glGenVertexArrays(1, &fullscreenQuadVAO);
-	glBindVertexArray(fullscreenQuadVAO);
+	fullscreenQuadVAO = GLVertexArray::Create();
+	glBindVertexArray(fullscreenQuadVAO.Get());
 
-	glGenBuffers(1, &fullscreenQuadVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, fullscreenQuadVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices,
-				 GL_STATIC_DRAW);
+	fullscreenQuadVBO =
+		GLBuffer::Create(GpuCategory::Geometry, "fullscreen quad");
+	glBindBuffer(GL_ARRAY_BUFFER, fullscreenQuadVBO.Get());
+	GpuMemory::BufferData(GL_ARRAY_BUFFER, fullscreenQuadVBO.Get(),
+						  sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
@@ -46,16 +40,6 @@ Renderer::Renderer(const cy::Vec2f *windowSize)
 	glBindVertexArray(0);
 }
 
-Renderer::~Renderer() {
-	if (dummy2DTexture != 0) {
-		glDeleteTextures(1, &dummy2DTexture);
-	}
-
-	if (dummyCubemapTexture != 0) {
-		glDeleteTextures(1, &dummyCubemapTexture);
-	}
-}
-
 void Renderer::CreateProgram(std::string name, GLSLProgram *prog) {
 	if (programs.count(name)) {
 		std::cout << "'" << name << "' already exists as a program"
@@ -88,7 +72,10 @@ void Renderer::BeginFrame() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void Renderer::EndFrame(GLFWwindow *window) { glfwSwapBuffers(window); }
+void Renderer::EndFrame(GLFWwindow *window) {
+	governor.Update(graph.GetGpuTime(), fluidSettings);
+	glfwSwapBuffers(window);
+}
 
 void Renderer::DrawMesh() {
 	SetUniform("shading", static_cast<int>(shadingType));
@@ -112,27 +99,28 @@ void Renderer::InitializeDummyTextures() {
 	dummyTexturesInitialized = true;
 }
 
-GLuint Renderer::CreateDummyTexture2D() {
-	GLuint textureId;
-	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_2D, textureId);
+GLTexture Renderer::CreateDummyTexture2D() {
+	GLTexture texture =
+		GLTexture::Create(GpuCategory::Texture, "dummy textures");
+	glBindTexture(GL_TEXTURE_2D, texture.Get());
 
 	unsigned char data[] = {0, 0, 0, 255};
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
 				 data);
+	GpuMemory::SetSize(GpuObject::Texture, texture.Get(), sizeof(data));
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	return textureId;
+	return texture;
 }
 
-GLuint Renderer::CreateDummyCubemap() {
-	GLuint textureId;
-	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
+GLTexture Renderer::CreateDummyCubemap() {
+	GLTexture texture =
+		GLTexture::Create(GpuCategory::Texture, "dummy textures");
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture.Get());
 
 	unsigned char data[] = {0, 0, 0, 255};
 
@@ -140,6 +128,7 @@ GLuint Renderer::CreateDummyCubemap() {
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0,
 					 GL_RGBA, GL_UNSIGNED_BYTE, data);
 	}
+	GpuMemory::SetSize(GpuObject::Texture, texture.Get(), 6 * sizeof(data));
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -147,7 +136,7 @@ GLuint Renderer::CreateDummyCubemap() {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-	return textureId;
+	return texture;
 }
 
 void Renderer::CollectSamplerUniforms(GLuint programId) {
@@ -203,19 +192,16 @@ void Renderer::SetDummyTextures() {
 		glActiveTexture(GL_TEXTURE0 + sampler.textureUnit);
 
 		if (sampler.type == GL_SAMPLER_2D) {
-			glBindTexture(GL_TEXTURE_2D, dummy2DTexture);
+			glBindTexture(GL_TEXTURE_2D, dummy2DTexture.Get());
 		} else if (sampler.type == GL_SAMPLER_CUBE) {
-			glBindTexture(GL_TEXTURE_CUBE_MAP, dummyCubemapTexture);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, dummyCubemapTexture.Get());
 		}
 
 		glUniform1i(sampler.location, sampler.textureUnit);
 	}
 }
 
-void Renderer::Composite() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, (int)windowSize->x, (int)windowSize->y);
-
+void Renderer::Composite(GLuint scene, GLuint trans, GLuint post) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glEnable(GL_BLEND);
@@ -223,9 +209,11 @@ void Renderer::Composite() {
 
 	this->BindProgram("_composite");
 
-	this->BindTexture("uScene", framebuffers["opaque"].texture, GL_TEXTURE0);
-	this->BindTexture("uTrans", framebuffers["trans"].texture, GL_TEXTURE1);
-	this->BindTexture("uPost", framebuffers["post"].texture, GL_TEXTURE2);
+	this->BindTexture("uScene", scene, GL_TEXTURE0);
+	this->BindTexture("uTrans", trans != 0 ? trans : dummy2DTexture.Get(),
+					  GL_TEXTURE1);
+	this->BindTexture("uPost", post, GL_TEXTURE2);
+	this->SetUniform("uHasTrans", trans != 0);
 
 	DrawFullscreenQuad();
 
@@ -1,8 +1,12 @@
 #include "core/scene.hpp"
 #include "core/renderer.hpp"
 #include "core/scene_object.hpp"
+#include "core/fluid_pipeline.hpp"
 #include "objects/camera.hpp"
+#include "objects/fluid.hpp"
 #include "objects/skybox.hpp"
+#include <algorithm>
+#include <functional>
 
 Scene::Scene() {}
 Scene::~Scene() = default;
@@ -27,14 +31,36 @@ void Scene::RemoveObject(SceneObject *object) {
 		objects_.end());
 }
 
+bool Scene::Prefetch(size_t &budget) {
+	bool resident = true;
+	for (const auto &object : objects_) {
+		if (auto *fluid = dynamic_cast<FluidObject *>(object.get()))
+			resident = fluid->GetData()->Prefetch(budget) && resident;
+	}
+	return resident;
+}
+
+void Scene::MakeResident() {
+	for (const auto &object : objects_) {
+		if (auto *fluid = dynamic_cast<FluidObject *>(object.get()))
+			fluid->GetData()->MakeResident();
+	}
+}
+
+void Scene::Evict() {
+	for (const auto &object : objects_) {
+		if (auto *fluid = dynamic_cast<FluidObject *>(object.get()))
+			fluid->GetData()->Evict();
+	}
+}
+
 void Scene::Update(float deltaTime) {
 	for (const auto &object : objects_) {
 		object->Update(deltaTime);
 	}
 }
 
-void RenderObjects(Scene *scene, Renderer &renderer,
-				   std::vector<SceneObject *> objects) {
+void BindDefaultProgram(Scene *scene, Renderer &renderer) {
 	renderer.BindProgram("default");
 	engine::CameraObject *camera = scene->GetActiveCamera();
 	renderer.SetView(camera->GetView());
@@ -42,6 +68,11 @@ void RenderObjects(Scene *scene, Renderer &renderer,
 
 	renderer.SetShadingType(ShadingType::BlinnPhong);
 	renderer.SetShaderUniforms(scene->GetSunPosition(), camera->GetPosition());
+}
+
+void RenderObjects(Scene *scene, Renderer &renderer,
+				   std::vector<SceneObject *> objects) {
+	BindDefaultProgram(scene, renderer);
 
 	for (const auto &object : objects) {
 		renderer.BindProgram("default");
@@ -50,23 +81,49 @@ void RenderObjects(Scene *scene, Renderer &renderer,
 	}
 }
 
-void Scene::RenderOpaque(Renderer &renderer, std::vector<SceneObject *> objects,
-						 std::string buffer) {
-	renderer.BindBuffer(buffer);
-	RenderObjects(this, renderer, objects);
+std::vector<SceneObject *>
+Scene::GatherOpaque(Renderer &renderer,
+					const std::vector<SceneObject *> &objects) {
+	// order doesn't matter for opaque objects, so whatever can be sorted and
+	// instanced goes through the draw list
+	DrawList &drawList = renderer.GetDrawList();
+	drawList.Clear();
+
+	std::vector<SceneObject *> immediate = {};
+	for (SceneObject *object : objects) {
+		if (!object->SubmitDraws(drawList))
+			immediate.push_back(object);
+	}
+
+	// objects drawing themselves only count by where they are
+	opaqueVersion = drawList.Hash();
+	for (SceneObject *object : immediate) {
+		const Matrix4f model = Matrix4f::Translation(object->GetPosition()) *
+							   object->GetRotation().ToMatrix4() *
+							   Matrix4f::Scale(object->GetSize());
+		opaqueVersion ^= std::hash<const void *>()(object);
+		for (float value : model.cell)
+			opaqueVersion =
+				opaqueVersion * 1099511628211ull ^ std::hash<float>()(value);
+	}
+	opaqueVersion ^= std::hash<const void *>()(activeSkybox);
+	return immediate;
+}
+
+void Scene::RenderOpaque(Renderer &renderer,
+						 std::vector<SceneObject *> immediate) {
+	BindDefaultProgram(this, renderer);
+	renderer.GetDrawList().Submit(renderer);
+	RenderObjects(this, renderer, immediate);
 }
 void Scene::RenderTransparent(Renderer &renderer,
-							  std::vector<SceneObject *> objects,
-							  std::string buffer) {
-	renderer.BindBuffer(buffer);
+							  std::vector<SceneObject *> objects) {
 	glEnable(GL_BLEND);
 	RenderObjects(this, renderer, objects);
 }
-void Scene::RenderPost(Renderer &renderer, std::vector<SceneObject *> objects,
-					   std::string buffer) {
-	renderer.BindBuffer(buffer);
+void Scene::RenderPost(Renderer &renderer,
+					   std::vector<SceneObject *> objects) {
 	glEnable(GL_BLEND);
-	renderer.BeginFrame();
 	RenderObjects(this, renderer, objects);
 }
 
@@ -94,21 +151,109 @@ void Scene::Render(Renderer &renderer) {
 		}
 	}
 
-	renderer.BindBuffer("opaque");
-	renderer.BeginFrame();
+	RenderGraph &graph = renderer.GetGraph();
+	graph.Reset();
+	graph.SetSampleCounting(renderer.GetFluidSettings().overdrawView !=
+							OverdrawView::Off);
 
-	renderer.BindProgram("default");
-	engine::CameraObject *camera = GetActiveCamera();
-	renderer.SetView(camera->GetView());
-	renderer.SetProjection(camera->GetProjection());
+	const int width = renderer.GetWidth(), height = renderer.GetHeight();
+	TextureDesc colorDesc;
+	colorDesc.width = width;
+	colorDesc.height = height;
+	TextureDesc depthDesc = colorDesc;
+	depthDesc.internalFormat = GL_DEPTH_COMPONENT24;
+	depthDesc.format = GL_DEPTH_COMPONENT;
+	depthDesc.type = GL_FLOAT;
 
-	renderer.SetShadingType(ShadingType::BlinnPhong);
-	renderer.SetShaderUniforms(GetSunPosition(), camera->GetPosition());
-	activeSkybox->Render(renderer, this);
+	// gathered while declaring, so the fluid passes can tell whether the
+	// opaque layer they are clipped against changed
+	std::vector<SceneObject *> immediateOpaque =
+		GatherOpaque(renderer, opaqueObjects);
+
+	RenderResource opaque = graph.CreateTexture("opaque", colorDesc);
+	RenderResource opaqueDepth = graph.CreateTexture("opaqueDepth", depthDesc);
+	RenderResource trans = graph.CreateTexture("trans", colorDesc);
+	RenderResource post = graph.CreateTexture("post", colorDesc);
+	RenderResource backbuffer =
+		graph.ImportBackbuffer("backbuffer", width, height);
+
+	graph.AddPass(
+		"opaque",
+		[&](RenderGraph::Builder &builder) {
+			builder.Write(opaque);
+			builder.WriteDepth(opaqueDepth);
+		},
+		[&]() {
+			renderer.BeginFrame();
+
+			renderer.BindProgram("default");
+			engine::CameraObject *camera = GetActiveCamera();
+			renderer.SetView(camera->GetView());
+			renderer.SetProjection(camera->GetProjection());
+
+			renderer.SetShadingType(ShadingType::BlinnPhong);
+			renderer.SetShaderUniforms(GetSunPosition(), camera->GetPosition());
+			activeSkybox->Render(renderer, this);
+
+			RenderOpaque(renderer, immediateOpaque);
+		});
+
+	// only fluid splats are culled against the opaque depth
+	const FluidSettings &fluidSettings = renderer.GetFluidSettings();
+	const bool hasFluid =
+		std::any_of(postObjects.begin(), postObjects.end(),
+					[](SceneObject *object) {
+						return dynamic_cast<FluidObject *>(object) != nullptr;
+					});
+	if (hasFluid && fluidSettings.occludeSplats &&
+		fluidSettings.occlusionCulling) {
+		CameraObject *camera = GetActiveCamera();
+		hiZCuller.AddPasses(graph, renderer, opaqueDepth,
+							camera->GetProjection(), camera->GetView());
+	}
+
+	graph.AddPass(
+		"trans",
+		[&](RenderGraph::Builder &builder) { builder.Write(trans); },
+		[&]() {
+			renderer.BeginFrame();
+			RenderTransparent(renderer, transObjects);
+		});
+
+	graph.AddPass(
+		"post", [&](RenderGraph::Builder &builder) { builder.Write(post); },
+		[&]() {
+			renderer.BeginFrame();
+			RenderPost(renderer, postObjects);
+		});
+	std::vector<FluidSplat> fluidSplats;
+	for (SceneObject *object : postObjects) {
+		FluidObject *fluid = dynamic_cast<FluidObject *>(object);
+		if (batchFluids && fluid != nullptr)
+			fluidSplats.push_back(fluid->GetSplat());
+		else
+			object->AddRenderPasses(graph, renderer, this);
+	}
+	fluidPipeline.AddPasses(graph, renderer, this, fluidSplats);
 
-	RenderOpaque(renderer, opaqueObjects);
-	RenderTransparent(renderer, transObjects);
-	RenderPost(renderer, postObjects);
+	// nothing is drawn into the transparent layer without objects, so the
+	// composite doesn't read it and its pass gets culled
+	const bool hasTrans = !transObjects.empty();
+	graph.AddPass(
+		"composite",
+		[&](RenderGraph::Builder &builder) {
+			builder.Read(opaque);
+			builder.Read(post);
+			if (hasTrans)
+				builder.Read(trans);
+			builder.Write(backbuffer);
+		},
+		[&]() {
+			renderer.Composite(graph.GetTexture(opaque),
+							   hasTrans ? graph.GetTexture(trans) : 0,
+							   graph.GetTexture(post));
+		});
 
-	renderer.Composite();
+	graph.Compile();
+	graph.Execute();
 }
@@ -0,0 +1,35 @@
+#include "core/scene_residency.hpp"
+#include "core/gpu_memory.hpp"
+#include "core/scene.hpp"
+#include <iostream>
+
+using namespace engine;
+
+SceneResidency::SceneResidency(const std::vector<Scene *> &scenes,
+							   size_t uploadBudget)
+	: scenes(scenes), uploadBudget(uploadBudget) {}
+
+void SceneResidency::Update(Scene *active, Scene *next) {
+	if (active != this->active || next != this->next) {
+		this->active = active;
+		this->next = next;
+		nextResident = false;
+		for (Scene *scene : scenes) {
+			if (scene != active && scene != next)
+				scene->Evict();
+		}
+	}
+
+	active->MakeResident();
+	if (next == nullptr || next == active || nextResident)
+		return;
+
+	size_t budget = uploadBudget;
+	nextResident = next->Prefetch(budget);
+	if (nextResident) {
+		constexpr double mb = 1024.0 * 1024.0;
+		std::cout << "prefetched next scene, "
+				  << GpuMemory::GetStats(GpuCategory::Points).bytes / mb
+				  << " MB of points resident" << std::endl;
+	}
+}
@@ -0,0 +1,95 @@
+#include "core/stream_buffer.hpp"
+
+using namespace engine;
+
+StreamBuffer::StreamBuffer(size_t elementSize, const std::string &owner)
+	: elementSize(elementSize), owner(owner) {}
+
+void StreamBuffer::Allocate(size_t count) {
+	Reset();
+	// room to grow a little before the next reallocation
+	capacity = count + count / 2 + 1024;
+	const size_t bytes = regions * capacity * elementSize;
+
+	buffer = GLBuffer::Create(GpuCategory::Points, owner);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+	persistent = GLEW_ARB_buffer_storage;
+	if (persistent) {
+		const GLbitfield flags =
+			GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+		GpuMemory::SetSize(GpuObject::Buffer, buffer.Get(), bytes);
+		mapped = static_cast<char *>(
+			glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+		// storage without a mapping is no use, fall back to mapping ranges
+		persistent = mapped != nullptr;
+	} else {
+		GpuMemory::BufferData(GL_ARRAY_BUFFER, buffer.Get(), bytes, nullptr,
+							  GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// the first write lands in region 0
+	region = regions - 1;
+}
+
+void *StreamBuffer::BeginWrite(size_t count) {
+	if (!buffer || count > capacity) {
+		Allocate(count);
+	} else {
+		// every draw reading the current region was issued before this
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	region = (region + 1) % regions;
+
+	if (fences[region] != 0) {
+		GLenum status = glClientWaitSync(fences[region], 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			stalls++;
+			constexpr GLuint64 second = 1000000000;
+			while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT,
+									second) == GL_TIMEOUT_EXPIRED)
+				;
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+
+	const size_t offset = region * capacity * elementSize;
+	if (persistent)
+		return mapped + offset;
+
+	// the fence already kept the GPU off this range
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+	mapped = static_cast<char *>(glMapBufferRange(
+		GL_ARRAY_BUFFER, offset, capacity * elementSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+			GL_MAP_UNSYNCHRONIZED_BIT));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return mapped;
+}
+
+void StreamBuffer::EndWrite() {
+	// coherent writes are visible to commands issued after them
+	if (persistent || mapped == nullptr)
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	mapped = nullptr;
+}
+
+void StreamBuffer::Reset() {
+	for (GLsync &fence : fences) {
+		if (fence != 0)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+	if (buffer && mapped != nullptr) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.Get());
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	mapped = nullptr;
+	buffer.Reset();
+	capacity = 0;
+}
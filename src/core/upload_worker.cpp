@@ -0,0 +1,114 @@
+#include "core/upload_worker.hpp"
+#include <iostream>
+
+using namespace engine;
+
+UploadWorker *UploadWorker::instance = nullptr;
+
+UploadTicket::State::~State() {
+	// sync objects are shared, either context may delete it
+	if (fence != 0)
+		glDeleteSync(fence);
+}
+
+bool UploadTicket::IsReady() const {
+	if (!state)
+		return true;
+	GLsync fence;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (!state->submitted)
+			return false;
+		fence = state->fence;
+	}
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+void UploadTicket::Wait() const {
+	if (!state)
+		return;
+	GLsync fence;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->done.wait(lock, [&]() { return state->submitted; });
+		fence = state->fence;
+	}
+	// the worker flushed after the fence, so this can't wait forever
+	constexpr GLuint64 second = 1000000000;
+	while (glClientWaitSync(fence, 0, second) == GL_TIMEOUT_EXPIRED)
+		;
+}
+
+UploadWorker::UploadWorker(GLFWwindow *share) {
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	context = glfwCreateWindow(1, 1, "upload", nullptr, share);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (context == nullptr) {
+		std::cerr << "no shared context, uploading on the render thread"
+				  << std::endl;
+		return;
+	}
+
+	thread = std::thread(&UploadWorker::Run, this);
+	instance = this;
+}
+
+UploadWorker::~UploadWorker() {
+	if (instance == this)
+		instance = nullptr;
+	if (context == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+	glfwDestroyWindow(context);
+}
+
+UploadWorker *UploadWorker::Get() { return instance; }
+
+UploadTicket UploadWorker::Submit(Job job) {
+	UploadTicket ticket;
+	ticket.state = std::make_shared<UploadTicket::State>();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.emplace_back(std::move(job), ticket.state);
+	}
+	wake.notify_one();
+	return ticket;
+}
+
+void UploadWorker::Run() {
+	glfwMakeContextCurrent(context);
+
+	while (true) {
+		std::pair<Job, std::shared_ptr<UploadTicket::State>> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				break;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job.first();
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// the render thread can only see the fence signal once it's flushed
+		glFlush();
+
+		UploadTicket::State &state = *job.second;
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.fence = fence;
+			state.submitted = true;
+		}
+		state.done.notify_all();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
@@ -1,12 +1,16 @@
 #include "common/typedefs.hpp"
 #include "components/fluid_simulation.hpp"
+#include "core/gpu_memory.hpp"
 #include "core/renderer.hpp"
 #include "core/scene.hpp"
 #include "core/scene_object.hpp"
+#include "core/scene_residency.hpp"
+#include "core/upload_worker.hpp"
 #include "objects/camera.hpp"
 #include "objects/fluid.hpp"
 #include "objects/mesh.hpp"
 #include "objects/skybox.hpp"
+#include "sim/sph_simd.hpp"
 #include <future>
 #include <memory>
 #include <unordered_map>
@@ -27,6 +31,66 @@ static int sceneIndex = 0;
 static engine::Scene *currentScene = nullptr;
 
 static bool paused = false;
+static engine::FluidSettings *fluidSettings = nullptr;
+static engine::PointOrder pointOrder = engine::PointOrder::MortonLod;
+/*
+Live Simulation:
+	None - cached scenes only
+	Wcsph - weakly compressible SPH, small fixed steps
+	Pbf - position based fluids, large steps
+*/
+enum class LiveSimulation {
+	None,
+	Wcsph,
+	Pbf,
+};
+// --sim wcsph|pbf: start on a live simulation scene before the cached ones
+static LiveSimulation liveSimulation = LiveSimulation::None;
+static engine::PbfSettings pbfSettings;
+// --record <path.abc>: records the live simulation into a point cache,
+// until C is pressed or the scene is left
+static std::string recordPath;
+// --max-substeps <n>: cap on adaptive sim steps per frame, 0 steps at the
+// solver's fixed step
+static int maxSubsteps = 32;
+
+/**
+	--bench-splat <frames>: averages the GPU time of the fluid depth and
+	thickness passes over a run of frames and exits. Run once per
+	--point-order to compare orderings.
+*/
+struct SplatBenchmark {
+	size_t remaining = 0, samples = 0;
+	double depthMs = 0, thicknessMs = 0;
+
+	inline bool Active() const { return remaining > 0; }
+
+	/** Returns true on the last frame, after printing the averages */
+	bool Record(const engine::RenderGraph &graph) {
+		bool measured = false;
+		for (const auto &pass : graph.GetPassTimes()) {
+			if (pass.name == "fluidDepth")
+				depthMs += pass.ms;
+			else if (pass.name == "fluidThickness")
+				thicknessMs += pass.ms;
+			else
+				continue;
+			measured = true;
+		}
+		if (measured)
+			samples++;
+		if (--remaining > 0)
+			return false;
+
+		double n = std::max<size_t>(samples, 1);
+		std::cout << "splat benchmark (" << engine::pointOrderName(pointOrder)
+				  << " order, " << samples << " frames): depth "
+				  << depthMs / n << " ms, thickness " << thicknessMs / n
+				  << " ms" << std::endl;
+		return true;
+	}
+};
+static SplatBenchmark splatBenchmark;
 
 static void keyCallback(GLFWwindow *window, int key, int scancode, int action,
 						int mods) {
@@ -50,6 +114,21 @@ static void keyCallback(GLFWwindow *window, int key, int scancode, int action,
 			sceneIndex--;
 		else if (key == GLFW_KEY_SPACE)
 			paused = !paused;
+		else if (key == GLFW_KEY_B)
+			currentScene->SetFluidBatching(!currentScene->GetFluidBatching());
+		else if (key == GLFW_KEY_F && fluidSettings != nullptr)
+			fluidSettings->compactFormats = !fluidSettings->compactFormats;
+		else if (key == GLFW_KEY_E && fluidSettings != nullptr)
+			fluidSettings->reportFormatError = true;
+		else if (key == GLFW_KEY_Q && fluidSettings != nullptr)
+			fluidSettings->adaptiveQuality = !fluidSettings->adaptiveQuality;
+		else if (key == GLFW_KEY_M)
+			engine::GpuMemory::PrintReport();
+		else if (key == GLFW_KEY_C)
+			fluid->StopRecording();
+		else if (key == GLFW_KEY_O && fluidSettings != nullptr)
+			fluidSettings->overdrawView = (engine::OverdrawView)(
+				((int)fluidSettings->overdrawView + 1) % 3);
 	}
 }
 
@@ -147,7 +226,7 @@ engine::Scene *sceneOne(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene1");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -161,7 +240,7 @@ engine::Scene *sceneTwo(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene2");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -177,7 +256,7 @@ engine::Scene *sceneThree(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene3");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -193,7 +272,7 @@ engine::Scene *sceneFour(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene4");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -207,7 +286,7 @@ engine::Scene *sceneFive(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene5");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -221,7 +300,7 @@ engine::Scene *sceneSix(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene6");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -235,7 +314,7 @@ engine::Scene *sceneSeven(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene7");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -249,7 +328,7 @@ engine::Scene *sceneEight(const CacheMap &cache) {
 	const auto &[frameData, nPoints, nFrames] = cache.at("scene8");
 
 	engine::FluidObject *object = new engine::FluidObject();
-	object->fromFrameData(frameData, nPoints, nFrames);
+	object->fromFrameData(frameData, nPoints, nFrames, pointOrder);
 	object->SetPosition({0, -30, 0});
 	object->SetSize({20, 20, 20});
 	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
@@ -259,6 +338,34 @@ engine::Scene *sceneEight(const CacheMap &cache) {
 	return scene;
 }
 
+engine::Scene *sceneSimulation() {
+	engine::Scene *scene = makeDefaultScene();
+
+	// the unit domain, scaled so its floor sits on the ground plane
+	engine::FluidObject *object = new engine::FluidObject();
+	if (liveSimulation == LiveSimulation::Pbf)
+		object->fromSimulation(pbfSettings);
+	else
+		object->fromSimulation(engine::WcsphSettings());
+	object->SetPosition({-20, -22, -20});
+	object->SetSize({40, 40, 40});
+	scene->AddObject("fluid", std::unique_ptr<engine::SceneObject>(object));
+
+	// a pillar in the dam break's way
+	engine::MeshObject *pillar = new engine::MeshObject(Vec3f(8, 14, 8));
+	pillar->SetPosition({8, -15, 4});
+	pillar->SetMeshColor({.6, .4, .3});
+	scene->AddObject(std::unique_ptr<engine::SceneObject>(pillar));
+	object->AddColliders(*scene);
+	if (!recordPath.empty())
+		object->Record(recordPath);
+	if (auto *simulation = dynamic_cast<engine::FluidSimulationComponent *>(
+			object->GetData()))
+		simulation->SetAdaptiveStepping(maxSubsteps > 0, maxSubsteps);
+
+	return scene;
+}
+
 std::vector<engine::Scene *> makeScenes() {
 
 	const std::unordered_map<std::string, std::string> usedCaches = {
@@ -303,7 +410,7 @@ std::vector<engine::Scene *> makeScenes() {
 				size_t nPoints = 0, nFrames = 0;
 				auto frameData =
 					BakedPointDataComponent::createFrameDataFromPath(
-						path, nPoints, nFrames);
+						path, nPoints, nFrames, pointOrder);
 				if (!frameData)
 					throw std::runtime_error("failed to load " + path);
 				return {name, {std::move(*frameData), nPoints, nFrames}};
@@ -318,6 +425,8 @@ std::vector<engine::Scene *> makeScenes() {
 	std::cout << "loaded all!" << std::endl;
 
 	std::vector<engine::Scene *> scenes;
+	if (liveSimulation != LiveSimulation::None)
+		scenes.push_back(sceneSimulation());
 	for (auto &fn : sceneGenerators) {
 		engine::Scene *scene = fn(loadedCaches);
 		scenes.push_back(scene);
@@ -354,107 +463,185 @@ int main(int argc, char **argv) {
 	glfwGetFramebufferSize(window, &width, &height);
 	windowSize = {(float)width, (float)height};
 
-	//
-	engine::Renderer renderer = engine::Renderer(&windowSize);
-
-	// renderer setup
-	GLSLProgram prog;
-	prog.BuildFiles("assets/shaders/shader.vert",
-					"assets/shaders/shading.frag");
-	renderer.CreateProgram("default", &prog);
-	renderer.GetProgram("default");
-
-	// composite shader
-	GLSLProgram compositeProg;
-	compositeProg.BuildFiles("assets/shaders/quad.vert",
-							 "assets/shaders/composite.frag");
-	renderer.CreateProgram("_composite", &compositeProg);
-
-	// WATER
-	GLSLProgram waterDepthProgram;
-	waterDepthProgram.BuildFiles("assets/shaders/depth_pass.vert",
-								 "assets/shaders/depth_pass.frag");
-	renderer.CreateProgram("waterDepth", &waterDepthProgram);
-	GLSLProgram narrowFilterProgram;
-	narrowFilterProgram.BuildFiles("assets/shaders/quad.vert",
-								   "assets/shaders/narrow_filter.frag");
-	renderer.CreateProgram("narrowFilter", &narrowFilterProgram);
-	GLSLProgram debugDisplayProgram;
-	debugDisplayProgram.BuildFiles("assets/shaders/quad.vert",
-								   "assets/shaders/debug_display.frag");
-	renderer.CreateProgram("debugDisplay", &debugDisplayProgram);
-	GLSLProgram normalReconstructionProgram;
-	normalReconstructionProgram.BuildFiles(
-		"assets/shaders/quad.vert",
-		"assets/shaders/normal_reconstruction.frag");
-	renderer.CreateProgram("normalReconstruction",
-						   &normalReconstructionProgram);
-	GLSLProgram fluidProgram;
-	fluidProgram.BuildFiles("assets/shaders/quad.vert",
+	{
+		// checked once the block below has deleted everything, while the
+		// context is still current
+		engine::GpuMemory::LeakCheck leakCheck;
+		{
+			engine::Renderer renderer = engine::Renderer(&windowSize);
+			fluidSettings = &renderer.GetFluidSettings();
+
+			// --frame-budget <ms>: GPU time the quality governor aims for
+			// --point-order original|morton|lod: order of each frame's points
+			// --sim wcsph|pbf: prepend a live simulation scene
+			// --pbf-iterations <n>: density constraint projections per PBF step
+			// --simd scalar|avx2|avx512: cap the solver kernels' instruction
+			// set
+			// --record <path.abc>: record the live simulation
+			// --max-substeps <n>: cap adaptive sim steps per frame, 0 for fixed
+			for (int i = 1; i + 1 < argc; ++i) {
+				std::string arg = argv[i];
+				if (arg == "--frame-budget")
+					fluidSettings->targetFrameMs = std::stof(argv[++i]);
+				else if (arg == "--point-order" &&
+						 !engine::parsePointOrder(argv[++i], pointOrder))
+					std::cerr << "unknown point order: " << argv[i]
+							  << std::endl;
+				else if (arg == "--bench-splat")
+					splatBenchmark.remaining = std::stoul(argv[++i]);
+				else if (arg == "--sim") {
+					std::string solver = argv[++i];
+					if (solver == "wcsph")
+						liveSimulation = LiveSimulation::Wcsph;
+					else if (solver == "pbf")
+						liveSimulation = LiveSimulation::Pbf;
+					else
+						std::cerr << "unknown solver: " << solver << std::endl;
+				} else if (arg == "--pbf-iterations")
+					pbfSettings.iterations = std::stoi(argv[++i]);
+				else if (arg == "--record")
+					recordPath = argv[++i];
+				else if (arg == "--max-substeps")
+					maxSubsteps = std::stoi(argv[++i]);
+				else if (arg == "--simd") {
+					engine::SimdLevel level;
+					if (engine::parseSimdLevel(argv[++i], level))
+						engine::setSimdLevel(level);
+					else
+						std::cerr << "unknown simd level: " << argv[i]
+								  << std::endl;
+				}
+			}
+			if (splatBenchmark.Active()) {
+				// every frame splats the same number of points
+				fluidSettings->reuseUnchanged = false;
+				fluidSettings->adaptiveQuality = false;
+				fluidSettings->particleLod = false;
+			}
+
+			// renderer setup
+			GLSLProgram prog;
+			prog.BuildFiles("assets/shaders/shader.vert",
 							"assets/shaders/shading.frag");
-	renderer.CreateProgram("fluidProgram", &fluidProgram);
-	GLSLProgram thicknessProgram;
-	thicknessProgram.BuildFiles("assets/shaders/depth_pass.vert",
-								"assets/shaders/thickness.frag");
-	renderer.CreateProgram("thicknessMap", &thicknessProgram);
-
-	// scenes
-
-	auto programScenes = makeScenes();
-	currentScene = programScenes.at(sceneIndex);
-
-	glEnable(GL_PROGRAM_POINT_SIZE);
-
-	double lastTimeFrame = glfwGetTime();
-	while (!glfwWindowShouldClose(window)) {
-		double currentTimeFrame = glfwGetTime();
-		double dt = currentTimeFrame - lastTimeFrame;
-		lastTimeFrame = currentTimeFrame;
-
-		renderer.BeginFrame();
-
-		if (isMouse1Pressed)
-			accumulatedDrag += getMouseDelta(window) * 0.3;
-		if (isMouse2Pressed)
-			accumulatedZoom += getMouseDelta(window).y * 0.2;
-		float theta = deg2rad(accumulatedDrag.x);
-		float phi = deg2rad(accumulatedDrag.y);
-		float radius = accumulatedZoom + 30;
-		cy::Vec3f cameraPos =
-			cy::Vec3f{radius * cos(phi) * sin(theta), radius * sin(phi),
-					  radius * cos(phi) * cos(theta)};
-
-		// scene handling
-		SceneObject *fluidObject = currentScene->GetObject("fluid");
-		FluidObject *fluid = nullptr;
-		if (fluidObject != nullptr)
-			fluid = dynamic_cast<FluidObject *>(fluidObject);
-
-		if (fluid != nullptr && fluid->IsFinished())
-			sceneIndex++;
-
-		if (sceneIndex > programScenes.size() - 1)
-			sceneIndex = 0;
-		// if (sceneIndex < 0)
-		// 	sceneIndex = programScenes.size() - 1;
-
-		if (programScenes.at(sceneIndex) != currentScene) {
-			if (fluid != nullptr)
-				fluid->Reset();
-
+			renderer.CreateProgram("default", &prog);
+			renderer.GetProgram("default");
+
+			// composite shader
+			GLSLProgram compositeProg;
+			compositeProg.BuildFiles("assets/shaders/quad.vert",
+									 "assets/shaders/composite.frag");
+			renderer.CreateProgram("_composite", &compositeProg);
+
+			// WATER
+			GLSLProgram waterDepthProgram;
+			waterDepthProgram.BuildFiles("assets/shaders/depth_pass.vert",
+										 "assets/shaders/depth_pass.frag");
+			renderer.CreateProgram("waterDepth", &waterDepthProgram);
+			GLSLProgram narrowFilterProgram;
+			narrowFilterProgram.BuildFiles("assets/shaders/quad.vert",
+										   "assets/shaders/narrow_filter.frag");
+			renderer.CreateProgram("narrowFilter", &narrowFilterProgram);
+			GLSLProgram depthCopyProgram;
+			depthCopyProgram.BuildFiles("assets/shaders/quad.vert",
+										"assets/shaders/depth_copy.frag");
+			renderer.CreateProgram("depthCopy", &depthCopyProgram);
+			GLSLProgram hiZProgram;
+			hiZProgram.BuildFiles("assets/shaders/quad.vert",
+								  "assets/shaders/hiz_downsample.frag");
+			renderer.CreateProgram("hiZ", &hiZProgram);
+			GLSLProgram debugDisplayProgram;
+			debugDisplayProgram.BuildFiles("assets/shaders/quad.vert",
+										   "assets/shaders/debug_display.frag");
+			renderer.CreateProgram("debugDisplay", &debugDisplayProgram);
+			GLSLProgram fluidProgram;
+			fluidProgram.BuildFiles("assets/shaders/quad.vert",
+									"assets/shaders/shading.frag");
+			renderer.CreateProgram("fluidProgram", &fluidProgram);
+			GLSLProgram thicknessProgram;
+			thicknessProgram.BuildFiles("assets/shaders/depth_pass.vert",
+										"assets/shaders/thickness.frag");
+			renderer.CreateProgram("thicknessMap", &thicknessProgram);
+
+			// scenes
+
+			// buffer uploads from scene building and prefetching run here,
+			// off the render thread
+			auto uploadWorker = std::make_unique<engine::UploadWorker>(window);
+
+			auto programScenes = makeScenes();
 			currentScene = programScenes.at(sceneIndex);
-			std::cout << "moving to scene #" << sceneIndex << std::endl;
+			// scenes are built without uploading, only the current and the next
+			// one are kept on the GPU
+			engine::SceneResidency residency(programScenes);
+
+			glEnable(GL_PROGRAM_POINT_SIZE);
+
+			double lastTimeFrame = glfwGetTime();
+			while (!glfwWindowShouldClose(window)) {
+				double currentTimeFrame = glfwGetTime();
+				double dt = currentTimeFrame - lastTimeFrame;
+				lastTimeFrame = currentTimeFrame;
+
+				renderer.BeginFrame();
+
+				if (isMouse1Pressed)
+					accumulatedDrag += getMouseDelta(window) * 0.3;
+				if (isMouse2Pressed)
+					accumulatedZoom += getMouseDelta(window).y * 0.2;
+				float theta = deg2rad(accumulatedDrag.x);
+				float phi = deg2rad(accumulatedDrag.y);
+				float radius = accumulatedZoom + 30;
+				cy::Vec3f cameraPos =
+					cy::Vec3f{radius * cos(phi) * sin(theta), radius * sin(phi),
+							  radius * cos(phi) * cos(theta)};
+
+				// scene handling
+				SceneObject *fluidObject = currentScene->GetObject("fluid");
+				FluidObject *fluid = nullptr;
+				if (fluidObject != nullptr)
+					fluid = dynamic_cast<FluidObject *>(fluidObject);
+
+				if (fluid != nullptr && fluid->IsFinished())
+					sceneIndex++;
+
+				if (sceneIndex > programScenes.size() - 1)
+					sceneIndex = 0;
+				// if (sceneIndex < 0)
+				// 	sceneIndex = programScenes.size() - 1;
+
+				if (programScenes.at(sceneIndex) != currentScene) {
+					if (fluid != nullptr)
+						fluid->Reset();
+
+					currentScene = programScenes.at(sceneIndex);
+					std::cout << "moving to scene #" << sceneIndex << std::endl;
+				}
+
+				//
+
+				residency.Update(currentScene,
+								 programScenes.at((sceneIndex + 1) %
+												  programScenes.size()));
+
+				currentScene->GetActiveCamera()->SetPosition(cameraPos);
+				if (!paused)
+					currentScene->Update(dt);
+				currentScene->Render(renderer);
+
+				renderer.EndFrame(window);
+				glfwPollEvents();
+
+				if (splatBenchmark.Active() &&
+					splatBenchmark.Record(renderer.GetGraph()))
+					glfwSetWindowShouldClose(window, GLFW_TRUE);
+			}
+
+			engine::GpuMemory::PrintReport();
+			currentScene = nullptr;
+			for (engine::Scene *scene : programScenes)
+				delete scene;
+			uploadWorker.reset();
 		}
-
-		//
-
-		currentScene->GetActiveCamera()->SetPosition(cameraPos);
-		if (!paused)
-			currentScene->Update(dt);
-		currentScene->Render(renderer);
-
-		renderer.EndFrame(window);
-		glfwPollEvents();
 	}
 
 	glfwDestroyWindow(window);
@@ -1,6 +1,8 @@
 #include "objects/fluid.hpp"
 #include "components/fluid_simulation.hpp"
 #include "core/renderer.hpp"
+#include "core/scene.hpp"
+#include "objects/mesh.hpp"
 
 using namespace engine;
 
@@ -15,21 +17,91 @@ bool FluidObject::fromFile(const std::string &path) {
 }
 
 bool FluidObject::fromFrameData(const std::vector<Vec3f> &frameData,
-								const size_t &nPoints, const size_t &nFrames) {
+								const size_t &nPoints, const size_t &nFrames,
+								PointOrder order) {
 	fluid = std::make_unique<BakedPointDataComponent>(std::move(frameData),
-													  nPoints, nFrames);
+													  nPoints, nFrames, order);
 	AddComponent(fluid.get());
 	return true;
 }
 
-void FluidObject::Render(Renderer &renderer, Scene *scene) {
-	fluid->Bind();
-	renderer.SetUniform("ambientColor", color);
-	renderer.SetShadingType(ShadingType::SolidAmbient);
+bool FluidObject::fromSimulation(std::unique_ptr<FluidSolver> solver) {
+	Vec3f domainMin, domainMax;
+	solver->GetDomain(domainMin, domainMax);
+	const Vec3f extent = domainMax - domainMin;
+	const Vec3f blockMax =
+		domainMin + Vec3f(0.4f * extent.x, 0.8f * extent.y, 0.4f * extent.z);
+	fluid = std::make_unique<FluidSimulationComponent>(std::move(solver),
+													   domainMin, blockMax);
+	AddComponent(fluid.get());
+	return true;
+}
+
+bool FluidObject::fromSimulation(const WcsphSettings &settings) {
+	return fromSimulation(std::make_unique<WcsphSolver>(settings));
+}
+
+bool FluidObject::fromSimulation(const PbfSettings &settings) {
+	return fromSimulation(std::make_unique<PbfSolver>(settings));
+}
+
+size_t FluidObject::AddColliders(const Scene &scene) {
+	auto *simulation = dynamic_cast<FluidSimulationComponent *>(fluid.get());
+	if (simulation == nullptr)
+		return 0;
+
+	const Matrix4f toSim = GetSplat().model.GetInverse();
+	size_t added = 0;
+	for (const std::unique_ptr<SceneObject> &object : scene.GetObjects()) {
+		if (dynamic_cast<MeshObject *>(object.get()) == nullptr)
+			continue;
+		MeshRendererComponent *mesh =
+			object->GetComponent<MeshRendererComponent>();
+		if (mesh == nullptr)
+			continue;
+		const MeshGeometry &geometry = mesh->GetGeometry();
+		const Matrix4f model = toSim * mesh->GetModelMatrix();
+
+		std::vector<Vec3f> positions(geometry.vertices.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+			positions[i] = model * geometry.vertices[i].position;
+		// the collider takes its outside from the winding, which drawing
+		// doesn't care about, so follow the authored normals instead
+		std::vector<unsigned int> indices = geometry.indices;
+		for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+			const Vertex &a = geometry.vertices[indices[t]],
+						 &b = geometry.vertices[indices[t + 1]],
+						 &c = geometry.vertices[indices[t + 2]];
+			const Vec3f face =
+				(b.position - a.position).Cross(c.position - a.position);
+			if (face.Dot(a.normal + b.normal + c.normal) < 0.0f)
+				std::swap(indices[t + 1], indices[t + 2]);
+		}
+		if (simulation->AddCollider(positions, indices))
+			added++;
+	}
+	return added;
+}
+
+bool FluidObject::Record(const std::string &path) {
+	auto *simulation = dynamic_cast<FluidSimulationComponent *>(fluid.get());
+	return simulation != nullptr && simulation->StartRecording(path);
+}
+
+void FluidObject::StopRecording() {
+	if (auto *simulation =
+			dynamic_cast<FluidSimulationComponent *>(fluid.get()))
+		simulation->StopRecording();
+}
+
+FluidSplat FluidObject::GetSplat() const {
 	Matrix4f modelMatrix = Matrix4f::Translation(position) *
 						   rotation.ToMatrix4() * Matrix4f::Scale(size);
-	renderer.SetUniform("model", modelMatrix);
-	renderer.DrawMesh();
-	fluid->Draw(renderer, scene, modelMatrix);
-	SceneObject::Render(renderer, scene);
+	return {fluid.get(), modelMatrix};
+}
+
+void FluidObject::AddRenderPasses(RenderGraph &graph, Renderer &renderer,
+								  Scene *scene) {
+	FluidSplat splat = GetSplat();
+	fluid->AddPasses(graph, renderer, scene, splat.model);
 }
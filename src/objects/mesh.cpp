@@ -80,3 +80,15 @@ void MeshObject::Render(Renderer &renderer, Scene *scene) {
 	renderer.SetUniform("shininess", shininess);
 	SceneObject::Render(renderer, scene);
 }
+
+bool MeshObject::SubmitDraws(DrawList &drawList) {
+	// still uploading, nothing to draw yet
+	if (!mesh->IsReady())
+		return true;
+	DrawItem item = mesh->MakeDrawItem();
+	item.ambientColor = color;
+	item.diffuseColor = color;
+	item.shininess = shininess;
+	drawList.Add(item);
+	return true;
+}
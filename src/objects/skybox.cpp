@@ -1,5 +1,6 @@
 #include "objects/skybox.hpp"
 #include "common/meshUtil.h"
+#include "core/gpu_memory.hpp"
 #include "objects/camera.hpp"
 
 using namespace engine;
@@ -10,6 +11,7 @@ const float skyboxVertices[] = {-1.0f, -1.0f, 1.0f, 3.0f, -1.0f,
 
 SkyboxObject::SkyboxObject() {
 	skybox.Initialize();
+	size_t bytes = 0;
 	const static std::string sides[] = {"posx", "negx", "posy",
 										"negy", "posz", "negz"};
 
@@ -23,26 +25,35 @@ SkyboxObject::SkyboxObject() {
 
 		skybox.SetImageRGBA((cy::GLTextureCubeMapSide)i, image.data(),
 							image_width, image_height);
+		bytes += (size_t)image_width * image_height * 4;
 	}
 	skybox.BuildMipmaps();
 	skybox.SetSeamless();
+	GpuMemory::Track(GpuObject::Texture, skybox.GetID(), GpuCategory::Texture,
+					 "skybox", bytes * 4 / 3);
 
 	skyboxProg.BuildFiles("assets/shaders/skybox.vert",
 						  "assets/shaders/skybox.frag");
 	skyboxProg["skybox"] = 0;
 
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
-	glBindVertexArray(skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices,
-				 GL_STATIC_DRAW);
+	skyboxVAO = GLVertexArray::Create();
+	skyboxVBO = GLBuffer::Create(GpuCategory::Geometry, "skybox");
+	glBindVertexArray(skyboxVAO.Get());
+	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO.Get());
+	GpuMemory::BufferData(GL_ARRAY_BUFFER, skyboxVBO.Get(),
+						  sizeof(skyboxVertices), skyboxVertices,
+						  GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
 						  (void *)0);
 	glBindVertexArray(0);
 }
 
+SkyboxObject::~SkyboxObject() {
+	// the cube map itself is deleted by cy
+	GpuMemory::Untrack(GpuObject::Texture, skybox.GetID());
+}
+
 void SkyboxObject::Render(Renderer &renderer, Scene *scene) {
 	glClear(GL_DEPTH_BUFFER_BIT);
 
@@ -58,7 +69,7 @@ void SkyboxObject::Render(Renderer &renderer, Scene *scene) {
 		(scene->GetActiveCamera()->GetProjection() * skyboxViewMatrix)
 			.GetInverse();
 
-	glBindVertexArray(skyboxVAO);
+	glBindVertexArray(skyboxVAO.Get());
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 	glBindVertexArray(0);
 
@@ -0,0 +1,139 @@
+#include "sim/bake_writer.hpp"
+#include <chrono>
+#include <iostream>
+#include <numeric>
+
+#undef max
+#undef min
+
+#include <Alembic/Abc/OArchive.h>
+#include <Alembic/Abc/OObject.h>
+#include <Alembic/AbcCoreOgawa/All.h>
+#include <Alembic/AbcGeom/OPoints.h>
+
+using namespace engine;
+using namespace Alembic::AbcGeom;
+
+static_assert(sizeof(Vec3f) == sizeof(Alembic::Abc::V3f),
+			  "positions are handed to Alembic as they are");
+
+struct BakeWriter::Archive {
+	OArchive archive;
+	OPoints points;
+	// particles keep their slot from frame to frame
+	std::vector<uint64_t> ids;
+
+	Archive(const std::string &path, double interval)
+		: archive(Alembic::AbcCoreOgawa::WriteArchive(), path),
+		  points(archive.getTop(), "particles",
+				 archive.addTimeSampling(TimeSampling(interval, 0.0))) {}
+};
+
+BakeWriter::BakeWriter(std::unique_ptr<Archive> archive, double interval)
+	: archive(std::move(archive)), interval(interval), pool(poolFrames) {
+	for (std::vector<Vec3f> &frame : pool)
+		freeFrames.push_back(&frame);
+	thread = std::thread(&BakeWriter::Run, this);
+}
+
+std::unique_ptr<BakeWriter> BakeWriter::Open(const std::string &path,
+											 double interval) {
+	std::unique_ptr<Archive> archive;
+	try {
+		archive = std::make_unique<Archive>(path, interval);
+	} catch (const std::exception &e) {
+		std::cerr << "failed to create Alembic file: " << path << " ("
+				  << e.what() << ")" << std::endl;
+		return nullptr;
+	}
+	std::cout << "recording to " << path << std::endl;
+	return std::unique_ptr<BakeWriter>(
+		new BakeWriter(std::move(archive), interval));
+}
+
+BakeWriter::~BakeWriter() {
+	Close();
+	thread.join();
+	std::cout << "recorded " << written << " frames, " << stalls
+			  << " stalls" << std::endl;
+}
+
+void BakeWriter::Close() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	frameQueued.notify_one();
+}
+
+void BakeWriter::Write(const std::vector<Vec3f> &positions) {
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+
+	std::vector<Vec3f> *frame;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (freeFrames.empty()) {
+			stalls++;
+			frameFreed.wait(lock, [&]() { return !freeFrames.empty(); });
+		}
+		frame = freeFrames.back();
+		freeFrames.pop_back();
+	}
+	frame->assign(positions.begin(), positions.end());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(frame);
+	}
+	frameQueued.notify_one();
+
+	writeNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+					  Clock::now() - start)
+					  .count();
+}
+
+void BakeWriter::Run() {
+	using Clock = std::chrono::steady_clock;
+	bool failed = false;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		frameQueued.wait(lock, [&]() { return closing || !queued.empty(); });
+		// closing still writes out what was queued before it
+		if (queued.empty()) {
+			closed = true;
+			return;
+		}
+		std::vector<Vec3f> *frame = queued.front();
+		queued.pop_front();
+		lock.unlock();
+
+		const Clock::time_point start = Clock::now();
+		std::vector<uint64_t> &ids = archive->ids;
+		if (ids.size() < frame->size()) {
+			ids.resize(frame->size());
+			std::iota(ids.begin(), ids.end(), 0);
+		}
+		// a failed write leaves the cache unusable, the rest is dropped
+		if (!failed) {
+			try {
+				const OPointsSchema::Sample sample(
+					P3fArraySample(reinterpret_cast<const Alembic::Abc::V3f *>(
+									   frame->data()),
+								   frame->size()),
+					UInt64ArraySample(ids.data(), frame->size()));
+				archive->points.getSchema().set(sample);
+				written++;
+			} catch (const std::exception &e) {
+				std::cerr << "recording stopped: " << e.what() << std::endl;
+				failed = true;
+			}
+		}
+		encodeNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+						   Clock::now() - start)
+						   .count();
+
+		lock.lock();
+		freeFrames.push_back(frame);
+		frameFreed.notify_one();
+	}
+}
@@ -0,0 +1,90 @@
+#include "sim/fluid_solver.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+using namespace engine;
+
+float FluidSolver::LatticeMass(const Poly6Kernel &kernel,
+							   float restDensity) const {
+	float sum = 0.0f;
+	const int reach = (int)std::ceil(kernel.h / spacing);
+	for (int z = -reach; z <= reach; ++z)
+		for (int y = -reach; y <= reach; ++y)
+			for (int x = -reach; x <= reach; ++x)
+				sum += kernel.W2((float)(x * x + y * y + z * z) * spacing *
+								 spacing);
+	return restDensity / sum;
+}
+
+SphQuery FluidSolver::Query(size_t i, float h) const {
+	SphQuery q;
+	q.px = particles.px.data();
+	q.py = particles.py.data();
+	q.pz = particles.pz.data();
+	q.vx = particles.vx.data();
+	q.vy = particles.vy.data();
+	q.vz = particles.vz.data();
+	q.density = particles.density.data();
+	q.pressure = particles.pressure.data();
+	q.xi = particles.px[i];
+	q.yi = particles.py[i];
+	q.zi = particles.pz[i];
+	q.vxi = particles.vx[i];
+	q.vyi = particles.vy[i];
+	q.vzi = particles.vz[i];
+	q.h = h;
+	q.h2 = h * h;
+	return q;
+}
+
+namespace {
+
+/** Largest length of the vectors (x[i], y[i], z[i]) */
+float maxLength(const FloatArray &x, const FloatArray &y,
+				const FloatArray &z) {
+	std::mutex mutex;
+	float result = 0.0f;
+	parallelFor(
+		x.size(),
+		[&](size_t begin, size_t end) {
+			float length2 = 0.0f;
+			for (size_t i = begin; i < end; ++i)
+				length2 =
+					std::max(length2, x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+			std::lock_guard<std::mutex> lock(mutex);
+			result = std::max(result, length2);
+		},
+		16384);
+	return std::sqrt(result);
+}
+
+} // namespace
+
+float FluidSolver::MaxSpeed() const {
+	return maxLength(particles.vx, particles.vy, particles.vz);
+}
+
+float FluidSolver::MaxAcceleration() const {
+	return maxLength(particles.ax, particles.ay, particles.az);
+}
+
+void FluidSolver::Clear() {
+	particles.Clear();
+	steps = 0;
+}
+
+void FluidSolver::AddBlock(const Vec3f &boundMin, const Vec3f &boundMax,
+						   const Vec3f &velocity) {
+	int counts[3];
+	for (int i = 0; i < 3; ++i)
+		counts[i] =
+			std::max((int)std::floor((boundMax[i] - boundMin[i]) / spacing), 0);
+	for (int z = 0; z < counts[2]; ++z)
+		for (int y = 0; y < counts[1]; ++y)
+			for (int x = 0; x < counts[0]; ++x)
+				particles.Add(boundMin + Vec3f(x + 0.5f, y + 0.5f, z + 0.5f) *
+											 spacing,
+							  velocity);
+}
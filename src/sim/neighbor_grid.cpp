@@ -0,0 +1,17 @@
+#include "sim/neighbor_grid.hpp"
+
+using namespace engine;
+
+void NeighborGrid::Configure(const Vec3f &boundMin, const Vec3f &boundMax,
+							 float cellSize) {
+	search.SetRadius(cellSize);
+	search.SetDomain(boundMin, boundMax);
+}
+
+void NeighborGrid::Build(ParticleStore &particles) {
+	const auto points = NeighborSearch::Points::soa(
+		particles.px.data(), particles.py.data(), particles.pz.data(),
+		particles.Size());
+	if (search.Build(points))
+		particles.Permute(search.GetOrder());
+}
@@ -0,0 +1,55 @@
+#include "sim/particle_store.hpp"
+#include "common/parallel.hpp"
+
+using namespace engine;
+
+void ParticleStore::Clear() {
+	for (auto *array : {&px, &py, &pz, &vx, &vy, &vz, &density, &pressure,
+						&ax, &ay, &az})
+		array->clear();
+	id.clear();
+}
+
+void ParticleStore::Add(const Vec3f &position, const Vec3f &velocity) {
+	px.push_back(position.x);
+	py.push_back(position.y);
+	pz.push_back(position.z);
+	vx.push_back(velocity.x);
+	vy.push_back(velocity.y);
+	vz.push_back(velocity.z);
+	for (auto *array : {&density, &pressure, &ax, &ay, &az})
+		array->push_back(0.0f);
+	id.push_back((uint32_t)id.size());
+}
+
+void ParticleStore::Permute(const std::vector<uint32_t> &order) {
+	const size_t n = Size();
+	scratch.resize(n);
+	for (FloatArray *array : {&px, &py, &pz, &vx, &vy, &vz, &density,
+							  &pressure, &ax, &ay, &az}) {
+		const float *src = array->data();
+		parallelFor(
+			n,
+			[&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i)
+					scratch[i] = src[order[i]];
+			},
+			4096);
+		array->swap(scratch);
+	}
+	scratchId.resize(n);
+	parallelFor(
+		n,
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				scratchId[i] = id[order[i]];
+		},
+		4096);
+	id.swap(scratchId);
+}
+
+void ParticleStore::CopyPositions(std::vector<Vec3f> &out) const {
+	out.resize(Size());
+	for (size_t i = 0; i < out.size(); ++i)
+		out[id[i]] = Position(i);
+}
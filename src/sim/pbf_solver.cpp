@@ -0,0 +1,357 @@
+#include "sim/pbf_solver.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace engine;
+
+namespace {
+
+// particles per worker below which a pass stays on fewer threads
+constexpr size_t minParticlesPerWorker = 1024;
+
+/** Keeps p inside [lo, hi], stopping velocity into the wall */
+inline void clampToWall(float &p, float &v, float lo, float hi) {
+	if (p < lo) {
+		p = lo;
+		v = std::max(v, 0.0f);
+	} else if (p > hi) {
+		p = hi;
+		v = std::min(v, 0.0f);
+	}
+}
+
+inline void clampToWall(float &p, float lo, float hi) {
+	p = std::clamp(p, lo, hi);
+}
+
+} // namespace
+
+PbfSolver::PbfSolver(const PbfSettings &settings) : settings(settings) {
+	spacing = 2.0f * settings.particleRadius;
+	const float h = 2.0f * spacing;
+	kernel = Poly6Kernel(h);
+	gradKernel = SpikyKernel(h);
+	// a block at rest starts without constraint error
+	mass = LatticeMass(kernel, settings.restDensity);
+	const float dq = settings.tensileDq * h;
+	invTensileW = 1.0f / kernel.W2(dq * dq);
+	// s_corr is added to the multipliers, so it's scaled by the constraint
+	// denominator of a particle at rest: k is then a density error
+	float restGradSum = 0.0f;
+	for (int z = -2; z <= 2; ++z) {
+		for (int y = -2; y <= 2; ++y) {
+			for (int x = -2; x <= 2; ++x) {
+				const float r = std::sqrt((float)(x * x + y * y + z * z)) * spacing;
+				const float g = mass / settings.restDensity *
+								gradKernel.GradScale(r) * r;
+				restGradSum += g * g;
+			}
+		}
+	}
+	tensileScale = settings.tensileK / (restGradSum + settings.relaxation);
+	walls.Build(kernel, gradKernel, spacing, mass);
+	grid.Configure(settings.domainMin, settings.domainMax, kernel.h);
+}
+
+void PbfSolver::GetDomain(Vec3f &boundMin, Vec3f &boundMax) const {
+	boundMin = settings.domainMin;
+	boundMax = settings.domainMax;
+}
+
+void PbfSolver::WallTerms(size_t i, float &density, Vec3f &gradient) const {
+	const Vec3f p = particles.Position(i);
+	density = 0.0f;
+	gradient = Vec3f(0.0f);
+	for (int axis = 0; axis < 3; ++axis) {
+		float rho, grad;
+		walls.Lookup(p[axis] - settings.domainMin[axis], rho, grad);
+		density += rho;
+		gradient[axis] += grad;
+		walls.Lookup(settings.domainMax[axis] - p[axis], rho, grad);
+		density += rho;
+		gradient[axis] -= grad;
+	}
+}
+
+void PbfSolver::Predict() {
+	const Vec3f lo = settings.domainMin + Vec3f(settings.particleRadius);
+	const Vec3f hi = settings.domainMax - Vec3f(settings.particleRadius);
+	const Vec3f g = settings.gravity;
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				particles.vx[i] += g.x * dt;
+				particles.vy[i] += g.y * dt;
+				particles.vz[i] += g.z * dt;
+				particles.px[i] += particles.vx[i] * dt;
+				particles.py[i] += particles.vy[i] * dt;
+				particles.pz[i] += particles.vz[i] * dt;
+				clampToWall(particles.px[i], particles.vx[i], lo.x, hi.x);
+				clampToWall(particles.py[i], particles.vy[i], lo.y, hi.y);
+				clampToWall(particles.pz[i], particles.vz[i], lo.z, hi.z);
+
+				// drop the velocity into an obstacle, like at the walls
+				Vec3f n;
+				if (Collide(particles.px[i], particles.py[i], particles.pz[i],
+							settings.particleRadius, n)) {
+					const float vn = particles.vx[i] * n.x +
+									 particles.vy[i] * n.y +
+									 particles.vz[i] * n.z;
+					if (vn < 0.0f) {
+						particles.vx[i] -= vn * n.x;
+						particles.vy[i] -= vn * n.y;
+						particles.vz[i] -= vn * n.z;
+					}
+				}
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void PbfSolver::ComputeLambda() {
+	const SphKernels &kernels = sphKernels();
+	const float invRest = 1.0f / settings.restDensity;
+	// spiky gradient and poly6 constants the kernel sums leave out
+	const float gradScale = mass * invRest * gradKernel.l;
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				// density, the gradient of C_i with respect to p_i and the
+				// squared gradients with respect to every neighbour
+				const SphQuery q = Query(i, kernel.h);
+				SphSums sums;
+				grid.ForEachRange(particles, i,
+								  [&](uint32_t first, uint32_t last) {
+									  kernels.lambdaTerms(q, first, last, sums);
+								  });
+
+				// the walls act as frozen fluid, without them the layer
+				// touching a wall is crushed into its plane
+				float wallRho;
+				Vec3f wallGrad;
+				WallTerms(i, wallRho, wallGrad);
+				const float gx = gradScale * sums.x + wallGrad.x * invRest;
+				const float gy = gradScale * sums.y + wallGrad.y * invRest;
+				const float gz = gradScale * sums.z + wallGrad.z * invRest;
+
+				const float rho = mass * kernel.k * sums.density + wallRho;
+				particles.density[i] = rho;
+
+				// one-sided, under-dense particles at the surface are left
+				// alone and s_corr handles their clumping
+				const float c = std::max(rho * invRest - 1.0f, 0.0f);
+				const float gradSum = gradScale * gradScale * sums.gradSq +
+									  gx * gx + gy * gy + gz * gz;
+				lambda[i] = -c / (gradSum + settings.relaxation);
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void PbfSolver::ApplyCorrections() {
+	const SphKernels &kernels = sphKernels();
+	const float scale = mass / settings.restDensity * gradKernel.l;
+	const Vec3f lo = settings.domainMin + Vec3f(settings.particleRadius);
+	const Vec3f hi = settings.domainMax - Vec3f(settings.particleRadius);
+
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				SphQuery q = Query(i, kernel.h);
+				q.lambda = lambda.data();
+				q.lambdaI = lambda[i];
+				q.tensileScale = tensileScale;
+				q.invTensileW = kernel.k * invTensileW;
+				q.tensileN = settings.tensileN;
+				SphSums sums;
+				grid.ForEachRange(particles, i,
+								  [&](uint32_t first, uint32_t last) {
+									  kernels.corrections(q, first, last, sums);
+								  });
+
+				// walls have no multiplier of their own
+				float wallRho;
+				Vec3f wallGrad;
+				WallTerms(i, wallRho, wallGrad);
+				const float wallScale = q.lambdaI / settings.restDensity;
+				deltaX[i] = scale * sums.x + wallScale * wallGrad.x;
+				deltaY[i] = scale * sums.y + wallScale * wallGrad.y;
+				deltaZ[i] = scale * sums.z + wallScale * wallGrad.z;
+			}
+		},
+		minParticlesPerWorker);
+
+	// separate pass, every correction above read the same positions
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				particles.px[i] += deltaX[i];
+				particles.py[i] += deltaY[i];
+				particles.pz[i] += deltaZ[i];
+				clampToWall(particles.px[i], lo.x, hi.x);
+				clampToWall(particles.py[i], lo.y, hi.y);
+				clampToWall(particles.pz[i], lo.z, hi.z);
+				Vec3f n;
+				Collide(particles.px[i], particles.py[i], particles.pz[i],
+						settings.particleRadius, n);
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void PbfSolver::UpdateVelocities() {
+	const float invDt = 1.0f / dt;
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				particles.vx[i] += (particles.px[i] - startX[i]) * invDt;
+				particles.vy[i] += (particles.py[i] - startY[i]) * invDt;
+				particles.vz[i] += (particles.pz[i] - startZ[i]) * invDt;
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void PbfSolver::ConfineVorticity() {
+	const float h = kernel.h;
+	const float epsilon = settings.vorticity;
+
+	// curl of the velocity field
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const float vxI = particles.vx[i], vyI = particles.vy[i],
+							vzI = particles.vz[i];
+				float wx = 0, wy = 0, wz = 0;
+				grid.ForEachNeighbor(
+					particles, i, h,
+					[&](uint32_t j, float dx, float dy, float dz, float r2) {
+						if (j == i)
+							return;
+						const float s = mass / particles.density[j] *
+										gradKernel.GradScale(std::sqrt(r2));
+						const float gx = s * dx, gy = s * dy, gz = s * dz;
+						const float ux = particles.vx[j] - vxI,
+									uy = particles.vy[j] - vyI,
+									uz = particles.vz[j] - vzI;
+						wx += gy * uz - gz * uy;
+						wy += gz * ux - gx * uz;
+						wz += gx * uy - gy * ux;
+					});
+				scratchX[i] = wx;
+				scratchY[i] = wy;
+				scratchZ[i] = wz;
+			}
+		},
+		minParticlesPerWorker);
+
+	// push along the gradient of |curl|, towards the vortex centre
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const float wx = scratchX[i], wy = scratchY[i],
+							wz = scratchZ[i];
+				const float lengthI = std::sqrt(wx * wx + wy * wy + wz * wz);
+				float nx = 0, ny = 0, nz = 0;
+				grid.ForEachNeighbor(
+					particles, i, h,
+					[&](uint32_t j, float dx, float dy, float dz, float r2) {
+						if (j == i)
+							return;
+						const float lengthJ =
+							std::sqrt(scratchX[j] * scratchX[j] +
+									  scratchY[j] * scratchY[j] +
+									  scratchZ[j] * scratchZ[j]);
+						const float s = mass / particles.density[j] *
+										(lengthJ - lengthI) *
+										gradKernel.GradScale(std::sqrt(r2));
+						nx += s * dx;
+						ny += s * dy;
+						nz += s * dz;
+					});
+				const float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+				if (length < 1e-9f)
+					continue;
+				nx /= length;
+				ny /= length;
+				nz /= length;
+				particles.vx[i] += epsilon * (ny * wz - nz * wy) * dt;
+				particles.vy[i] += epsilon * (nz * wx - nx * wz) * dt;
+				particles.vz[i] += epsilon * (nx * wy - ny * wx) * dt;
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void PbfSolver::SmoothVelocities() {
+	const SphKernels &kernels = sphKernels();
+	const float c = settings.xsphViscosity * mass * kernel.k;
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const SphQuery q = Query(i, kernel.h);
+				SphSums sums;
+				grid.ForEachRange(particles, i,
+								  [&](uint32_t first, uint32_t last) {
+									  kernels.xsph(q, first, last, sums);
+								  });
+				scratchX[i] = q.vxi + c * sums.vx;
+				scratchY[i] = q.vyi + c * sums.vy;
+				scratchZ[i] = q.vzi + c * sums.vz;
+			}
+		},
+		minParticlesPerWorker);
+	particles.vx.swap(scratchX);
+	particles.vy.swap(scratchY);
+	particles.vz.swap(scratchZ);
+}
+
+float PbfSolver::StableTimeStep() const {
+	// gravity adds to the speed during the step, before the grid is built
+	const float speed =
+		MaxSpeed() + settings.gravity.Length() * settings.maxTimeStep;
+	if (speed <= 0.0f)
+		return settings.maxTimeStep;
+	return std::min(settings.cflNumber * kernel.h / speed,
+					settings.maxTimeStep);
+}
+
+void PbfSolver::Step(float stepDt) {
+	const size_t n = particles.Size();
+	if (n == 0)
+		return;
+	dt = stepDt;
+
+	Predict();
+	// sorted on the predicted positions, which the projection only nudges
+	grid.Build(particles);
+
+	startX = particles.px;
+	startY = particles.py;
+	startZ = particles.pz;
+	for (auto *array :
+		 {&lambda, &deltaX, &deltaY, &deltaZ, &scratchX, &scratchY, &scratchZ})
+		array->resize(n);
+
+	for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+		ComputeLambda();
+		ApplyCorrections();
+	}
+
+	UpdateVelocities();
+	// densities are from the last projection, close enough for both
+	if (settings.iterations > 0 && settings.vorticity > 0.0f)
+		ConfineVorticity();
+	if (settings.iterations > 0 && settings.xsphViscosity > 0.0f)
+		SmoothVelocities();
+	steps++;
+}
@@ -0,0 +1,444 @@
+#include "sim/sdf_collider.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+using namespace engine;
+
+namespace {
+
+constexpr uint32_t cacheMagic = 0x43464453; // "SDFC"
+constexpr uint32_t cacheVersion = 2;
+// voxels per brick edge, bricks are baked in parallel
+constexpr int brickSize = 8;
+// distance of voxels outside the band until the flood fill signs them
+constexpr float unset = std::numeric_limits<float>::max();
+
+/*
+Triangle Feature:
+	Face - the closest point is inside the triangle
+	VertexA, VertexB, VertexC - on a corner
+	EdgeAB, EdgeBC, EdgeCA - on an edge
+*/
+enum class Feature { Face, VertexA, VertexB, VertexC, EdgeAB, EdgeBC, EdgeCA };
+
+/** Closest point on triangle abc to p (Ericson, Real-Time Collision Detection) */
+Vec3f closestOnTriangle(const Vec3f &p, const Vec3f &a, const Vec3f &b,
+						const Vec3f &c, Feature &feature) {
+	const Vec3f ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = ab.Dot(ap), d2 = ac.Dot(ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		feature = Feature::VertexA;
+		return a;
+	}
+	const Vec3f bp = p - b;
+	const float d3 = ab.Dot(bp), d4 = ac.Dot(bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		feature = Feature::VertexB;
+		return b;
+	}
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		feature = Feature::EdgeAB;
+		return a + ab * (d1 / (d1 - d3));
+	}
+	const Vec3f cp = p - c;
+	const float d5 = ab.Dot(cp), d6 = ac.Dot(cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		feature = Feature::VertexC;
+		return c;
+	}
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		feature = Feature::EdgeCA;
+		return a + ac * (d2 / (d2 - d6));
+	}
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+		feature = Feature::EdgeBC;
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+	const float denom = 1.0f / (va + vb + vc);
+	feature = Feature::Face;
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+/** Welded triangle with the pseudonormals of its features */
+struct SdfTriangle {
+	uint32_t vertex[3];
+	uint32_t edge[3]; // ab, bc, ca
+	Vec3f normal;
+};
+
+struct Hasher {
+	uint64_t hash = 14695981039346656037ull;
+	void Add(const void *data, size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < bytes; ++i) {
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+	}
+};
+
+/** Whether the ray from o along dir crosses triangle abc (Moller-Trumbore) */
+bool rayHitsTriangle(const Vec3f &o, const Vec3f &dir, const Vec3f &a,
+					 const Vec3f &b, const Vec3f &c) {
+	const Vec3f ab = b - a, ac = c - a;
+	const Vec3f h = dir.Cross(ac);
+	const float det = ab.Dot(h);
+	if (std::abs(det) < 1e-12f)
+		return false;
+	const float inv = 1.0f / det;
+	const Vec3f ao = o - a;
+	const float u = ao.Dot(h) * inv;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	const Vec3f q = ao.Cross(ab);
+	const float v = dir.Dot(q) * inv;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+	return ac.Dot(q) * inv > 0.0f;
+}
+
+float angleBetween(const Vec3f &u, const Vec3f &v) {
+	const float len = std::sqrt(u.LengthSquared() * v.LengthSquared());
+	if (len <= 0.0f)
+		return 0.0f;
+	return std::acos(std::clamp(u.Dot(v) / len, -1.0f, 1.0f));
+}
+
+} // namespace
+
+std::shared_ptr<SdfCollider>
+SdfCollider::Bake(const std::vector<Vec3f> &positions,
+				  const std::vector<unsigned int> &indices, float cellSize,
+				  float band, const Vec3f &clipMin, const Vec3f &clipMax,
+				  const std::string &cacheDir) {
+	// the band has to be thicker than a cell for the flood fill not to
+	// leak through it
+	band = std::max(band, 2.0f * cellSize);
+
+	Vec3f meshMin(std::numeric_limits<float>::max());
+	Vec3f meshMax(std::numeric_limits<float>::lowest());
+	for (unsigned int index : indices) {
+		const Vec3f &p = positions[index];
+		for (int a = 0; a < 3; ++a) {
+			meshMin[a] = std::min(meshMin[a], p[a]);
+			meshMax[a] = std::max(meshMax[a], p[a]);
+		}
+	}
+	Vec3f boundMin, boundMax;
+	for (int a = 0; a < 3; ++a) {
+		boundMin[a] = std::max(meshMin[a] - band, clipMin[a]) - cellSize;
+		boundMax[a] = std::min(meshMax[a] + band, clipMax[a]) + cellSize;
+		if (indices.size() < 3 || boundMin[a] >= boundMax[a])
+			return nullptr;
+	}
+
+	auto collider = std::make_shared<SdfCollider>();
+	collider->origin = boundMin;
+	collider->cellSize = cellSize;
+	collider->invCellSize = 1.0f / cellSize;
+	collider->band = band;
+	for (int a = 0; a < 3; ++a)
+		collider->dims[a] =
+			(int)std::ceil((boundMax[a] - boundMin[a]) / cellSize) + 1;
+	const int *dims = collider->dims;
+
+	Hasher hasher;
+	hasher.Add(&cacheVersion, sizeof(cacheVersion));
+	hasher.Add(positions.data(), positions.size() * sizeof(Vec3f));
+	hasher.Add(indices.data(), indices.size() * sizeof(unsigned int));
+	hasher.Add(&cellSize, sizeof(cellSize));
+	hasher.Add(&band, sizeof(band));
+	hasher.Add(&boundMin, sizeof(boundMin));
+	hasher.Add(dims, 3 * sizeof(int));
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.sdf",
+				  (unsigned long long)hasher.hash);
+	const std::string path = cacheDir + "/" + name;
+	if (collider->Load(path, hasher.hash))
+		return collider;
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+
+	// weld by position, faces of a cuboid don't share vertices
+	std::vector<Vec3f> welded;
+	std::vector<uint32_t> weldOf(positions.size());
+	{
+		struct PositionHash {
+			size_t operator()(const Vec3f &v) const {
+				return std::hash<float>()(v.x) ^
+					   (std::hash<float>()(v.y) << 1) ^
+					   (std::hash<float>()(v.z) << 2);
+			}
+		};
+		std::unordered_map<Vec3f, uint32_t, PositionHash> ids;
+		for (size_t i = 0; i < positions.size(); ++i) {
+			auto it = ids.emplace(positions[i], (uint32_t)welded.size()).first;
+			if (it->second == welded.size())
+				welded.push_back(positions[i]);
+			weldOf[i] = it->second;
+		}
+	}
+
+	// angle-weighted vertex normals and summed edge normals, which sign
+	// points closest to a corner or an edge correctly
+	std::vector<SdfTriangle> triangles;
+	std::vector<Vec3f> vertexNormals(welded.size(), Vec3f(0.0f));
+	std::vector<Vec3f> edgeNormals;
+	std::unordered_map<uint64_t, uint32_t> edgeIds;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		SdfTriangle tri;
+		for (int k = 0; k < 3; ++k)
+			tri.vertex[k] = weldOf[indices[t + k]];
+		const Vec3f &a = welded[tri.vertex[0]], &b = welded[tri.vertex[1]],
+					&c = welded[tri.vertex[2]];
+		Vec3f normal = (b - a).Cross(c - a);
+		if (normal.LengthSquared() <= 0.0f)
+			continue;
+		tri.normal = normal.GetNormalized();
+
+		vertexNormals[tri.vertex[0]] += tri.normal * angleBetween(b - a, c - a);
+		vertexNormals[tri.vertex[1]] += tri.normal * angleBetween(c - b, a - b);
+		vertexNormals[tri.vertex[2]] += tri.normal * angleBetween(a - c, b - c);
+		for (int k = 0; k < 3; ++k) {
+			const uint32_t u = tri.vertex[k], v = tri.vertex[(k + 1) % 3];
+			const uint64_t key =
+				((uint64_t)std::min(u, v) << 32) | std::max(u, v);
+			auto it = edgeIds.emplace(key, (uint32_t)edgeNormals.size()).first;
+			if (it->second == edgeNormals.size())
+				edgeNormals.push_back(Vec3f(0.0f));
+			edgeNormals[it->second] += tri.normal;
+			tri.edge[k] = it->second;
+		}
+		triangles.push_back(tri);
+	}
+
+	// triangles whose band reaches each brick
+	int bricks[3];
+	for (int a = 0; a < 3; ++a)
+		bricks[a] = (dims[a] + brickSize - 1) / brickSize;
+	const float brickWidth = brickSize * cellSize;
+	std::vector<std::vector<uint32_t>> brickTriangles((size_t)bricks[0] *
+													  bricks[1] * bricks[2]);
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		int lo[3], hi[3];
+		for (int a = 0; a < 3; ++a) {
+			float tMin = welded[triangles[t].vertex[0]][a], tMax = tMin;
+			for (int k = 1; k < 3; ++k) {
+				tMin = std::min(tMin, welded[triangles[t].vertex[k]][a]);
+				tMax = std::max(tMax, welded[triangles[t].vertex[k]][a]);
+			}
+			lo[a] = std::max(
+				(int)std::floor((tMin - band - boundMin[a]) / brickWidth), 0);
+			hi[a] = std::min(
+				(int)std::floor((tMax + band - boundMin[a]) / brickWidth),
+				bricks[a] - 1);
+		}
+		for (int z = lo[2]; z <= hi[2]; ++z)
+			for (int y = lo[1]; y <= hi[1]; ++y)
+				for (int x = lo[0]; x <= hi[0]; ++x)
+					brickTriangles[((size_t)z * bricks[1] + y) * bricks[0] + x]
+						.push_back((uint32_t)t);
+	}
+
+	std::vector<float> &distance = collider->distance;
+	distance.assign((size_t)dims[0] * dims[1] * dims[2], unset);
+	const float band2 = band * band;
+	parallelFor(brickTriangles.size(), [&](size_t first, size_t last) {
+		for (size_t brick = first; brick < last; ++brick) {
+			const std::vector<uint32_t> &candidates = brickTriangles[brick];
+			if (candidates.empty())
+				continue;
+			const int bx = (int)(brick % bricks[0]) * brickSize,
+					  by = (int)(brick / bricks[0] % bricks[1]) * brickSize,
+					  bz = (int)(brick / bricks[0] / bricks[1]) * brickSize;
+			for (int z = bz; z < std::min(bz + brickSize, dims[2]); ++z)
+				for (int y = by; y < std::min(by + brickSize, dims[1]); ++y)
+					for (int x = bx; x < std::min(bx + brickSize, dims[0]);
+						 ++x) {
+						const Vec3f p = boundMin + Vec3f((float)x, (float)y,
+														 (float)z) *
+													   cellSize;
+						float best = band2;
+						Vec3f bestOffset, bestNormal;
+						for (uint32_t t : candidates) {
+							const SdfTriangle &tri = triangles[t];
+							Feature feature;
+							const Vec3f q = closestOnTriangle(
+								p, welded[tri.vertex[0]], welded[tri.vertex[1]],
+								welded[tri.vertex[2]], feature);
+							const Vec3f offset = p - q;
+							const float d2 = offset.LengthSquared();
+							if (d2 >= best)
+								continue;
+							best = d2;
+							bestOffset = offset;
+							switch (feature) {
+							case Feature::Face:
+								bestNormal = tri.normal;
+								break;
+							case Feature::VertexA:
+							case Feature::VertexB:
+							case Feature::VertexC:
+								bestNormal =
+									vertexNormals[tri.vertex[(int)feature - 1]];
+								break;
+							default:
+								bestNormal =
+									edgeNormals[tri.edge[(int)feature - 4]];
+								break;
+							}
+						}
+						if (best < band2) {
+							const float d = std::sqrt(best);
+							distance[((size_t)z * dims[1] + y) * dims[0] + x] =
+								bestOffset.Dot(bestNormal) < 0.0f ? -d : d;
+						}
+					}
+		}
+	});
+
+	// voxels past the band take the sign of the band side they touch: a
+	// cell is thinner than the band, so the surface can't pass between
+	// them. the grid may be clipped through the mesh, so its border says
+	// nothing about what is outside
+	enum : uint8_t { Unknown, Outside, Inside };
+	std::vector<uint8_t> side(distance.size(), Unknown);
+	std::vector<size_t> queue;
+	auto fill = [&](uint8_t label) {
+		auto visit = [&](int x, int y, int z) {
+			const size_t i = ((size_t)z * dims[1] + y) * dims[0] + x;
+			if (side[i] != Unknown || distance[i] != unset)
+				return;
+			side[i] = label;
+			queue.push_back(i);
+		};
+		while (!queue.empty()) {
+			const size_t i = queue.back();
+			queue.pop_back();
+			const int x = (int)(i % dims[0]), y = (int)(i / dims[0] % dims[1]),
+					  z = (int)(i / dims[0] / dims[1]);
+			if (x > 0)
+				visit(x - 1, y, z);
+			if (x + 1 < dims[0])
+				visit(x + 1, y, z);
+			if (y > 0)
+				visit(x, y - 1, z);
+			if (y + 1 < dims[1])
+				visit(x, y + 1, z);
+			if (z > 0)
+				visit(x, y, z - 1);
+			if (z + 1 < dims[2])
+				visit(x, y, z + 1);
+		}
+	};
+	for (uint8_t label : {Outside, Inside}) {
+		for (size_t i = 0; i < distance.size(); ++i) {
+			if (distance[i] != unset &&
+				(label == Outside) == (distance[i] >= 0.0f)) {
+				side[i] = label;
+				queue.push_back(i);
+			}
+		}
+		fill(label);
+	}
+	// pockets the band doesn't reach, when the mesh is far from or all
+	// around the grid: a ray from one voxel crosses the surface an odd
+	// number of times from inside. skewed off the axes so it doesn't run
+	// along the edges of axis-aligned meshes
+	const Vec3f ray = Vec3f(1.0f, 0.0123f, 0.0371f).GetNormalized();
+	for (size_t i = 0; i < distance.size(); ++i) {
+		if (side[i] != Unknown)
+			continue;
+		const Vec3f p =
+			boundMin + Vec3f((float)(i % dims[0]), (float)(i / dims[0] % dims[1]),
+							 (float)(i / dims[0] / dims[1])) *
+						   cellSize;
+		bool inside = false;
+		for (const SdfTriangle &tri : triangles)
+			inside ^= rayHitsTriangle(p, ray, welded[tri.vertex[0]],
+									  welded[tri.vertex[1]],
+									  welded[tri.vertex[2]]);
+		side[i] = inside ? Inside : Outside;
+		queue.push_back(i);
+		fill(side[i]);
+	}
+	for (size_t i = 0; i < distance.size(); ++i)
+		if (distance[i] == unset)
+			distance[i] = side[i] == Outside ? band : -band;
+
+	std::cout << "sdf: " << triangles.size() << " triangles into " << dims[0]
+			  << "x" << dims[1] << "x" << dims[2] << " in "
+			  << std::chrono::duration<double, std::milli>(Clock::now() -
+														   start)
+					 .count()
+			  << " ms" << std::endl;
+	collider->Save(path, hasher.hash);
+	return collider;
+}
+
+void SdfCollider::GetBounds(Vec3f &boundMin, Vec3f &boundMax) const {
+	boundMin = origin;
+	boundMax = origin + Vec3f((float)(dims[0] - 1), (float)(dims[1] - 1),
+							  (float)(dims[2] - 1)) *
+							cellSize;
+}
+
+bool SdfCollider::Load(const std::string &path, uint64_t hash) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	uint32_t magic = 0, version = 0;
+	uint64_t storedHash = 0;
+	int storedDims[3];
+	in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+	in.read(reinterpret_cast<char *>(&version), sizeof(version));
+	in.read(reinterpret_cast<char *>(&storedHash), sizeof(storedHash));
+	in.read(reinterpret_cast<char *>(storedDims), sizeof(storedDims));
+	if (!in || magic != cacheMagic || version != cacheVersion ||
+		storedHash != hash || storedDims[0] != dims[0] ||
+		storedDims[1] != dims[1] || storedDims[2] != dims[2])
+		return false;
+	distance.resize((size_t)dims[0] * dims[1] * dims[2]);
+	in.read(reinterpret_cast<char *>(distance.data()),
+			distance.size() * sizeof(float));
+	if (!in) {
+		distance.clear();
+		return false;
+	}
+	return true;
+}
+
+void SdfCollider::Save(const std::string &path, uint64_t hash) const {
+	std::error_code error;
+	std::filesystem::create_directories(
+		std::filesystem::path(path).parent_path(), error);
+	// written aside and renamed, a cut-off write is never loaded
+	const std::string partial = path + ".partial";
+	{
+		std::ofstream out(partial, std::ios::binary);
+		if (!out)
+			return;
+		out.write(reinterpret_cast<const char *>(&cacheMagic),
+				  sizeof(cacheMagic));
+		out.write(reinterpret_cast<const char *>(&cacheVersion),
+				  sizeof(cacheVersion));
+		out.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+		out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+		out.write(reinterpret_cast<const char *>(distance.data()),
+				  distance.size() * sizeof(float));
+		if (!out)
+			return;
+	}
+	std::filesystem::rename(partial, path, error);
+}
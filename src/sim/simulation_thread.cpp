@@ -0,0 +1,210 @@
+#include "sim/simulation_thread.hpp"
+#include <algorithm>
+#include <chrono>
+
+using namespace engine;
+
+SimulationThread::SimulationThread(std::unique_ptr<FluidSolver> fluidSolver)
+	: solver(std::move(fluidSolver)), fixedStep(solver->GetTimeStep()),
+	  timeStep(fixedStep) {
+	{
+		std::lock_guard<std::mutex> lock(stepMutex);
+		Publish(0.0, timeStep, true);
+	}
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+SimulationThread::~SimulationThread() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+double SimulationThread::ChooseStep(double stable, double ceiling) const {
+	if (!adaptive)
+		return fixedStep;
+	// the cap on substeps wins over the CFL limit, never over the ceiling
+	const double floor = std::min(frameTime / maxSubsteps, ceiling);
+	return std::clamp(stable, floor, ceiling);
+}
+
+void SimulationThread::Run() {
+	using Clock = std::chrono::steady_clock;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [&]() {
+			return stopping || !handoff.empty() ||
+				   simTime + timeStep <= targetTime;
+		});
+		if (stopping)
+			return;
+		if (!handoff.empty()) {
+			std::vector<std::unique_ptr<BakeWriter>> writers;
+			writers.swap(handoff);
+			lock.unlock();
+			for (std::unique_ptr<BakeWriter> &writer : writers)
+				SwapRecorder(std::move(writer));
+			lock.lock();
+			continue;
+		}
+
+		// too far behind to catch up, run slower than real time instead
+		if (targetTime - simTime > maxLagSteps * timeStep)
+			simTime = targetTime - maxLagSteps * timeStep;
+		const double step = timeStep;
+		const double time = simTime + step;
+		const size_t generation = restarts;
+		const bool adaptiveStep = adaptive;
+		lock.unlock();
+
+		double stable = 0, ceiling = 0;
+		{
+			std::lock_guard<std::mutex> stepLock(stepMutex);
+			// a Restart since the lock was released rewound the clock,
+			// plan again from there
+			if (restarts == generation) {
+				const Clock::time_point start = Clock::now();
+				solver->Step((float)step);
+				const double seconds =
+					std::chrono::duration<double>(Clock::now() - start)
+						.count();
+				Publish(time, step, false);
+				if (adaptiveStep) {
+					stable = solver->StableTimeStep();
+					ceiling = solver->MaxTimeStep();
+				}
+
+				std::lock_guard<std::mutex> statsLock(statsMutex);
+				stats.minStep =
+					stats.steps == 0 ? step : std::min(stats.minStep, step);
+				stats.maxStep = std::max(stats.maxStep, step);
+				stats.steps++;
+				stats.seconds += seconds;
+				stats.simulated += step;
+			}
+
+			// writers done with their queue close without waiting
+			retired.erase(
+				std::remove_if(retired.begin(), retired.end(),
+							   [](const std::unique_ptr<BakeWriter> &w) {
+								   return w->IsClosed();
+							   }),
+				retired.end());
+		}
+
+		lock.lock();
+		if (restarts == generation) {
+			simTime = time;
+			timeStep = ChooseStep(stable, ceiling);
+		}
+	}
+}
+
+void SimulationThread::Publish(double time, double step, bool restarted) {
+	SimFrame &frame = frames.Back();
+	solver->GetParticles().CopyPositions(frame.current);
+	if (restarted || latest.size() != frame.current.size())
+		latest = frame.current;
+	frame.previous.swap(latest);
+	latest = frame.current;
+	recordTime = restarted ? 0.0 : recordTime + step;
+	if (restarted)
+		nextRecord = 0;
+	// half a step early, so rounding never skips a frame
+	if (recorder && recordTime + 0.5 * step >= nextRecord) {
+		recorder->Write(latest);
+		nextRecord += recorder->GetInterval();
+	}
+	frame.time = time;
+	frame.step = step;
+	frame.sequence = ++sequence;
+	frames.Publish();
+}
+
+void SimulationThread::Advance(double dt) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		targetTime += dt;
+		frameTime = dt;
+	}
+	wake.notify_one();
+}
+
+void SimulationThread::SetAdaptive(bool enabled, int substeps) {
+	std::lock_guard<std::mutex> lock(mutex);
+	// the step in flight chose its length, the next one follows these
+	adaptive = enabled;
+	maxSubsteps = std::max(substeps, 1);
+	if (!adaptive)
+		timeStep = fixedStep;
+}
+
+void SimulationThread::Restart(
+	const std::function<void(FluidSolver &)> &refill) {
+	std::lock_guard<std::mutex> step(stepMutex);
+	refill(*solver);
+	const double stable = solver->StableTimeStep();
+	const double ceiling = solver->MaxTimeStep();
+	double first;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		simTime = targetTime = 0;
+		restarts++;
+		first = timeStep = ChooseStep(stable, ceiling);
+		// a cache holds one run, a restart ends it, and any writer not
+		// started yet with it
+		for (std::unique_ptr<BakeWriter> &writer : handoff)
+			Retire(std::move(writer));
+		handoff.clear();
+	}
+	Retire(std::move(recorder));
+	recording = nullptr;
+	Publish(0.0, first, true);
+}
+
+void SimulationThread::Edit(const std::function<void(FluidSolver &)> &edit) {
+	std::lock_guard<std::mutex> step(stepMutex);
+	edit(*solver);
+}
+
+void SimulationThread::Record(std::unique_ptr<BakeWriter> writer) {
+	recording = writer.get();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handoff.push_back(std::move(writer));
+	}
+	wake.notify_one();
+}
+
+void SimulationThread::SwapRecorder(std::unique_ptr<BakeWriter> writer) {
+	std::lock_guard<std::mutex> step(stepMutex);
+	recorder.swap(writer);
+	// the published state is the first frame
+	if (recorder) {
+		recorder->Write(latest);
+		nextRecord = recordTime + recorder->GetInterval();
+	}
+	Retire(std::move(writer));
+}
+
+void SimulationThread::Retire(std::unique_ptr<BakeWriter> writer) {
+	if (!writer)
+		return;
+	writer->Close();
+	retired.push_back(std::move(writer));
+}
+
+const SimFrame &SimulationThread::Latest() {
+	frames.Acquire();
+	return frames.Front();
+}
+
+SimStats SimulationThread::TakeStats() {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	SimStats taken = stats;
+	stats = SimStats();
+	return taken;
+}
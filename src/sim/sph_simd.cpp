@@ -0,0 +1,127 @@
+#include "sim/sph_simd.hpp"
+#include <atomic>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#include "sim/sph_simd_kernels.hpp"
+
+using namespace engine;
+
+namespace {
+
+struct ScalarLane {
+	using V = float;
+	using M = bool;
+	static constexpr uint32_t width = 1;
+
+	static inline M all() { return true; }
+	static inline M firstN(int n) { return n > 0; }
+	static inline V load(const float *p, M m) { return m ? *p : 0.0f; }
+	static inline V set1(float x) { return x; }
+	static inline V zero() { return 0.0f; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V sub(V a, V b) { return a - b; }
+	static inline V mul(V a, V b) { return a * b; }
+	static inline V div(V a, V b) { return a / b; }
+	static inline V fmadd(V a, V b, V c) { return a * b + c; }
+	static inline V sqrt(V a) { return std::sqrt(a); }
+	static inline M lt(V a, V b) { return a < b; }
+	static inline M gt(V a, V b) { return a > b; }
+	static inline M and_(M a, M b) { return a && b; }
+	static inline V select(M m, V v) { return m ? v : 0.0f; }
+	static inline float reduce(V v) { return v; }
+};
+
+std::atomic<const SphKernels *> &currentKernels() {
+	static std::atomic<const SphKernels *> current{nullptr};
+	return current;
+}
+
+} // namespace
+
+const SphKernels *engine::sphKernelsScalar() {
+	static const SphKernels kernels =
+		makeSphKernels<ScalarLane>(SimdLevel::Scalar);
+	return &kernels;
+}
+
+bool engine::parseSimdLevel(const std::string &name, SimdLevel &level) {
+	if (name == "scalar")
+		level = SimdLevel::Scalar;
+	else if (name == "avx2")
+		level = SimdLevel::Avx2;
+	else if (name == "avx512")
+		level = SimdLevel::Avx512;
+	else
+		return false;
+	return true;
+}
+
+const char *engine::simdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Avx2:
+		return "avx2";
+	case SimdLevel::Avx512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+SimdLevel engine::detectSimdLevel() {
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+	(defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SimdLevel::Avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SimdLevel::Avx2;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] >> 27) & 1;
+	const bool fma = (info[2] >> 12) & 1;
+	if (!osxsave)
+		return SimdLevel::Scalar;
+	// the OS has to save the wider registers on context switches
+	const unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	const bool avx2 = (info[1] >> 5) & 1;
+	const bool avx512f = (info[1] >> 16) & 1;
+	if (avx512f && (xcr0 & 0xe6) == 0xe6)
+		return SimdLevel::Avx512;
+	if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+		return SimdLevel::Avx2;
+#endif
+	return SimdLevel::Scalar;
+}
+
+SimdLevel engine::setSimdLevel(SimdLevel level) {
+	const SimdLevel supported = detectSimdLevel();
+	if ((int)level > (int)supported)
+		level = supported;
+
+	const SphKernels *kernels = nullptr;
+	if (level == SimdLevel::Avx512)
+		kernels = sphKernelsAvx512();
+	if (kernels == nullptr && level >= SimdLevel::Avx2)
+		kernels = sphKernelsAvx2();
+	if (kernels == nullptr)
+		kernels = sphKernelsScalar();
+
+	currentKernels().store(kernels);
+	return kernels->level;
+}
+
+const SphKernels &engine::sphKernels() {
+	const SphKernels *kernels = currentKernels().load();
+	if (kernels == nullptr) {
+		setSimdLevel(detectSimdLevel());
+		kernels = currentKernels().load();
+	}
+	return *kernels;
+}
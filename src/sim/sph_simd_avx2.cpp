@@ -0,0 +1,78 @@
+#include "sim/sph_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+// everything defined below, the kernel templates included, is built for
+// AVX2 + FMA. only reached after detectSimdLevel found both
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))),             \
+							 apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "sim/sph_simd_kernels.hpp"
+
+using namespace engine;
+
+namespace {
+
+struct Avx2Lane {
+	using V = __m256;
+	using M = __m256;
+	static constexpr uint32_t width = 8;
+
+	static inline M all() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	static inline M firstN(int n) {
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		return _mm256_castsi256_ps(
+			_mm256_cmpgt_epi32(_mm256_set1_epi32(n), lanes));
+	}
+	static inline V load(const float *p, M m) {
+		return _mm256_maskload_ps(p, _mm256_castps_si256(m));
+	}
+	static inline V set1(float x) { return _mm256_set1_ps(x); }
+	static inline V zero() { return _mm256_setzero_ps(); }
+	static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static inline V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+	static inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static inline M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static inline M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline M and_(M a, M b) { return _mm256_and_ps(a, b); }
+	static inline V select(M m, V v) { return _mm256_and_ps(m, v); }
+	static inline float reduce(V v) {
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+								_mm256_extractf128_ps(v, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+	}
+};
+
+} // namespace
+
+const SphKernels *engine::sphKernelsAvx2() {
+	static const SphKernels kernels =
+		makeSphKernels<Avx2Lane>(SimdLevel::Avx2);
+	return &kernels;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#else
+
+#include "sim/sph_simd_kernels.hpp"
+
+const engine::SphKernels *engine::sphKernelsAvx2() { return nullptr; }
+
+#endif
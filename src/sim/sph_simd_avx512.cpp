@@ -0,0 +1,72 @@
+#include "sim/sph_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+// everything defined below, the kernel templates included, is built for
+// AVX-512F. only reached after detectSimdLevel found it
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,fma"))),          \
+							 apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,fma")
+#endif
+
+#include "sim/sph_simd_kernels.hpp"
+
+using namespace engine;
+
+namespace {
+
+struct Avx512Lane {
+	using V = __m512;
+	using M = __mmask16;
+	static constexpr uint32_t width = 16;
+
+	static inline M all() { return (M)0xffff; }
+	static inline M firstN(int n) { return (M)((1u << n) - 1u); }
+	static inline V load(const float *p, M m) {
+		return _mm512_maskz_loadu_ps(m, p);
+	}
+	static inline V set1(float x) { return _mm512_set1_ps(x); }
+	static inline V zero() { return _mm512_setzero_ps(); }
+	static inline V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	static inline V div(V a, V b) { return _mm512_div_ps(a, b); }
+	static inline V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+	static inline V sqrt(V a) { return _mm512_sqrt_ps(a); }
+	static inline M lt(V a, V b) {
+		return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+	}
+	static inline M gt(V a, V b) {
+		return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+	}
+	static inline M and_(M a, M b) { return (M)(a & b); }
+	static inline V select(M m, V v) { return _mm512_maskz_mov_ps(m, v); }
+	static inline float reduce(V v) { return _mm512_reduce_add_ps(v); }
+};
+
+} // namespace
+
+const SphKernels *engine::sphKernelsAvx512() {
+	static const SphKernels kernels =
+		makeSphKernels<Avx512Lane>(SimdLevel::Avx512);
+	return &kernels;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#else
+
+#include "sim/sph_simd_kernels.hpp"
+
+const engine::SphKernels *engine::sphKernelsAvx512() { return nullptr; }
+
+#endif
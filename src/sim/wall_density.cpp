@@ -0,0 +1,34 @@
+#include "sim/wall_density.hpp"
+#include <cmath>
+
+using namespace engine;
+
+void WallDensityTable::Build(const Poly6Kernel &kernel,
+							 const SpikyKernel &gradKernel, float spacing,
+							 float mass) {
+	h = kernel.h;
+	invStep = (float)samples / h;
+	density.assign(samples + 1, 0.0f);
+	gradient.assign(samples + 1, 0.0f);
+
+	// wall particles fill y < 0 half a spacing out from each layer, the
+	// particle sits above the origin
+	const int reach = (int)std::ceil(h / spacing) + 1;
+	for (int s = 0; s <= samples; ++s) {
+		const float d = (float)s / invStep;
+		float rho = 0.0f, grad = 0.0f;
+		for (int layer = 0; layer < reach; ++layer) {
+			const float dy = d + (layer + 0.5f) * spacing;
+			for (int z = -reach; z <= reach; ++z) {
+				for (int x = -reach; x <= reach; ++x) {
+					const float dx = x * spacing, dz = z * spacing;
+					const float r2 = dx * dx + dy * dy + dz * dz;
+					rho += kernel.W2(r2);
+					grad += gradKernel.GradScale(std::sqrt(r2)) * dy;
+				}
+			}
+		}
+		density[s] = mass * rho;
+		gradient[s] = mass * grad;
+	}
+}
@@ -0,0 +1,165 @@
+#include "sim/wcsph_solver.hpp"
+#include "common/parallel.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace engine;
+
+namespace {
+
+// particles per worker below which a pass stays on fewer threads
+constexpr size_t minParticlesPerWorker = 1024;
+
+} // namespace
+
+WcsphSolver::WcsphSolver(const WcsphSettings &settings)
+	: settings(settings) {
+	spacing = 2.0f * settings.particleRadius;
+	// ~30 neighbours at rest
+	const float h = 2.0f * spacing;
+	kernel = Poly6Kernel(h);
+	gradKernel = SpikyKernel(h);
+	laplacian = 45.0f / ((float)M_PI * std::pow(h, 6.0f));
+	mass = LatticeMass(kernel, settings.restDensity);
+	// Tait equation with gamma = 7
+	stiffness = settings.restDensity * settings.soundSpeed *
+				settings.soundSpeed / 7.0f;
+	grid.Configure(settings.domainMin, settings.domainMax, kernel.h);
+}
+
+void WcsphSolver::GetDomain(Vec3f &boundMin, Vec3f &boundMax) const {
+	boundMin = settings.domainMin;
+	boundMax = settings.domainMax;
+}
+
+void WcsphSolver::ComputeDensity() {
+	const SphKernels &kernels = sphKernels();
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const SphQuery q = Query(i, kernel.h);
+				SphSums sums;
+				grid.ForEachRange(particles, i,
+								  [&](uint32_t first, uint32_t last) {
+									  kernels.poly6(q, first, last, sums);
+								  });
+				const float rho = mass * kernel.k * sums.density;
+				particles.density[i] = rho;
+
+				// clamped at zero, so under-dense surface particles don't
+				// pull on each other
+				const float ratio = rho / settings.restDensity;
+				const float ratio2 = ratio * ratio;
+				const float ratio7 = ratio2 * ratio2 * ratio2 * ratio;
+				particles.pressure[i] =
+					std::max(stiffness * (ratio7 - 1.0f), 0.0f);
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void WcsphSolver::ComputeForces() {
+	const SphKernels &kernels = sphKernels();
+	const float pressureScale = -mass * gradKernel.l;
+	const float viscosityScale = settings.viscosity * mass * laplacian;
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				SphQuery q = Query(i, kernel.h);
+				const float rhoI = particles.density[i];
+				q.pressureI = particles.pressure[i] / (rhoI * rhoI);
+				SphSums sums;
+				grid.ForEachRange(
+					particles, i, [&](uint32_t first, uint32_t last) {
+						kernels.pressureViscosity(q, first, last, sums);
+					});
+				particles.ax[i] = pressureScale * sums.x +
+								  viscosityScale * sums.vx + settings.gravity.x;
+				particles.ay[i] = pressureScale * sums.y +
+								  viscosityScale * sums.vy + settings.gravity.y;
+				particles.az[i] = pressureScale * sums.z +
+								  viscosityScale * sums.vz + settings.gravity.z;
+			}
+		},
+		minParticlesPerWorker);
+}
+
+void WcsphSolver::Integrate() {
+	const float r = settings.particleRadius;
+	const Vec3f lo = settings.domainMin + Vec3f(r);
+	const Vec3f hi = settings.domainMax - Vec3f(r);
+	const float restitution = settings.wallRestitution;
+
+	auto integrateAxis = [&](float &p, float &v, float a, int axis) {
+		v += a * dt;
+		p += v * dt;
+		if (p < lo[axis]) {
+			p = lo[axis];
+			if (v < 0.0f)
+				v = -v * restitution;
+		} else if (p > hi[axis]) {
+			p = hi[axis];
+			if (v > 0.0f)
+				v = -v * restitution;
+		}
+	};
+
+	parallelFor(
+		particles.Size(),
+		[&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				integrateAxis(particles.px[i], particles.vx[i],
+							  particles.ax[i], 0);
+				integrateAxis(particles.py[i], particles.vy[i],
+							  particles.ay[i], 1);
+				integrateAxis(particles.pz[i], particles.vz[i],
+							  particles.az[i], 2);
+
+				Vec3f n;
+				if (Collide(particles.px[i], particles.py[i], particles.pz[i],
+							r, n)) {
+					const float vn = particles.vx[i] * n.x +
+									 particles.vy[i] * n.y +
+									 particles.vz[i] * n.z;
+					if (vn < 0.0f) {
+						const float bounce = -(1.0f + restitution) * vn;
+						particles.vx[i] += bounce * n.x;
+						particles.vy[i] += bounce * n.y;
+						particles.vz[i] += bounce * n.z;
+					}
+				}
+			}
+		},
+		minParticlesPerWorker);
+}
+
+float WcsphSolver::MaxTimeStep() const {
+	// sound alone, however still the fluid is
+	return settings.cflNumber * kernel.h / settings.soundSpeed;
+}
+
+float WcsphSolver::StableTimeStep() const {
+	const float h = kernel.h;
+	float step = settings.cflNumber * h / (settings.soundSpeed + MaxSpeed());
+	const float acceleration = MaxAcceleration();
+	if (acceleration > 0.0f)
+		step = std::min(step,
+						settings.forceNumber * std::sqrt(h / acceleration));
+	// explicit viscous diffusion
+	if (settings.viscosity > 0.0f)
+		step = std::min(step, 0.125f * h * h / settings.viscosity);
+	return step;
+}
+
+void WcsphSolver::Step(float stepDt) {
+	if (particles.Size() == 0)
+		return;
+	dt = stepDt;
+	grid.Build(particles);
+	ComputeDensity();
+	ComputeForces();
+	Integrate();
+	steps++;
+}